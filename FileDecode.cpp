@@ -40,6 +40,8 @@ int FileDecode::AVOpenFile(std::string filename) {
     }
 #endif
 
+    formatCtx = avformat_alloc_context();
+    formatCtx->interrupt_callback = {&FileDecode::ReadInterrupted, this};
     int openInputResult =
         avformat_open_input(&formatCtx, filename.c_str(), NULL, NULL);
     if (openInputResult != 0) {
@@ -160,7 +162,7 @@ int FileDecode::InnerStartRead() {
     StartSysClockMs();
 
     int result = 0;
-    read_frame_flag = true;
+    // read_frame_flag 在 StartRead 里置位，打开期间 Close 过的不再恢复
     do {
         std::unique_lock<std::mutex> lock(read_mutex_);
         if (!pause_read_flag) {
@@ -313,6 +315,10 @@ int FileDecode::AudioDecodeFun() {
     return 0;
 }
 
+int FileDecode::ReadInterrupted(void *opaque) {
+    return !static_cast<FileDecode *>(opaque)->read_frame_flag;
+}
+
 void FileDecode::Close() {
     read_frame_flag = false;
     if (player_thread_ && player_thread_->joinable()) {
@@ -116,6 +116,8 @@ private:
     int AudioDecodeFun();
     void RunFFmpeg(std::string url);
 
+    static int ReadInterrupted(void *opaque);
+
     int DecodeAudio(AVPacket *originalPacket);
     int DecodeVideo(AVPacket *originalPacket);
     int ResampleAudio(AVFrame *frame);
@@ -149,7 +151,8 @@ private:
     bool audioDecodeThreadFlag = true;
     std::thread *audioDecodeThread = nullptr;
 
-    bool read_frame_flag = true;
+    // Close 时置 false，同时打断阻塞在 av_read_frame 里的网络读
+    std::atomic_bool read_frame_flag = true;
     std::thread *player_thread_ = nullptr;
 
     std::unique_ptr<AVJitterBuffer> audio_packet_buffer;
@@ -0,0 +1,106 @@
+#include "AdaptiveJitterBuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+AdaptiveJitterBuffer::AdaptiveJitterBuffer()
+    : AdaptiveJitterBuffer(Options{}) {}
+
+AdaptiveJitterBuffer::AdaptiveJitterBuffer(Options options)
+    : options_(options) {
+    Reset();
+}
+
+void AdaptiveJitterBuffer::Reset() {
+    histogram_.assign(options_.maxDelayMs / options_.bucketMs + 1, 0.0);
+    baseline_us_ = INT64_MAX;
+    last_transit_us_ = INT64_MIN;
+    jitter_us_ = 0;
+    playout_ms_ = -1;
+    late_avg_ = 0;
+    delay_ms_ = static_cast<double>(options_.minDelayMs);
+    packets_ = 0;
+    late_ = 0;
+}
+
+void AdaptiveJitterBuffer::OnArrival(int64_t ts_ms, int64_t now_us) {
+    int64_t transit_us = now_us - ts_ms * 1000;
+    if (baseline_us_ == INT64_MAX) {
+        baseline_us_ = transit_us;
+    } else if (transit_us < baseline_us_) {
+        // 出现更快的包，之前记录的相对延迟都要加上这个差
+        shift((baseline_us_ - transit_us) / 1000 / options_.bucketMs);
+        baseline_us_ = transit_us;
+    }
+    if (last_transit_us_ != INT64_MIN) {
+        double d = static_cast<double>(std::llabs(transit_us -
+                                                  last_transit_us_));
+        jitter_us_ += (d - jitter_us_) / 16.0;
+    }
+    last_transit_us_ = transit_us;
+
+    double relative_ms = (transit_us - baseline_us_) / 1000.0;
+    size_t bucket = std::min<size_t>(
+        static_cast<size_t>(relative_ms / options_.bucketMs),
+        histogram_.size() - 1);
+    for (double &h : histogram_) {
+        h *= options_.forget;
+    }
+    histogram_[bucket] += 1.0 - options_.forget;
+    packets_++;
+
+    if (playout_ms_ >= 0) {
+        bool late = relative_ms > playout_ms_;
+        late_ += late;
+        late_avg_ = late_avg_ * options_.forget +
+                    (late ? 1.0 - options_.forget : 0.0);
+    }
+    updateDelay();
+}
+
+void AdaptiveJitterBuffer::SetPlayoutDelay(double delay_ms) {
+    playout_ms_ = delay_ms;
+}
+
+AdaptiveJitterBuffer::Stats AdaptiveJitterBuffer::stats() const {
+    // 刚开始时权重和不到 1，按实际的和归一化
+    double weight = 1.0 - std::pow(options_.forget,
+                                   static_cast<double>(packets_));
+    return {delay_ms_, jitter_us_ / 1000.0, packets_, late_,
+            weight > 0 ? late_avg_ / weight : 0.0};
+}
+
+void AdaptiveJitterBuffer::shift(int64_t buckets) {
+    if (buckets <= 0) {
+        return;
+    }
+    auto n = static_cast<int64_t>(histogram_.size());
+    double overflow = 0;
+    for (int64_t i = n - 1; i >= 0; --i) {
+        if (i + buckets >= n - 1) {
+            overflow += histogram_[i];
+        } else {
+            histogram_[i + buckets] = histogram_[i];
+        }
+        histogram_[i] = 0;
+    }
+    histogram_[n - 1] = overflow;
+}
+
+void AdaptiveJitterBuffer::updateDelay() {
+    double total = 0;
+    for (double h : histogram_) {
+        total += h;
+    }
+    double wanted = total * (1.0 - options_.lateTarget);
+    double sum = 0;
+    size_t bucket = 0;
+    for (; bucket < histogram_.size(); ++bucket) {
+        sum += histogram_[bucket];
+        if (sum >= wanted) {
+            break;
+        }
+    }
+    delay_ms_ = std::clamp<double>((bucket + 1) * options_.bucketMs,
+                                   options_.minDelayMs, options_.maxDelayMs);
+}
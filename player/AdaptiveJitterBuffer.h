@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// 直播输入的自适应抖动缓冲：记录每个包到达时间减时间戳（传输时间）
+// 相对最快那个包多出来的部分，做成带遗忘的直方图，取让迟到比例不超过
+// 目标的分位数作为播放延迟。网络变差时延迟跟着涨，变好后几百个包内
+// 降回来。包仍在播放器的队列里，这里只决定播放延迟；不加锁，
+// 由 LiveLatency 持有并加锁调用
+class AdaptiveJitterBuffer {
+public:
+    struct Options {
+        double lateTarget = 0.02; // 允许迟到的包的比例
+        int64_t minDelayMs = 20;
+        int64_t maxDelayMs = 3000;
+        int64_t bucketMs = 10;
+        // 每来一个包旧统计乘一次，0.995 大约记住最近 200 个包，
+        // 25fps 的视频是 8 秒
+        double forget = 0.995;
+    };
+
+    struct Stats {
+        double delayMs;  // 分位数给出的目标延迟，相对最快到达的包
+        double jitterMs; // RFC 3550 的到达抖动
+        uint64_t packets;
+        uint64_t late;   // 到达时已经过了播放时刻
+        double lateRate; // 最近的迟到比例
+    };
+
+    AdaptiveJitterBuffer();
+    explicit AdaptiveJitterBuffer(Options options);
+
+    void Reset();
+    // ts_ms 用 dts，按到达顺序单调
+    void OnArrival(int64_t ts_ms, int64_t now_us);
+    // 当前实际的播放延迟，用来判断之后到达的包是否迟到
+    void SetPlayoutDelay(double delay_ms);
+
+    // 最快到达的包的传输时间，还没有包时为 INT64_MAX
+    int64_t baselineUs() const {
+        return baseline_us_;
+    }
+
+    double delayMs() const {
+        return delay_ms_;
+    }
+
+    Stats stats() const;
+
+private:
+    void shift(int64_t buckets);
+    void updateDelay();
+
+    Options options_;
+    std::vector<double> histogram_;
+    int64_t baseline_us_{INT64_MAX};
+    int64_t last_transit_us_{INT64_MIN};
+    double jitter_us_{};
+    double playout_ms_{-1};
+    double late_avg_{};
+    double delay_ms_{};
+    uint64_t packets_{};
+    uint64_t late_{};
+};
@@ -0,0 +1,157 @@
+#include "AudioSink.h"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+namespace {
+constexpr int64_t kNsPerSecond = 1000000000;
+constexpr int64_t kMaxElapsedNs = 60 * kNsPerSecond;
+}
+
+void NullAudioSink::SetFormat(int rate, int sample_size, int nch) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    int64_t bytes_per_second =
+        static_cast<int64_t>(rate) * nch * sample_size / 8;
+    if (bytes_per_second == bytes_per_second_) {
+        return;
+    }
+    bytes_per_second_ = bytes_per_second;
+    pending_bytes_ = 0;
+    played_bytes_ = 0;
+    carry_ = 0;
+    dropped_bytes_ = 0;
+    paused_ = false;
+    last_ = Clock::now();
+}
+
+void NullAudioSink::advance() const {
+    auto now = Clock::now();
+    if (!paused_ && bytes_per_second_ > 0) {
+        // 按纳秒算，不满一个字节的部分留到下次，查询得再频繁时钟也不会
+        // 变慢。隔了一分钟缓冲肯定放完了，截断防止乘法溢出
+        int64_t elapsed_ns = std::min<int64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                now - last_).count(), kMaxElapsedNs);
+        int64_t budget = elapsed_ns * bytes_per_second_ + carry_;
+        int64_t consumed = std::min(pending_bytes_, budget / kNsPerSecond);
+        // 数据放完了设备空转，空转的时间不攒着
+        carry_ = consumed < pending_bytes_ ? budget % kNsPerSecond : 0;
+        pending_bytes_ -= consumed;
+        played_bytes_ += consumed;
+    }
+    last_ = now;
+}
+
+void NullAudioSink::writeData(const char *, int64_t len) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (bytes_per_second_ <= 0) {
+        return;
+    }
+    advance();
+    paused_ = false;
+    int64_t capacity = capacity_ms_ * bytes_per_second_ / 1000;
+    int64_t accepted = std::clamp<int64_t>(capacity - pending_bytes_, 0, len);
+    pending_bytes_ += accepted;
+    dropped_bytes_ += len - accepted;
+}
+
+void NullAudioSink::pause() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    advance();
+    paused_ = true;
+}
+
+void NullAudioSink::resume() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    advance();
+    paused_ = false;
+}
+
+void NullAudioSink::Quit() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    pending_bytes_ = 0;
+}
+
+int64_t NullAudioSink::bufferedMs() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (bytes_per_second_ <= 0) {
+        return 0;
+    }
+    advance();
+    return pending_bytes_ * 1000 / bytes_per_second_;
+}
+
+int64_t NullAudioSink::playedMs() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (bytes_per_second_ <= 0) {
+        return 0;
+    }
+    advance();
+    return played_bytes_ * 1000 / bytes_per_second_;
+}
+
+int64_t NullAudioSink::droppedBytes() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return dropped_bytes_;
+}
+
+namespace {
+void putLe(FILE *file, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        fputc(static_cast<int>((value >> (8 * i)) & 0xff), file);
+    }
+}
+}
+
+void WavFileSink::SetFormat(int rate, int sample_size, int nch) {
+    // 同样的格式不重新开文件，换曲时继续往同一个文件写
+    if (file_ && rate == rate_ && sample_size == sample_size_ &&
+        nch == nch_) {
+        return;
+    }
+    Quit();
+    rate_ = rate;
+    sample_size_ = sample_size;
+    nch_ = nch;
+    data_bytes_ = 0;
+    file_ = fopen(path_.c_str(), "wb");
+    if (!file_) {
+        spdlog::error("open wav file {} failed", path_);
+        return;
+    }
+    writeHeader();
+}
+
+void WavFileSink::writeData(const char *data, int64_t len) {
+    if (!file_) {
+        return;
+    }
+    data_bytes_ += fwrite(data, 1, len, file_);
+}
+
+void WavFileSink::Quit() {
+    if (!file_) {
+        return;
+    }
+    // 回填 RIFF/data 长度
+    fseek(file_, 0, SEEK_SET);
+    writeHeader();
+    fclose(file_);
+    file_ = nullptr;
+}
+
+void WavFileSink::writeHeader() {
+    uint32_t block_align = nch_ * sample_size_ / 8;
+    fwrite("RIFF", 1, 4, file_);
+    putLe(file_, 36 + data_bytes_, 4);
+    fwrite("WAVEfmt ", 1, 8, file_);
+    putLe(file_, 16, 4);
+    putLe(file_, 1, 2); // PCM
+    putLe(file_, nch_, 2);
+    putLe(file_, rate_, 4);
+    putLe(file_, rate_ * block_align, 4);
+    putLe(file_, block_align, 2);
+    putLe(file_, sample_size_, 2);
+    fwrite("data", 1, 4, file_);
+    putLe(file_, data_bytes_, 4);
+    fseek(file_, 0, SEEK_END);
+}
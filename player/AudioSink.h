@@ -0,0 +1,89 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// 音频输出接口：解码/同步代码只依赖这个接口，
+// 这样没有声卡的机器也能跑完整的流水线
+class AudioSink {
+public:
+    virtual ~AudioSink() = default;
+
+    // sample_size 单位 bit，数据固定为交错的有符号整数 PCM
+    virtual void SetFormat(int rate, int sample_size, int nch) = 0;
+    virtual void writeData(const char *data, int64_t len) = 0;
+    virtual void pause() {}
+    virtual void resume() {}
+    virtual void Quit() = 0;
+    // 已写入但还没播出去的数据时长
+    virtual int64_t bufferedMs() const = 0;
+};
+
+using AudioSinkFactory = std::function<std::unique_ptr<AudioSink>()>;
+
+// 不出声的 sink，用系统时钟模拟设备按实时速率消费数据，
+// 缓冲满了就丢弃，和 QAudioOutput push 模式的行为一致
+class NullAudioSink : public AudioSink {
+public:
+    explicit NullAudioSink(int64_t capacity_ms = 500)
+        : capacity_ms_(capacity_ms) {}
+
+    void SetFormat(int rate, int sample_size, int nch) override;
+    void writeData(const char *data, int64_t len) override;
+    void pause() override;
+    void resume() override;
+    void Quit() override;
+    int64_t bufferedMs() const override;
+
+    // 模拟设备已经播放的时长
+    int64_t playedMs() const;
+    int64_t droppedBytes() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void advance() const;
+
+    mutable std::mutex mtx_;
+    int64_t capacity_ms_;
+    int64_t bytes_per_second_{};
+    mutable int64_t pending_bytes_{};
+    mutable int64_t played_bytes_{};
+    // 上次没凑够一个字节的消费量，单位 字节/1e9
+    mutable int64_t carry_{};
+    mutable Clock::time_point last_{};
+    int64_t dropped_bytes_{};
+    bool paused_{};
+};
+
+// 把输出 PCM 流式写成 wav 文件，取代编译期的 WRITE_RESAMPLE_PCM_FILE
+class WavFileSink : public AudioSink {
+public:
+    explicit WavFileSink(std::string path) : path_(std::move(path)) {}
+
+    ~WavFileSink() override {
+        Quit();
+    }
+
+    void SetFormat(int rate, int sample_size, int nch) override;
+    void writeData(const char *data, int64_t len) override;
+    void Quit() override;
+
+    int64_t bufferedMs() const override {
+        return 0;
+    }
+
+private:
+    void writeHeader();
+
+    std::string path_;
+    FILE *file_{};
+    int rate_{};
+    int sample_size_{};
+    int nch_{};
+    uint32_t data_bytes_{};
+};
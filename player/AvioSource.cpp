@@ -0,0 +1,151 @@
+#include "AvioSource.h"
+#include "CachingAvio.h"
+#include "MmapAvio.h"
+#include "ReadAheadAvio.h"
+#include <cstdlib>
+#include <spdlog/spdlog.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace {
+AvioSourceFactory g_factory;
+
+// mmap 的缺页在网络文件系统上一样会阻塞读线程，这些走异步预读
+bool onNetworkFs(const std::string &path) {
+    struct statfs fs{};
+    if (statfs(path.c_str(), &fs) != 0) {
+        return false;
+    }
+    switch (static_cast<unsigned long>(fs.f_type)) {
+    case 0x6969: // NFS
+    case 0x517B: // SMB
+    case 0xFF534D42: // CIFS
+    case 0xFE534D42: // SMB2
+    case 0x65735546: // FUSE
+        return true;
+    default:
+        return false;
+    }
+}
+}
+
+AvioSource::~AvioSource() {
+    if (avio_) {
+        av_freep(&avio_->buffer);
+        avio_context_free(&avio_);
+    }
+}
+
+std::unique_ptr<AvioSource> AvioSource::Open(const std::string &url,
+                                             AVIOInterruptCB const *interrupt) {
+    if (g_factory) {
+        if (auto source = g_factory(url)) {
+            return source;
+        }
+    }
+    std::string mode;
+    if (const char *env = std::getenv("PLAYER_IO")) {
+        mode = env;
+    }
+    if (mode == "file") {
+        return nullptr;
+    }
+    // 渐进下载的网络源先过本地缓存
+    if (url.rfind("http://", 0) == 0 || url.rfind("https://", 0) == 0) {
+        return CachingAvio::Open(url, HttpCache::Default(), interrupt);
+    }
+    struct stat st{};
+    if (::stat(url.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return nullptr;
+    }
+    if (mode.empty()) {
+        mode = onNetworkFs(url) ? "readahead" : "mmap";
+    }
+    std::unique_ptr<AvioSource> source;
+    if (mode == "readahead") {
+        source = ReadAheadAvio::Open(url);
+    } else {
+        source = MmapAvio::Open(url);
+    }
+    if (!source) {
+        spdlog::warn("{} io for {} failed, fall back to file protocol", mode,
+                     url);
+    }
+    return source;
+}
+
+void AvioSource::SetFactory(AvioSourceFactory factory) {
+    g_factory = std::move(factory);
+}
+
+int AvioSource::OpenInput(AVFormatContext *&format_ctx, const std::string &url,
+                          AVDictionary **options) {
+    return OpenInput(
+        format_ctx, url,
+        Open(url, format_ctx ? &format_ctx->interrupt_callback : nullptr),
+        options);
+}
+
+int AvioSource::OpenInput(AVFormatContext *&format_ctx, const std::string &url,
+                          std::unique_ptr<AvioSource> source,
+                          AVDictionary **options) {
+    if (!source) {
+        return avformat_open_input(&format_ctx, url.c_str(), nullptr,
+                                   options);
+    }
+    if (!format_ctx) {
+        format_ctx = avformat_alloc_context();
+    }
+    if (!format_ctx) {
+        return AVERROR(ENOMEM);
+    }
+    format_ctx->pb = source->avio();
+    // 失败时 avformat 会释放 format_ctx，但不会动自定义的 pb
+    int ret = avformat_open_input(&format_ctx, url.c_str(), nullptr, options);
+    if (ret == 0) {
+        // 之后由 pb->opaque 持有，CloseInput 时释放
+        source.release();
+    }
+    return ret;
+}
+
+void AvioSource::CloseInput(AVFormatContext *&format_ctx) {
+    if (!format_ctx) {
+        return;
+    }
+    AvioSource *source = nullptr;
+    if (format_ctx->pb &&
+        format_ctx->pb->read_packet == &AvioSource::readPacket) {
+        source = static_cast<AvioSource *>(format_ctx->pb->opaque);
+    }
+    avformat_close_input(&format_ctx);
+    delete source;
+}
+
+bool AvioSource::initAvio(int buffer_size) {
+    auto *buffer = static_cast<unsigned char *>(av_malloc(buffer_size));
+    if (!buffer) {
+        return false;
+    }
+    avio_ = avio_alloc_context(buffer, buffer_size, 0, this,
+                               &AvioSource::readPacket, nullptr,
+                               &AvioSource::seekPacket);
+    if (!avio_) {
+        av_free(buffer);
+        return false;
+    }
+    return true;
+}
+
+int AvioSource::readPacket(void *opaque, uint8_t *buf, int size) {
+    return static_cast<AvioSource *>(opaque)->read(buf, size);
+}
+
+int64_t AvioSource::seekPacket(void *opaque, int64_t offset, int whence) {
+    return static_cast<AvioSource *>(opaque)->seek(offset,
+                                                   whence & ~AVSEEK_FORCE);
+}
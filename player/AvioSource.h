@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+struct AVIOContext;
+struct AVFormatContext;
+struct AVDictionary;
+struct AVIOInterruptCB;
+class AvioSource;
+
+using AvioSourceFactory =
+    std::function<std::unique_ptr<AvioSource>(const std::string &url)>;
+
+// 自定义 AVIO 的公共部分：分配 AVIOContext，把 read/seek 转给子类。
+// OpenInput 按文件所在位置挑后端，PLAYER_IO=mmap/readahead/file 可以强制
+class AvioSource {
+public:
+    virtual ~AvioSource();
+
+    AvioSource(const AvioSource &) = delete;
+    AvioSource &operator=(const AvioSource &) = delete;
+
+    // 本地普通文件和 http 源返回合适的后端，其他 url 返回空交给 avformat
+    // 自己打开。自己连网络的后端用 interrupt 打断阻塞的连接和读取
+    static std::unique_ptr<AvioSource>
+    Open(const std::string &url, AVIOInterruptCB const *interrupt = nullptr);
+    // 测试用：先问 factory，返回空时再按默认规则选，比如网络损伤模拟
+    static void SetFactory(AvioSourceFactory factory);
+
+    // 代替 avformat_open_input，用这个打开的必须用 CloseInput 关闭。
+    // format_ctx 可以预先分配好并设置 interrupt_callback
+    static int OpenInput(AVFormatContext *&format_ctx, const std::string &url,
+                         AVDictionary **options = nullptr);
+    // 指定后端，source 为空时等同 avformat_open_input
+    static int OpenInput(AVFormatContext *&format_ctx, const std::string &url,
+                         std::unique_ptr<AvioSource> source,
+                         AVDictionary **options = nullptr);
+    static void CloseInput(AVFormatContext *&format_ctx);
+
+    AVIOContext *avio() const {
+        return avio_;
+    }
+
+protected:
+    AvioSource() = default;
+
+    bool initAvio(int buffer_size);
+
+    virtual int read(uint8_t *buf, int size) = 0;
+    // whence 已经去掉 AVSEEK_FORCE，包括 AVSEEK_SIZE
+    virtual int64_t seek(int64_t offset, int whence) = 0;
+
+private:
+    static int readPacket(void *opaque, uint8_t *buf, int size);
+    static int64_t seekPacket(void *opaque, int64_t offset, int whence);
+
+    AVIOContext *avio_{};
+};
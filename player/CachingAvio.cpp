@@ -0,0 +1,154 @@
+#include "CachingAvio.h"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace {
+bool isManifest(const std::string &url) {
+    std::string path = url.substr(0, url.find_first_of("?#"));
+    auto endsWith = [&](const char *ext) {
+        std::string e(ext);
+        return path.size() >= e.size() &&
+               path.compare(path.size() - e.size(), e.size(), e) == 0;
+    };
+    return endsWith(".m3u8") || endsWith(".mpd");
+}
+}
+
+CachingAvio::CachingAvio(std::string url,
+                         std::shared_ptr<HttpCache::File> file)
+    : url_(std::move(url)), file_(std::move(file)) {}
+
+CachingAvio::~CachingAvio() {
+    if (upstream_) {
+        avio_closep(&upstream_);
+    }
+    spdlog::info("{} cache hit {} bytes, downloaded {} bytes, {} requests",
+                 url_, hit_bytes_.load(), miss_bytes_.load(),
+                 requests_.load());
+}
+
+std::unique_ptr<CachingAvio>
+CachingAvio::Open(const std::string &url, HttpCache &cache,
+                  AVIOInterruptCB const *interrupt) {
+    if (isManifest(url)) {
+        return nullptr;
+    }
+    auto file = cache.Open(url);
+    if (!file) {
+        return nullptr;
+    }
+    std::unique_ptr<CachingAvio> source(new CachingAvio(url, file));
+    if (interrupt) {
+        source->interrupt_ = interrupt->callback;
+        source->interrupt_opaque_ = interrupt->opaque;
+    }
+    if (!file->complete()) {
+        if (!source->openUpstream()) {
+            return nullptr;
+        }
+        int64_t size = avio_size(source->upstream_);
+        if (size <= 0 ||
+            !(source->upstream_->seekable & AVIO_SEEKABLE_NORMAL)) {
+            spdlog::info("{} has no size or range support, not cached", url);
+            return nullptr;
+        }
+        file->setSize(size);
+    }
+    if (!source->initAvio(kBufferSize)) {
+        return nullptr;
+    }
+    return source;
+}
+
+CachingAvio::Stats CachingAvio::stats() const {
+    return {hit_bytes_, miss_bytes_, requests_};
+}
+
+bool CachingAvio::openUpstream() {
+    AVIOInterruptCB interrupt{interrupt_, interrupt_opaque_};
+    int ret = avio_open2(&upstream_, url_.c_str(), AVIO_FLAG_READ,
+                         interrupt_ ? &interrupt : nullptr, nullptr);
+    if (ret < 0) {
+        spdlog::warn("open {} failed: {}", url_, ret);
+        return false;
+    }
+    requests_.fetch_add(1, std::memory_order_relaxed);
+    upstream_pos_ = 0;
+    return true;
+}
+
+int CachingAvio::read(uint8_t *buf, int size) {
+    int64_t total = file_->size();
+    if (total >= 0 && pos_ >= total) {
+        return AVERROR_EOF;
+    }
+    int64_t next;
+    int64_t end = file_->cachedEnd(pos_, next);
+    if (end > pos_) {
+        ssize_t n = file_->read(buf, std::min<int64_t>(size, end - pos_),
+                                pos_);
+        if (n <= 0) {
+            return AVERROR(EIO);
+        }
+        pos_ += n;
+        hit_bytes_.fetch_add(n, std::memory_order_relaxed);
+        return static_cast<int>(n);
+    }
+
+    // 缺数据，从服务器读到下一个已缓存区间为止
+    if (!upstream_ && !openUpstream()) {
+        return AVERROR(EIO);
+    }
+    if (upstream_pos_ != pos_) {
+        int64_t ret = avio_seek(upstream_, pos_, SEEK_SET);
+        if (ret < 0) {
+            return static_cast<int>(ret);
+        }
+        requests_.fetch_add(1, std::memory_order_relaxed);
+        upstream_pos_ = pos_;
+    }
+    int n = avio_read_partial(upstream_, buf,
+                              std::min<int64_t>(size, next - pos_));
+    if (n <= 0) {
+        return n == 0 ? AVERROR_EOF : n;
+    }
+    file_->write(buf, n, pos_);
+    pos_ += n;
+    upstream_pos_ += n;
+    miss_bytes_.fetch_add(n, std::memory_order_relaxed);
+    return n;
+}
+
+int64_t CachingAvio::seek(int64_t offset, int whence) {
+    int64_t total = file_->size();
+    if (whence == AVSEEK_SIZE) {
+        return total >= 0 ? total : AVERROR(ENOSYS);
+    }
+    int64_t pos;
+    switch (whence) {
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = pos_ + offset;
+        break;
+    case SEEK_END:
+        if (total < 0) {
+            return AVERROR(ENOSYS);
+        }
+        pos = total + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0) {
+        return AVERROR(EINVAL);
+    }
+    // 只改位置，真正缺数据时才动上游
+    pos_ = pos;
+    return pos_;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "AvioSource.h"
+#include "HttpCache.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// 渐进下载的 http 源：读过的字节写进 HttpCache，往回 seek 和再次打开时
+// 直接从本地读，只有缺的区间才向服务器发 Range 请求。服务器不支持 Range
+// 或者没有 Content-Length 时不缓存，交回 avformat 自己打开
+class CachingAvio : public AvioSource {
+public:
+    struct Stats {
+        uint64_t hitBytes;
+        uint64_t missBytes;
+        uint64_t requests; // 打开和 seek 上游的次数
+    };
+
+    ~CachingAvio() override;
+
+    // hls/dash 清单和不能缓存的源返回空。interrupt 传给上游连接，
+    // 停止播放时连接和读取不用等到超时
+    static std::unique_ptr<CachingAvio>
+    Open(const std::string &url, HttpCache &cache,
+         AVIOInterruptCB const *interrupt = nullptr);
+
+    Stats stats() const;
+
+    static constexpr int kBufferSize = 256 * 1024;
+
+protected:
+    int read(uint8_t *buf, int size) override;
+    int64_t seek(int64_t offset, int whence) override;
+
+private:
+    CachingAvio(std::string url, std::shared_ptr<HttpCache::File> file);
+
+    bool openUpstream();
+
+    std::string url_;
+    std::shared_ptr<HttpCache::File> file_;
+    int (*interrupt_)(void *){};
+    void *interrupt_opaque_{};
+    // 完整缓存过的文件不连服务器，第一次缺数据时才打开
+    AVIOContext *upstream_{};
+    int64_t upstream_pos_{-1};
+    int64_t pos_{};
+
+    std::atomic<uint64_t> hit_bytes_{0};
+    std::atomic<uint64_t> miss_bytes_{0};
+    std::atomic<uint64_t> requests_{0};
+};
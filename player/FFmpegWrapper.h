@@ -1,6 +1,9 @@
 #pragma once
 #include <QAudioOutput>
 #include <QIODevice>
+#include "AudioSink.h"
+#include "AvioSource.h"
+#include "PcmProcessor.h"
 
 
 extern "C" {
@@ -12,8 +15,14 @@ extern "C" {
 #include <libavutil/opt.h>
 }
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <functional>
 #include <source_location>
+#include <string>
+#include <tuple>
 #include <spdlog/spdlog.h>
 #include <vector>
 
@@ -47,27 +56,126 @@ public:
     static constexpr HasError NoError = {false, 0};
     static constexpr HasError Error = {true, 0};
 
+    static std::string errorString(int ret) {
+        char errorBuf[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(ret, errorBuf, sizeof(errorBuf));
+        return errorBuf;
+    }
+
     static HasError warnOnError(bool expected, int ret,
                                 std::source_location loc =
                                     std::source_location::current()) {
         if (!expected) {
-            char errorBuf[AV_ERROR_MAX_STRING_SIZE];
-            av_strerror(ret, errorBuf, sizeof(errorBuf));
             spdlog::warn("Non-critical error at {}:{} {}", loc.file_name(),
-                         loc.line(), errorBuf);
+                         loc.line(), errorString(ret));
             return Error;
         }
         return NoError;
     }
 
+    // 打开和探测各自的耗时，fast start 时探测可能被整个跳过
+    struct OpenTiming {
+        double openMs{};
+        double probeMs{};
+        bool probeSkipped{};
+    };
+
+    // FastStart 限制探测量；Live 在此之上去掉 demuxer 的缓冲，
+    // 解码器也按低延迟打开
+    enum class OpenMode {
+        Normal,
+        FastStart,
+        Live,
+    };
+
+    // 推流协议一定是直播，http-flv 之类要打开后才知道
+    static bool isLiveUrl(std::string const &url) {
+        for (const char *scheme : {"rtmp://", "rtmps://", "rtsp://", "srt://",
+                                   "udp://", "rtp://"}) {
+            if (url.rfind(scheme, 0) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 没有时长又不能 seek 的也当直播
+    static bool isLiveInput(std::string const &url,
+                            AVFormatContext const *formatCtx) {
+        return isLiveUrl(url) ||
+               (formatCtx->duration == AV_NOPTS_VALUE && formatCtx->pb &&
+                !(formatCtx->pb->seekable & AVIO_SEEKABLE_NORMAL));
+    }
+
+    // 容器头里已经有解码需要的参数（mp4/mkv 一般都有），不用再读包探测。
+    // 只看打开解码器要用的：codec、尺寸或采样率和声道数，H.264/HEVC/AAC
+    // 还要 avcC/hvcC/AudioSpecificConfig 这些 extradata。像素和采样格式
+    // 不看，它们在 find_stream_info 解出帧之前一直是 -1，解码器自己会定
+    static bool headersComplete(AVFormatContext const *formatCtx) {
+        for (unsigned i = 0; i < formatCtx->nb_streams; ++i) {
+            AVCodecParameters const *par = formatCtx->streams[i]->codecpar;
+            if (par->codec_type == AVMEDIA_TYPE_VIDEO &&
+                (par->codec_id == AV_CODEC_ID_NONE || par->width <= 0 ||
+                 par->height <= 0)) {
+                return false;
+            }
+            if (par->codec_type == AVMEDIA_TYPE_AUDIO &&
+                (par->codec_id == AV_CODEC_ID_NONE || par->sample_rate <= 0 ||
+                 par->channels <= 0)) {
+                return false;
+            }
+            bool out_of_band = par->codec_id == AV_CODEC_ID_H264 ||
+                               par->codec_id == AV_CODEC_ID_HEVC ||
+                               par->codec_id == AV_CODEC_ID_AAC;
+            if (out_of_band && par->extradata_size <= 0) {
+                return false;
+            }
+        }
+        return formatCtx->nb_streams > 0;
+    }
+
     static void openFile(AVFormatContext *&formatCtx,
                          std::string const &filename,
-                         int &audioStream, int &videoStream) {
-        int ret =
-            avformat_open_input(&formatCtx, filename.c_str(), NULL, NULL);
+                         int &audioStream, int &videoStream,
+                         OpenMode mode = OpenMode::Normal,
+                         OpenTiming *timing = nullptr,
+                         AVIOInterruptCB const *interrupt = nullptr) {
+        using Clock = std::chrono::steady_clock;
+        auto begin = Clock::now();
+        AVDictionary *options = nullptr;
+        if (mode == OpenMode::Live) {
+            // 只要拿到编码参数，探测读进来的包也不留
+            av_dict_set(&options, "probesize", "32768", 0);
+            av_dict_set(&options, "analyzeduration", "100000", 0);
+            av_dict_set(&options, "fflags", "nobuffer", 0);
+        } else if (mode == OpenMode::FastStart) {
+            // 默认 5MB / 5s，TS 之类要读很多包才肯返回；
+            // 开头 256KB 已经够拿到编码参数
+            av_dict_set(&options, "probesize", "262144", 0);
+            av_dict_set(&options, "analyzeduration", "500000", 0);
+        }
+        // 打开和探测期间就要能打断，连不上的服务器不用等 TCP 超时
+        if (interrupt) {
+            formatCtx = avformat_alloc_context();
+            formatCtx->interrupt_callback = *interrupt;
+        }
+        // 本地文件走自定义 AVIO，关闭时要用 AvioSource::CloseInput
+        int ret = AvioSource::OpenInput(formatCtx, filename, &options);
+        av_dict_free(&options);
         throwOnError(ret == 0, ret);
-        ret = avformat_find_stream_info(formatCtx, NULL);
-        throwOnError(ret >= 0, ret);
+        auto opened = Clock::now();
+        bool skipProbe = mode != OpenMode::Normal &&
+                         headersComplete(formatCtx);
+        if (!skipProbe) {
+            ret = avformat_find_stream_info(formatCtx, NULL);
+            throwOnError(ret >= 0, ret);
+        }
+        if (timing) {
+            using ms = std::chrono::duration<double, std::milli>;
+            timing->openMs = ms(opened - begin).count();
+            timing->probeMs = ms(Clock::now() - opened).count();
+            timing->probeSkipped = skipProbe;
+        }
 
         // av_dump_format(formatCtx, 0, filename.c_str(), 0);
 
@@ -81,28 +189,32 @@ public:
     }
 
     static void openCodec(AVCodecContext *&codecCtx, int streamIndex,
-                          AVFormatContext const *formatCtx) {
+                          AVFormatContext const *formatCtx,
+                          bool lowDelay = false) {
         AVStream *stream = formatCtx->streams[streamIndex];
         AVCodec const *codec = avcodec_find_decoder(stream->codecpar->codec_id);
 
         codecCtx = avcodec_alloc_context3(codec);
 
         avcodec_parameters_to_context(codecCtx, stream->codecpar);
+        if (lowDelay) {
+            // 帧级多线程每个线程都要压一帧，直播只用 slice 线程
+            codecCtx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+            codecCtx->flags2 |= AV_CODEC_FLAG2_FAST;
+            codecCtx->thread_type = FF_THREAD_SLICE;
+        }
 
         avcodec_open2(codecCtx, codec, nullptr);
     }
 
+    // 读包和送包在每个包上都会调用，出错时不打日志，只把错误码带回去，
+    // 由调用处限频打印
     static HasError readPaket(AVFormatContext *formatCtx, AVPacket *&packet) {
         packet = av_packet_alloc();
 
         int read_ret = av_read_frame(formatCtx, packet);
-        // 跳转到文件开头（时间戳 0，使用 AVSEEK_FLAG_BACKWARD 确保关键帧）
-        if (read_ret == AVERROR_EOF) {
-            spdlog::error("Seek failed after EOF");
-            return {true, AVERROR_EOF};
-        }
-        if (warnOnError(read_ret == 0, read_ret)) {
-            return Error;
+        if (read_ret < 0) {
+            return {true, read_ret};
         }
 
         return NoError;
@@ -112,15 +224,15 @@ public:
                                AVPacket *&originalPacket,
                                AVFrame *&frame) {
         int ret = avcodec_send_packet(videoCodecCtx, originalPacket);
-        if (warnOnError(ret == 0, ret).hasErr()) {
+        if (ret < 0) {
             av_packet_free(&originalPacket);
-            return Error;
+            return {true, ret};
         }
         // av_packet_free(&originalPacket);
         frame = av_frame_alloc();
         ret = avcodec_receive_frame(videoCodecCtx, frame);
-        if (warnOnError(ret == 0, ret).hasErr()) {
-            return Error;
+        if (ret < 0) {
+            return {true, ret};
         }
         return NoError;
     }
@@ -129,11 +241,8 @@ public:
                                 AVPacket *&originalPacket,
                                 std::vector<AVFrame *> &frames) {
         int ret = avcodec_send_packet(codecCtx, originalPacket);
-        if (AVERROR_EOF == ret) {
-            return Error;
-        }
-        if (warnOnError(ret == 0, ret).hasErr()) {
-            return Error;
+        if (ret < 0) {
+            return {true, ret};
         }
         // av_packet_free(&originalPacket);
         while (true) {
@@ -145,8 +254,7 @@ public:
             }
             if (ret < 0) {
                 av_frame_free(&frame);
-                warnOnError(false, ret); // 打印错误码
-                return Error;
+                return {true, ret};
             }
             frames.push_back(frame);
         }
@@ -216,16 +324,22 @@ public:
 
 
 
-    class AudioPlayer {
+    // QAudioOutput 声卡输出
+    class AudioPlayer : public AudioSink {
     public:
         AudioPlayer() : audioOutput(nullptr), outputDevice(nullptr) {}
 
-        ~AudioPlayer() {
+        ~AudioPlayer() override {
             Quit(); // 析构时也确保资源清理
         }
 
-        void SetFormat(int dst_nb_samples, int rate, int sample_size, int nch) {
+        void SetFormat(int rate, int sample_size, int nch) override {
+            // 格式没变就保留设备，播放列表换曲时不重新打开声卡
+            if (audioOutput && format_ == std::tuple{rate, sample_size, nch}) {
+                return;
+            }
             Quit(); // 保证旧的 QAudioOutput 释放
+            format_ = {rate, sample_size, nch};
 
             QAudioFormat format;
             format.setSampleRate(rate);
@@ -238,29 +352,40 @@ public:
             audioOutput = new QAudioOutput(format);
             audioOutput->setVolume(1.0);
             outputDevice = audioOutput->start();
+            bytesPerSecond = rate * nch * sample_size / 8;
         }
 
-        void pause() {
+        // 设备里还没播出去的数据时长
+        int64_t bufferedMs() const override {
+            if (!audioOutput || bytesPerSecond <= 0) {
+                return 0;
+            }
+            int64_t pending = audioOutput->bufferSize() - audioOutput->
+                              bytesFree();
+            return pending * 1000 / bytesPerSecond;
+        }
+
+        void pause() override {
             if (audioOutput) {
                 audioOutput->suspend();
             }
         }
 
-        void resume() {
+        void resume() override {
             if (audioOutput && audioOutput->state() == QAudio::SuspendedState) {
                 spdlog::info("resume");
                 audioOutput->resume();
             }
         }
 
-        void writeData(const char *data, qint64 len) {
+        void writeData(const char *data, int64_t len) override {
             if (outputDevice) {
                 resume();
                 outputDevice->write(data, len);
             }
         }
 
-        void Quit() {
+        void Quit() override {
             if (audioOutput) {
                 audioOutput->stop(); // 会自动清理 outputDevice
                 delete audioOutput;
@@ -272,11 +397,27 @@ public:
     private:
         QIODevice *outputDevice{};
         QAudioOutput *audioOutput{};
+        int bytesPerSecond{};
+        std::tuple<int, int, int> format_{};
     };
 
+    // spec: "qt"（默认）/ "null" / "wav:<path>"
+    static std::unique_ptr<AudioSink> makeAudioSink(std::string const &spec) {
+        if (spec == "null") {
+            return std::make_unique<NullAudioSink>();
+        }
+        if (spec.starts_with("wav:")) {
+            return std::make_unique<WavFileSink>(spec.substr(4));
+        }
+        return std::make_unique<AudioPlayer>();
+    }
+
     class SwrResample {
     public:
-        SwrResample() {}
+        explicit SwrResample(std::unique_ptr<AudioSink> sink = nullptr,
+                             PcmProcessor *processor = nullptr)
+            : sink_(sink ? std::move(sink) : std::make_unique<AudioPlayer>()),
+              processor_(processor) {}
 
         ~SwrResample() {
             Close();
@@ -287,15 +428,10 @@ public:
                  enum AVSampleFormat src_sample_fmt,
                  enum AVSampleFormat dst_sample_fmt,
                  int src_nb_samples) {
-#ifdef WRITE_RESAMPLE_PCM_FILE
-    outdecodedswffile = fopen("decode_resample.pcm", "wb");
-    if (!outdecodedswffile) {
-        std::cout << "open out put swr file failed";
-    }
-#endif
-
             src_sample_fmt_ = src_sample_fmt;
             dst_sample_fmt_ = dst_sample_fmt;
+            src_ch_layout_ = src_ch_layout;
+            compensating_ = false;
 
             int ret;
             /* create resampler context */
@@ -339,9 +475,13 @@ public:
             }
             src_nb_samples_ = src_nb_samples;
 
+            src_rate_ = src_rate;
+            dst_rate_ = dst_rate;
+            // 补偿最多拉伸 0.5%，输出缓冲多留一点余量
             int max_dst_nb_samples = dst_nb_samples_ =
                                      av_rescale_rnd(
-                                         src_nb_samples, dst_rate, src_rate,
+                                         src_nb_samples + src_nb_samples /
+                                         100 + 16, dst_rate, src_rate,
                                          AV_ROUND_UP);
 
             dst_nb_channels = av_get_channel_layout_nb_channels(dst_ch_layout);
@@ -356,54 +496,69 @@ public:
             }
 
             int data_size = av_get_bytes_per_sample(dst_sample_fmt_);
-            audioPlayer.SetFormat(dst_nb_samples_, dst_rate, data_size * 8,
-                                  dst_nb_channels);
+            sink_->SetFormat(dst_rate, data_size * 8, dst_nb_channels);
             return 0;
         }
 
         int WriteInput(AVFrame *frame) {
             int planar = av_sample_fmt_is_planar(src_sample_fmt_);
             int data_size = av_get_bytes_per_sample(src_sample_fmt_);
+            // 最后一帧或者下一个节目的帧可能比缓冲小，只转换这次写进来的
+            in_nb_samples_ = std::min(frame->nb_samples, src_nb_samples_);
             if (planar) {
                 for (int ch = 0; ch < src_nb_channels; ch++) {
                     memcpy(src_data_[ch], frame->data[ch],
-                           data_size * frame->nb_samples);
+                           data_size * in_nb_samples_);
                 }
             } else {
-                // memcpy(src_data_[0], frame->data[0],
-                //        data_size * frame->nb_samples * src_nb_channels);
-
-                for (int i = 0; i < frame->nb_samples; i++) {
-                    for (int ch = 0; ch < src_nb_channels; ch++) {
-                        memcpy(src_data_[0], frame->data[ch] + data_size * i,
-                               data_size);
-                    }
-                }
+                // 交错格式所有声道都在 data[0] 里
+                memcpy(src_data_[0], frame->data[0],
+                       data_size * in_nb_samples_ * src_nb_channels);
             }
             return 0;
         }
 
+        // drift_ms = 音频时钟 - 主时钟，正数表示音频超前
+        void UpdateDrift(double drift_ms) {
+            drift_avg_ms_ = drift_avg_ms_ * (1.0 - kDriftAvgCoef) +
+                            drift_ms * kDriftAvgCoef;
+            drift_ms_ = drift_avg_ms_;
+        }
+
+        double DriftMs() const {
+            return drift_ms_;
+        }
+
+        // 当前施加的变速比例，单位 %，正数表示拉伸（放慢）音频
+        double CorrectionPercent() const {
+            return correction_percent_;
+        }
+
+        void SetMaxCorrection(double max_correction) {
+            max_correction_ = max_correction;
+        }
+
         int SwrConvert() {
+            ApplyCompensation();
             int ret = swr_convert(swr_ctx, dst_data_, dst_nb_samples_,
-                                  (uint8_t const **)src_data_, src_nb_samples_);
+                                  (uint8_t const **)src_data_, in_nb_samples_);
             if (ret < 0) {
                 fprintf(stderr, "Error while converting\n");
                 exit(1);
             }
+            return WriteOutput(ret);
+        }
 
-            int dst_bufsize = av_samples_get_buffer_size(
-                &dst_linesize, dst_nb_channels,
-                ret, dst_sample_fmt_, 1);
-
-            int planar = av_sample_fmt_is_planar(dst_sample_fmt_);
-            if (planar) {
-                int data_size = av_get_bytes_per_sample(dst_sample_fmt_);
-            } else {
-                audioPlayer.writeData((const char *)(dst_data_[0]),
-                                      dst_bufsize);
+        // 重建之前把重采样器里还没输出的样本写出去，换节目时不丢
+        void Drain() {
+            if (!swr_ctx || !dst_data_) {
+                return;
+            }
+            int ret = swr_convert(swr_ctx, dst_data_, dst_nb_samples_,
+                                  nullptr, 0);
+            if (ret > 0) {
+                WriteOutput(ret);
             }
-
-            return dst_bufsize;
         }
 
         void Close() {
@@ -422,44 +577,132 @@ public:
             swr_free(&swr_ctx);
         }
 
-        AudioPlayer audioPlayer;
+        // 输入参数是否和当前重采样器一致
+        bool Matches(int64_t src_ch_layout, int src_rate,
+                     AVSampleFormat src_sample_fmt, int nb_samples) const {
+            return swr_ctx && src_ch_layout == src_ch_layout_ &&
+                   src_rate == src_rate_ && src_sample_fmt == src_sample_fmt_
+                   && nb_samples <= src_nb_samples_;
+        }
+
+        AudioSink &audioSink() {
+            return *sink_;
+        }
+
+        static constexpr double kDriftThresholdMs = 40.0;
+        static constexpr double kMaxCorrection = 0.005;
+        // 直播追赶时时钟会快几个百分点，音频要跟得上
+        static constexpr double kLiveMaxCorrection = 0.05;
+        static constexpr double kDriftAvgCoef = 0.1;
 
     private:
-        struct SwrContext *swr_ctx;
+        // 转换出的 nb_samples 个样本交给 sink
+        int WriteOutput(int nb_samples) {
+            int dst_bufsize = av_samples_get_buffer_size(
+                &dst_linesize, dst_nb_channels,
+                nb_samples, dst_sample_fmt_, 1);
 
-        uint8_t **src_data_;
-        uint8_t **dst_data_;
+            int planar = av_sample_fmt_is_planar(dst_sample_fmt_);
+            if (planar) {
+                int data_size = av_get_bytes_per_sample(dst_sample_fmt_);
+            } else {
+                if (processor_ && dst_sample_fmt_ == AV_SAMPLE_FMT_S16) {
+                    processor_->Process(reinterpret_cast<int16_t *>(
+                                            dst_data_[0]), nb_samples,
+                                        dst_nb_channels, dst_rate_);
+                }
+                sink_->writeData((const char *)(dst_data_[0]), dst_bufsize);
+            }
+
+            return dst_bufsize;
+        }
+
+        // 参考 ffplay synchronize_audio：漂移超过阈值时通过
+        // swr_set_compensation 慢慢拉伸/压缩音频，避免硬等待或丢帧
+        void ApplyCompensation() {
+            int nb_samples = in_nb_samples_;
+            if (!swr_ctx || nb_samples <= 0) {
+                return;
+            }
+            double drift = drift_avg_ms_;
+            int wanted = nb_samples;
+            if (std::abs(drift) > kDriftThresholdMs) {
+                wanted += static_cast<int>(drift * src_rate_ / 1000.0);
+                int min_nb = nb_samples * (1.0 - max_correction_);
+                int max_nb = nb_samples * (1.0 + max_correction_);
+                wanted = std::clamp(wanted, min_nb, max_nb);
+            }
+            int delta = wanted - nb_samples;
+            if (!delta && !compensating_) {
+                return;
+            }
+            // 补偿距离只有这一帧，转换完就用完了，漂移还在时每帧都要重新
+            // 设置。漂移回到阈值以内时设一次 0 关掉
+            int ret = swr_set_compensation(
+                swr_ctx,
+                delta * dst_rate_ / src_rate_,
+                delta ? wanted * dst_rate_ / src_rate_ : 0);
+            if (warnOnError(ret >= 0, ret)) {
+                compensating_ = false;
+                correction_percent_ = 0;
+                return;
+            }
+            compensating_ = delta != 0;
+            correction_percent_ = 100.0 * delta / nb_samples;
+        }
+
+        struct SwrContext *swr_ctx{};
+
+        uint8_t **src_data_{};
+        uint8_t **dst_data_{};
 
         int src_nb_channels, dst_nb_channels;
         int src_linesize, dst_linesize;
         int src_nb_samples_, dst_nb_samples_;
+        int in_nb_samples_{}; // 这次写进来的样本数
 
         enum AVSampleFormat dst_sample_fmt_;
 
         enum AVSampleFormat src_sample_fmt_;
 
-#ifdef WRITE_RESAMPLE_PCM_FILE
-        FILE* outdecodedswffile;
-#endif
+        int64_t src_ch_layout_{};
+        int src_rate_{}, dst_rate_{};
+        double drift_avg_ms_{};
+        double max_correction_{kMaxCorrection};
+        bool compensating_{};
+        std::atomic<double> drift_ms_{};
+        std::atomic<double> correction_percent_{};
+
+        std::unique_ptr<AudioSink> sink_;
+        PcmProcessor *processor_{};
     };
 
 
     static HasError decodeAudio(SwrResample *&swrResample, AVFrame *frame,
-                                AVCodecContext *audioCodecCtx
+                                AVCodecContext *audioCodecCtx,
+                                AudioSinkFactory const &makeSink = {},
+                                PcmProcessor *processor = nullptr
         ) {
-        if (!swrResample) {
-            swrResample = new SwrResample{};
-
-            int src_ch_layout = audioCodecCtx->channel_layout;
-            int src_rate = audioCodecCtx->sample_rate;
-            AVSampleFormat src_sample_fmt = audioCodecCtx->sample_fmt;
+        int src_ch_layout = audioCodecCtx->channel_layout;
+        int src_rate = audioCodecCtx->sample_rate;
+        AVSampleFormat src_sample_fmt = audioCodecCtx->sample_fmt;
 
-            int dst_ch_layout = AV_CH_LAYOUT_STEREO;
-            int dst_rate = 44100;
-            AVSampleFormat dst_sample_fmt = AV_SAMPLE_FMT_S16;
+        int dst_ch_layout = AV_CH_LAYOUT_STEREO;
+        int dst_rate = 44100;
+        AVSampleFormat dst_sample_fmt = AV_SAMPLE_FMT_S16;
 
-            int src_nb_samples = frame->nb_samples;
+        int src_nb_samples = frame->nb_samples;
 
+        if (!swrResample) {
+            swrResample = new SwrResample{makeSink ? makeSink() : nullptr,
+                                          processor};
+            swrResample->Init(src_ch_layout, dst_ch_layout, src_rate, dst_rate,
+                              src_sample_fmt, dst_sample_fmt, src_nb_samples);
+        } else if (!swrResample->Matches(src_ch_layout, src_rate,
+                                         src_sample_fmt, src_nb_samples)) {
+            // 换曲后输入格式变了，只重建重采样器，输出 sink 保持打开
+            swrResample->Drain();
+            swrResample->Close();
             swrResample->Init(src_ch_layout, dst_ch_layout, src_rate, dst_rate,
                               src_sample_fmt, dst_sample_fmt, src_nb_samples);
         }
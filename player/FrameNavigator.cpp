@@ -0,0 +1,394 @@
+#include "FrameNavigator.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <spdlog/spdlog.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+FrameNavigator::FrameNavigator(FrameCallback on_frame, int workers,
+                               size_t cache_budget)
+    : on_frame_(std::move(on_frame)), worker_count_(std::max(workers, 1)),
+      cache_(cache_budget) {}
+
+FrameNavigator::~FrameNavigator() {
+    Close();
+}
+
+bool FrameNavigator::openDecoder(Decoder &decoder) {
+    if (avformat_open_input(&decoder.format_ctx, url_.c_str(), nullptr,
+                            nullptr) != 0) {
+        spdlog::error("navigator: open {} failed", url_);
+        return false;
+    }
+    if (avformat_find_stream_info(decoder.format_ctx, nullptr) < 0) {
+        return false;
+    }
+    int stream = av_find_best_stream(decoder.format_ctx, AVMEDIA_TYPE_VIDEO,
+                                     -1, -1, nullptr, 0);
+    if (stream < 0) {
+        return false;
+    }
+    for (unsigned i = 0; i < decoder.format_ctx->nb_streams; ++i) {
+        if (static_cast<int>(i) != stream) {
+            decoder.format_ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+    AVStream *video = decoder.format_ctx->streams[stream];
+    const AVCodec *codec = avcodec_find_decoder(video->codecpar->codec_id);
+    decoder.codec_ctx = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(decoder.codec_ctx, video->codecpar);
+    if (avcodec_open2(decoder.codec_ctx, codec, nullptr) != 0) {
+        return false;
+    }
+    stream_ = stream;
+    time_base_ = video->time_base;
+    AVRational rate = video->avg_frame_rate;
+    if (rate.num > 0 && rate.den > 0) {
+        frame_interval_ms_ = std::max<int64_t>(
+            1, av_rescale_q(1, av_inv_q(rate), {1, 1000}));
+    }
+    return true;
+}
+
+void FrameNavigator::closeDecoder(Decoder &decoder) {
+    avcodec_free_context(&decoder.codec_ctx);
+    if (decoder.format_ctx) {
+        avformat_close_input(&decoder.format_ctx);
+    }
+}
+
+bool FrameNavigator::Open(const std::string &url, KeyframeIndex const *index) {
+    Close();
+    if (!index) {
+        return false;
+    }
+    url_ = url;
+    index_ = index;
+    for (int i = 0; i < worker_count_; ++i) {
+        if (!openDecoder(decoders_.emplace_back())) {
+            Close();
+            return false;
+        }
+    }
+    for (auto &decoder : decoders_) {
+        workers_.emplace_back([this, &decoder](std::stop_token token) {
+            work(token, decoder);
+        });
+    }
+    control_ = std::jthread([this](std::stop_token token) {
+        control(token);
+    });
+    return true;
+}
+
+void FrameNavigator::Close() {
+    control_ = {};
+    workers_.clear();
+    for (auto &decoder : decoders_) {
+        closeDecoder(decoder);
+    }
+    decoders_.clear();
+    jobs_.clear();
+    busy_.clear();
+    entries_.clear();
+    pending_steps_ = 0;
+    reverse_ = false;
+    if (!url_.empty()) {
+        auto s = cache_.stats();
+        spdlog::info("navigator closed: cache hits {} misses {} {} gops {}MB",
+                     s.hits, s.misses, s.gops, s.bytes >> 20);
+    }
+    cache_.Clear();
+    index_ = nullptr;
+    url_.clear();
+}
+
+void FrameNavigator::SetPosition(int64_t pts) {
+    position_ = pts;
+}
+
+int64_t FrameNavigator::positionMs() const {
+    return av_rescale_q(position_.load(), time_base_, {1, 1000});
+}
+
+void FrameNavigator::Step(int direction) {
+    {
+        std::lock_guard<std::mutex> lock(ctl_mtx_);
+        reverse_ = false;
+        pending_steps_ += direction > 0 ? 1 : -1;
+    }
+    ctl_cv_.notify_one();
+}
+
+void FrameNavigator::StartReverse() {
+    {
+        std::lock_guard<std::mutex> lock(ctl_mtx_);
+        pending_steps_ = 0;
+        reverse_ = true;
+    }
+    ctl_cv_.notify_one();
+}
+
+void FrameNavigator::StopReverse() {
+    std::lock_guard<std::mutex> lock(ctl_mtx_);
+    reverse_ = false;
+}
+
+bool FrameNavigator::reversing() const {
+    std::lock_guard<std::mutex> lock(ctl_mtx_);
+    return reverse_;
+}
+
+void FrameNavigator::work(std::stop_token token, Decoder &decoder) {
+    while (!token.stop_requested()) {
+        int64_t key;
+        {
+            std::unique_lock<std::mutex> lock(job_mtx_);
+            if (!job_cv_.wait(lock, token, [&] {
+                return !jobs_.empty();
+            })) {
+                break;
+            }
+            key = jobs_.front();
+            jobs_.pop_front();
+        }
+        if (!cache_.Contains(key) && !decodeGop(decoder, key, token)) {
+            spdlog::warn("navigator: decode gop {} failed", key);
+        }
+        {
+            std::lock_guard<std::mutex> lock(job_mtx_);
+            busy_.erase(key);
+        }
+        done_cv_.notify_all();
+    }
+}
+
+bool FrameNavigator::decodeGop(Decoder &decoder, int64_t key,
+                               std::stop_token const &token) {
+    if (av_seek_frame(decoder.format_ctx, stream_, key, AVSEEK_FLAG_BACKWARD) <
+        0) {
+        return false;
+    }
+    avcodec_flush_buffers(decoder.codec_ctx);
+
+    // [start, end) 由读到的两个关键帧包决定；下一个关键帧之后还要继续解，
+    // 直到输出的帧越过 end，把开放 GOP 里前置的 B 帧收齐
+    int64_t start = AV_NOPTS_VALUE;
+    int64_t end = AV_NOPTS_VALUE;
+    std::vector<AVFrame *> frames;
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    bool done = false;
+    while (!done && !token.stop_requested()) {
+        int ret = av_read_frame(decoder.format_ctx, packet);
+        if (ret == AVERROR_EOF) {
+            avcodec_send_packet(decoder.codec_ctx, nullptr);
+            end = std::numeric_limits<int64_t>::max();
+            done = true;
+        } else if (ret < 0) {
+            break;
+        } else if (packet->stream_index != stream_) {
+            av_packet_unref(packet);
+            continue;
+        } else {
+            if (packet->flags & AV_PKT_FLAG_KEY) {
+                int64_t ts = packet->pts != AV_NOPTS_VALUE
+                                 ? packet->pts
+                                 : packet->dts;
+                if (start == AV_NOPTS_VALUE) {
+                    start = ts;
+                } else if (end == AV_NOPTS_VALUE && ts > start) {
+                    end = ts;
+                }
+            }
+            avcodec_send_packet(decoder.codec_ctx, packet);
+            av_packet_unref(packet);
+        }
+        while (avcodec_receive_frame(decoder.codec_ctx, frame) == 0) {
+            int64_t pts = frame->best_effort_timestamp;
+            if (end != AV_NOPTS_VALUE && pts >= end) {
+                done = true;
+            } else if (start != AV_NOPTS_VALUE && pts >= start) {
+                frames.push_back(av_frame_clone(frame));
+            }
+            av_frame_unref(frame);
+        }
+    }
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+
+    if (token.stop_requested() || frames.empty() || end == AV_NOPTS_VALUE) {
+        for (auto *f : frames) {
+            av_frame_free(&f);
+        }
+        return false;
+    }
+    std::sort(frames.begin(), frames.end(), [](AVFrame *a, AVFrame *b) {
+        return a->best_effort_timestamp < b->best_effort_timestamp;
+    });
+    cache_.InsertGop(key, start, end, std::move(frames));
+    return true;
+}
+
+size_t FrameNavigator::entryFor(int64_t pts) {
+    // 后台扫描的索引可能是后来才建好的
+    if (entries_.size() != index_->size()) {
+        entries_ = index_->entries();
+    }
+    auto it = std::upper_bound(entries_.begin(), entries_.end(), pts,
+                               [](int64_t value, auto const &entry) {
+                                   return value < entry.pts;
+                               });
+    return it == entries_.begin() ? 0 : it - entries_.begin() - 1;
+}
+
+bool FrameNavigator::ensureGop(int64_t key, std::stop_token const &token) {
+    if (cache_.Contains(key)) {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(job_mtx_);
+    if (!busy_.contains(key)) {
+        busy_.insert(key);
+        // 当前要显示的 GOP 插到预取任务前面
+        jobs_.push_front(key);
+        job_cv_.notify_one();
+    }
+    done_cv_.wait(lock, token, [&] {
+        return !busy_.contains(key);
+    });
+    return cache_.Contains(key);
+}
+
+void FrameNavigator::prefetch(int64_t key) {
+    if (cache_.Contains(key)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(job_mtx_);
+    if (busy_.insert(key).second) {
+        jobs_.push_back(key);
+        job_cv_.notify_one();
+    }
+}
+
+bool FrameNavigator::ensureCovering(int64_t pts,
+                                    std::stop_token const &token) {
+    if (cache_.Range(pts)) {
+        return true;
+    }
+    size_t i = entryFor(pts);
+    if (entries_.empty()) {
+        return false;
+    }
+    // 容器索引的时间戳可能是 dts，比帧 pts 略小，GOP 边界附近再看前一个
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (!ensureGop(entries_[i].pts, token)) {
+            return false;
+        }
+        if (cache_.Range(pts)) {
+            return true;
+        }
+        if (i == 0) {
+            break;
+        }
+        --i;
+    }
+    return false;
+}
+
+AVFrame *FrameNavigator::prevFrame(int64_t pts, int64_t &frame_pts,
+                                   std::stop_token const &token) {
+    if (AVFrame *frame = cache_.Prev(pts, frame_pts)) {
+        return frame;
+    }
+    if (!ensureCovering(pts, token)) {
+        return nullptr;
+    }
+    if (AVFrame *frame = cache_.Prev(pts, frame_pts)) {
+        return frame;
+    }
+    // pts 是本 GOP 第一帧，要解前一个 GOP
+    auto range = cache_.Range(pts);
+    if (!range || !ensureCovering(range->first - 1, token)) {
+        return nullptr;
+    }
+    return cache_.Prev(pts, frame_pts);
+}
+
+AVFrame *FrameNavigator::nextFrame(int64_t pts, int64_t &frame_pts,
+                                   std::stop_token const &token) {
+    if (AVFrame *frame = cache_.Next(pts, frame_pts)) {
+        return frame;
+    }
+    if (!ensureCovering(pts, token)) {
+        return nullptr;
+    }
+    if (AVFrame *frame = cache_.Next(pts, frame_pts)) {
+        return frame;
+    }
+    auto range = cache_.Range(pts);
+    if (!range || range->second == std::numeric_limits<int64_t>::max() ||
+        !ensureCovering(range->second, token)) {
+        return nullptr;
+    }
+    return cache_.Next(pts, frame_pts);
+}
+
+void FrameNavigator::control(std::stop_token token) {
+    using namespace std::chrono;
+    auto next_tick = steady_clock::now();
+    bool was_reversing = false;
+    while (!token.stop_requested()) {
+        int step = 0;
+        bool reverse;
+        {
+            std::unique_lock<std::mutex> lock(ctl_mtx_);
+            if (!ctl_cv_.wait(lock, token, [&] {
+                return pending_steps_ != 0 || reverse_;
+            })) {
+                break;
+            }
+            reverse = reverse_;
+            if (!reverse) {
+                step = pending_steps_ > 0 ? 1 : -1;
+                pending_steps_ -= step;
+            }
+        }
+        if (reverse && !was_reversing) {
+            next_tick = steady_clock::now();
+        }
+        was_reversing = reverse;
+
+        int64_t frame_pts = 0;
+        AVFrame *frame = reverse || step < 0
+                             ? prevFrame(position_, frame_pts, token)
+                             : nextFrame(position_, frame_pts, token);
+        if (!frame) {
+            // 到了文件头/尾，或者没有索引
+            std::lock_guard<std::mutex> lock(ctl_mtx_);
+            pending_steps_ = 0;
+            reverse_ = false;
+            continue;
+        }
+        position_ = frame_pts;
+        on_frame_(frame, av_rescale_q(frame_pts, time_base_, {1, 1000}));
+
+        if (reverse) {
+            // 当前 GOP 放完之前把前两个 GOP 解好
+            size_t i = entryFor(frame_pts);
+            for (size_t ahead = 1; ahead <= 2 && i >= ahead; ++ahead) {
+                prefetch(entries_[i - ahead].pts);
+            }
+            next_tick += milliseconds(frame_interval_ms_);
+            auto now = steady_clock::now();
+            if (next_tick < now) {
+                // 解码跟不上时不追帧，从现在重新计时
+                next_tick = now;
+            }
+            std::this_thread::sleep_until(next_tick);
+        }
+    }
+}
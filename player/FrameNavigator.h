@@ -0,0 +1,102 @@
+#pragma once
+#include "GopCache.h"
+#include "KeyframeIndex.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct AVFrame;
+struct AVFormatContext;
+struct AVCodecContext;
+
+// 逐帧前进/后退和倒放。独立的 demuxer + 解码器按 GOP 整段解码放进
+// GopCache，缓存里的帧直接取出显示；倒放时工作线程提前解码前面的 GOP
+class FrameNavigator {
+public:
+    // 在控制线程回调，frame 由接收方释放
+    using FrameCallback = std::function<void(AVFrame *frame, int64_t pts_ms)>;
+
+    explicit FrameNavigator(FrameCallback on_frame, int workers = 2,
+                            size_t cache_budget = 256 * 1024 * 1024);
+    ~FrameNavigator();
+
+    // 需要关键帧索引确定 GOP 边界
+    bool Open(const std::string &url, KeyframeIndex const *index);
+    void Close();
+
+    // 逐帧/倒放的起点，一般是当前显示的那一帧，视频流 time_base。原样
+    // 保存，换算成毫秒再换回来会落在帧之间，前进一帧又找回同一帧
+    void SetPosition(int64_t pts);
+    int64_t positionMs() const;
+
+    // direction > 0 前进一帧，< 0 后退一帧，连续调用会累计
+    void Step(int direction);
+    void StartReverse();
+    void StopReverse();
+    bool reversing() const;
+
+    const std::string &url() const {
+        return url_;
+    }
+
+    GopCache::Stats cacheStats() const {
+        return cache_.stats();
+    }
+
+private:
+    struct Decoder {
+        AVFormatContext *format_ctx{};
+        AVCodecContext *codec_ctx{};
+    };
+
+    bool openDecoder(Decoder &decoder);
+    void closeDecoder(Decoder &decoder);
+    void control(std::stop_token token);
+    void work(std::stop_token token, Decoder &decoder);
+    bool decodeGop(Decoder &decoder, int64_t key, std::stop_token const &token);
+
+    // 以下只在控制线程调用
+    bool ensureGop(int64_t key, std::stop_token const &token);
+    void prefetch(int64_t key);
+    bool ensureCovering(int64_t pts, std::stop_token const &token);
+    AVFrame *prevFrame(int64_t pts, int64_t &frame_pts,
+                       std::stop_token const &token);
+    AVFrame *nextFrame(int64_t pts, int64_t &frame_pts,
+                       std::stop_token const &token);
+    size_t entryFor(int64_t pts);
+
+    FrameCallback on_frame_;
+    int worker_count_;
+    std::string url_;
+    KeyframeIndex const *index_{};
+    std::vector<KeyframeIndex::Entry> entries_; // 控制线程里的索引快照
+    int stream_{-1};
+    AVRational time_base_{1, 1000};
+    int64_t frame_interval_ms_{40};
+    GopCache cache_;
+
+    // 解码任务：GOP 的索引时间戳
+    std::mutex job_mtx_;
+    std::condition_variable_any job_cv_;
+    std::condition_variable_any done_cv_;
+    std::deque<int64_t> jobs_;
+    std::set<int64_t> busy_; // 排队中或正在解码
+
+    mutable std::mutex ctl_mtx_;
+    std::condition_variable_any ctl_cv_;
+    int pending_steps_{};
+    bool reverse_{};
+    std::atomic<int64_t> position_{0}; // 视频流 time_base
+
+    std::deque<Decoder> decoders_;
+    std::vector<std::jthread> workers_;
+    std::jthread control_;
+};
@@ -0,0 +1,164 @@
+#include "GopCache.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+}
+
+namespace {
+size_t frameBytes(AVFrame const *frame) {
+    int size = av_image_get_buffer_size(
+        static_cast<AVPixelFormat>(frame->format), frame->width,
+        frame->height, 1);
+    return size > 0 ? static_cast<size_t>(size) : 0;
+}
+}
+
+GopCache::GopCache(size_t budget) : budget_(budget) {}
+
+GopCache::~GopCache() {
+    Clear();
+}
+
+void GopCache::InsertGop(int64_t key, int64_t start, int64_t end,
+                         std::vector<AVFrame *> frames) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (keys_.contains(key) || gops_.contains(start)) {
+        for (auto *frame : frames) {
+            av_frame_free(&frame);
+        }
+        return;
+    }
+    Gop gop{start, end, {}, 0, {}};
+    for (auto *frame : frames) {
+        if (gop.frames.emplace(frame->best_effort_timestamp, frame).second) {
+            gop.bytes += frameBytes(frame);
+        } else {
+            av_frame_free(&frame);
+        }
+    }
+    lru_.push_front(start);
+    gop.lru = lru_.begin();
+    bytes_ += gop.bytes;
+    gops_.emplace(start, std::move(gop));
+    keys_.emplace(key, start);
+    evict();
+}
+
+bool GopCache::Contains(int64_t key) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return keys_.contains(key);
+}
+
+std::optional<std::pair<int64_t, int64_t>>
+GopCache::Range(int64_t pts) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = gops_.upper_bound(pts);
+    if (it == gops_.begin()) {
+        return std::nullopt;
+    }
+    --it;
+    if (pts >= it->second.end) {
+        return std::nullopt;
+    }
+    return std::pair{it->second.start, it->second.end};
+}
+
+GopCache::GopMap::iterator GopCache::covering(int64_t pts) {
+    auto it = gops_.upper_bound(pts);
+    if (it == gops_.begin()) {
+        return gops_.end();
+    }
+    --it;
+    return pts < it->second.end ? it : gops_.end();
+}
+
+AVFrame *GopCache::take(GopMap::iterator gop,
+                        std::map<int64_t, AVFrame *>::iterator it,
+                        int64_t &frame_pts) {
+    touch(gop->second);
+    hits_++;
+    frame_pts = it->first;
+    return av_frame_clone(it->second);
+}
+
+AVFrame *GopCache::Prev(int64_t pts, int64_t &frame_pts) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto gop = covering(pts);
+    if (gop != gops_.end()) {
+        auto &frames = gop->second.frames;
+        auto it = frames.lower_bound(pts);
+        if (it != frames.begin()) {
+            return take(gop, std::prev(it), frame_pts);
+        }
+        // 已经是本 GOP 第一帧，看前一个 GOP 是否首尾相接
+        int64_t start = gop->second.start;
+        if (gop != gops_.begin()) {
+            auto before = std::prev(gop);
+            if (before->second.end == start &&
+                !before->second.frames.empty()) {
+                return take(before, std::prev(before->second.frames.end()),
+                            frame_pts);
+            }
+        }
+    }
+    misses_++;
+    return nullptr;
+}
+
+AVFrame *GopCache::Next(int64_t pts, int64_t &frame_pts) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto gop = covering(pts);
+    if (gop != gops_.end()) {
+        auto &frames = gop->second.frames;
+        auto it = frames.upper_bound(pts);
+        if (it != frames.end()) {
+            return take(gop, it, frame_pts);
+        }
+        auto after = std::next(gop);
+        if (after != gops_.end() && after->second.start == gop->second.end &&
+            !after->second.frames.empty()) {
+            return take(after, after->second.frames.begin(), frame_pts);
+        }
+    }
+    misses_++;
+    return nullptr;
+}
+
+void GopCache::touch(Gop &gop) {
+    lru_.splice(lru_.begin(), lru_, gop.lru);
+}
+
+void GopCache::evict() {
+    // 最近放入的 GOP 始终保留，即使它自己就超过了预算
+    while (bytes_ > budget_ && lru_.size() > 1) {
+        auto it = gops_.find(lru_.back());
+        lru_.pop_back();
+        bytes_ -= it->second.bytes;
+        for (auto &[pts, frame] : it->second.frames) {
+            av_frame_free(&frame);
+        }
+        std::erase_if(keys_, [start = it->first](auto const &entry) {
+            return entry.second == start;
+        });
+        gops_.erase(it);
+    }
+}
+
+void GopCache::Clear() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto &[start, gop] : gops_) {
+        for (auto &[pts, frame] : gop.frames) {
+            av_frame_free(&frame);
+        }
+    }
+    gops_.clear();
+    keys_.clear();
+    lru_.clear();
+    bytes_ = 0;
+}
+
+GopCache::Stats GopCache::stats() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return {hits_, misses_, bytes_, gops_.size()};
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+struct AVFrame;
+
+// 解码后的帧按 GOP 缓存，以 GOP 为单位做 LRU 淘汰，总字节数不超过预算。
+// 帧按 pts 索引，相邻 GOP 首尾相接时可以跨 GOP 前后取帧
+class GopCache {
+public:
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        size_t bytes;
+        size_t gops;
+    };
+
+    explicit GopCache(size_t budget = 256 * 1024 * 1024);
+    ~GopCache();
+
+    GopCache(const GopCache &) = delete;
+    GopCache &operator=(const GopCache &) = delete;
+
+    // key 为关键帧索引里的时间戳，[start, end) 为这个 GOP 覆盖的 pts，
+    // frames 按 pts 排好，所有权转给缓存
+    void InsertGop(int64_t key, int64_t start, int64_t end,
+                   std::vector<AVFrame *> frames);
+    bool Contains(int64_t key) const;
+
+    // 包含 pts 的 GOP 覆盖范围
+    std::optional<std::pair<int64_t, int64_t>> Range(int64_t pts) const;
+
+    // 严格早于 / 晚于 pts 的相邻帧，返回 clone 由调用方释放；
+    // 需要的 GOP 不在缓存里时返回空
+    AVFrame *Prev(int64_t pts, int64_t &frame_pts);
+    AVFrame *Next(int64_t pts, int64_t &frame_pts);
+
+    void Clear();
+    Stats stats() const;
+
+private:
+    struct Gop {
+        int64_t start;
+        int64_t end;
+        std::map<int64_t, AVFrame *> frames;
+        size_t bytes;
+        std::list<int64_t>::iterator lru;
+    };
+
+    using GopMap = std::map<int64_t, Gop>;
+
+    GopMap::iterator covering(int64_t pts);
+    AVFrame *take(GopMap::iterator gop,
+                  std::map<int64_t, AVFrame *>::iterator it,
+                  int64_t &frame_pts);
+    void touch(Gop &gop);
+    void evict();
+
+    mutable std::mutex mtx_;
+    GopMap gops_; // 按 start 排序
+    std::map<int64_t, int64_t> keys_; // 索引时间戳 -> start
+    std::list<int64_t> lru_; // start，最近使用的在前
+    size_t bytes_{};
+    size_t budget_;
+    uint64_t hits_{};
+    uint64_t misses_{};
+};
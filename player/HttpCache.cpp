@@ -0,0 +1,341 @@
+#include "HttpCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr char kRangesMagic[8] = {'Q', 'P', 'H', 'T', 'T', 'P', 'C', '\0'};
+constexpr uint32_t kRangesVersion = 1;
+// 新下载这么多字节就把区间表落盘一次，崩溃时丢的不多
+constexpr uint64_t kSaveInterval = 8 * 1024 * 1024;
+
+// .ranges 文件：header + url + count 个 [begin, end)
+struct RangesHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t urlLength;
+    int64_t size;
+    uint64_t count;
+};
+
+std::string urlKey(const std::string &url) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : url) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx",
+             static_cast<unsigned long long>(hash));
+    return key;
+}
+
+void addRange(std::map<int64_t, int64_t> &ranges, int64_t begin,
+              int64_t end) {
+    auto it = ranges.upper_bound(begin);
+    if (it != ranges.begin()) {
+        auto prev = std::prev(it);
+        if (prev->second >= begin) {
+            begin = prev->first;
+            end = std::max(end, prev->second);
+            it = ranges.erase(prev);
+        }
+    }
+    while (it != ranges.end() && it->first <= end) {
+        end = std::max(end, it->second);
+        it = ranges.erase(it);
+    }
+    ranges[begin] = end;
+}
+}
+
+HttpCache::File::File(HttpCache &cache, std::string url, std::string key)
+    : cache_(cache), url_(std::move(url)), key_(std::move(key)) {}
+
+HttpCache::File::~File() {
+    if (fd_ >= 0) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (dirty_) {
+            save();
+        }
+        ::close(fd_);
+        // 更新最近使用时间，只读命中也算
+        std::string ranges = cache_.path(key_, ".ranges");
+        utimensat(AT_FDCWD, ranges.c_str(), nullptr, 0);
+    }
+    cache_.Evict();
+}
+
+bool HttpCache::File::load() {
+    std::string data = cache_.path(key_, ".data");
+    fd_ = ::open(data.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        spdlog::warn("open cache file {} failed: {}", data, strerror(errno));
+        return false;
+    }
+    FILE *file = fopen(cache_.path(key_, ".ranges").c_str(), "rb");
+    if (!file) {
+        return true;
+    }
+    RangesHeader header{};
+    std::string url;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 std::memcmp(header.magic, kRangesMagic,
+                             sizeof(kRangesMagic)) == 0 &&
+                 header.version == kRangesVersion &&
+                 header.urlLength == url_.size();
+    if (valid) {
+        url.resize(header.urlLength);
+        valid = fread(url.data(), 1, url.size(), file) == url.size() &&
+                url == url_;
+    }
+    for (uint64_t i = 0; valid && i < header.count; ++i) {
+        int64_t range[2];
+        valid = fread(range, sizeof(range), 1, file) == 1 &&
+                range[0] < range[1] && range[1] <= header.size;
+        if (valid) {
+            addRange(ranges_, range[0], range[1]);
+        }
+    }
+    fclose(file);
+    if (!valid) {
+        // 损坏或者 key 冲突，当成没有缓存
+        ranges_.clear();
+        return ftruncate(fd_, 0) == 0;
+    }
+    size_ = header.size;
+    return true;
+}
+
+void HttpCache::File::save() {
+    std::string path = cache_.path(key_, ".ranges");
+    std::string tmp = path + ".tmp";
+    FILE *file = fopen(tmp.c_str(), "wb");
+    if (!file) {
+        return;
+    }
+    RangesHeader header{};
+    std::memcpy(header.magic, kRangesMagic, sizeof(kRangesMagic));
+    header.version = kRangesVersion;
+    header.urlLength = url_.size();
+    header.size = size_;
+    header.count = ranges_.size();
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(url_.data(), 1, url_.size(), file) == url_.size();
+    for (auto [begin, end] : ranges_) {
+        int64_t range[2] = {begin, end};
+        ok = ok && fwrite(range, sizeof(range), 1, file) == 1;
+    }
+    ok = fclose(file) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return;
+    }
+    dirty_ = 0;
+}
+
+int64_t HttpCache::File::size() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return size_;
+}
+
+void HttpCache::File::setSize(int64_t size) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (size_ == size) {
+        return;
+    }
+    if (size_ >= 0) {
+        spdlog::info("{} changed size {} -> {}, drop cache", url_, size_,
+                     size);
+        ranges_.clear();
+        (void)ftruncate(fd_, 0);
+    }
+    size_ = size;
+    // 稀疏文件，没写过的地方不占磁盘
+    (void)ftruncate(fd_, size);
+    dirty_ = 1;
+}
+
+bool HttpCache::File::complete() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return size_ > 0 && ranges_.size() == 1 &&
+           ranges_.begin()->first == 0 && ranges_.begin()->second >= size_;
+}
+
+int64_t HttpCache::File::cachedEnd(int64_t pos, int64_t &next) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = ranges_.upper_bound(pos);
+    if (it != ranges_.end()) {
+        next = it->first;
+    } else {
+        next = size_ >= 0 ? size_ : INT64_MAX;
+    }
+    if (it != ranges_.begin()) {
+        auto prev = std::prev(it);
+        if (prev->second > pos) {
+            return prev->second;
+        }
+    }
+    return -1;
+}
+
+ssize_t HttpCache::File::read(uint8_t *buf, size_t len, int64_t pos) {
+    ssize_t n = ::pread(fd_, buf, len, pos);
+    if (n > 0) {
+        cache_.hit_bytes_.fetch_add(n, std::memory_order_relaxed);
+    }
+    return n;
+}
+
+void HttpCache::File::write(const uint8_t *buf, size_t len, int64_t pos) {
+    size_t written = 0;
+    while (written < len) {
+        ssize_t n = ::pwrite(fd_, buf + written, len - written,
+                             pos + written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            // 磁盘满之类，只记录写成功的部分，播放不受影响
+            break;
+        }
+        written += n;
+    }
+    cache_.miss_bytes_.fetch_add(len, std::memory_order_relaxed);
+    if (written == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    addRange(ranges_, pos, pos + written);
+    dirty_ += written;
+    if (dirty_ >= kSaveInterval) {
+        save();
+    }
+}
+
+HttpCache::HttpCache(Options options) : options_(std::move(options)) {
+    std::error_code ec;
+    fs::create_directories(options_.dir, ec);
+    Evict();
+}
+
+HttpCache::~HttpCache() = default;
+
+HttpCache &HttpCache::Default() {
+    static HttpCache cache([] {
+        Options options;
+        if (const char *dir = std::getenv("PLAYER_CACHE_DIR")) {
+            options.dir = dir;
+        } else if (const char *xdg = std::getenv("XDG_CACHE_HOME")) {
+            options.dir = std::string(xdg) + "/ffmpeg_qt_player/http";
+        } else {
+            const char *home = std::getenv("HOME");
+            options.dir = std::string(home ? home : "/tmp") +
+                          "/.cache/ffmpeg_qt_player/http";
+        }
+        if (const char *mb = std::getenv("PLAYER_CACHE_MB")) {
+            options.budget = std::strtoull(mb, nullptr, 10) * 1024 * 1024;
+        }
+        return options;
+    }());
+    return cache;
+}
+
+std::shared_ptr<HttpCache::File> HttpCache::Open(const std::string &url) {
+    // 加载失败的 File 要在锁外析构，~File 里会调 Evict
+    std::shared_ptr<File> failed;
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (auto file = open_[url].lock()) {
+        return file;
+    }
+    std::shared_ptr<File> file(new File(*this, url, urlKey(url)));
+    if (!file->load()) {
+        open_.erase(url);
+        failed = std::move(file);
+        return nullptr;
+    }
+    open_[url] = file;
+    return file;
+}
+
+void HttpCache::Evict() {
+    // 别的线程刚好放掉引用时这里拿到的是最后一个，同样要在锁外析构
+    std::vector<std::shared_ptr<File>> files;
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<std::string> in_use;
+    for (auto it = open_.begin(); it != open_.end();) {
+        if (auto file = it->second.lock()) {
+            in_use.push_back(file->key_);
+            files.push_back(std::move(file));
+            ++it;
+        } else {
+            it = open_.erase(it);
+        }
+    }
+
+    struct Entry {
+        fs::file_time_type used;
+        std::string key;
+        uint64_t bytes;
+        bool open;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (auto const &item : fs::directory_iterator(options_.dir, ec)) {
+        if (item.path().extension() != ".data") {
+            continue;
+        }
+        std::string key = item.path().stem().string();
+        struct stat st{};
+        if (::stat(item.path().c_str(), &st) != 0) {
+            continue;
+        }
+        // 稀疏文件按实际占用的块算
+        uint64_t bytes = static_cast<uint64_t>(st.st_blocks) * 512;
+        bool open = std::find(in_use.begin(), in_use.end(), key) !=
+                    in_use.end();
+        auto used = fs::last_write_time(path(key, ".ranges"), ec);
+        if (ec && !open) {
+            // 没有区间表的是没缓存成的残留，直接删
+            std::remove(item.path().c_str());
+            continue;
+        }
+        entries.push_back({used, key, bytes, open});
+        total += bytes;
+    }
+    std::sort(entries.begin(), entries.end(), [](auto &a, auto &b) {
+        return a.used < b.used;
+    });
+    for (auto const &entry : entries) {
+        if (total <= options_.budget) {
+            break;
+        }
+        if (entry.open) {
+            continue;
+        }
+        std::remove(path(entry.key, ".data").c_str());
+        std::remove(path(entry.key, ".ranges").c_str());
+        total -= entry.bytes;
+        evicted_files_.fetch_add(1, std::memory_order_relaxed);
+        spdlog::info("http cache evicted {} ({} bytes)", entry.key,
+                     entry.bytes);
+    }
+    disk_bytes_ = total;
+}
+
+HttpCache::Stats HttpCache::stats() const {
+    return {hit_bytes_, miss_bytes_, evicted_files_, disk_bytes_};
+}
+
+std::string HttpCache::path(const std::string &key, const char *ext) const {
+    return options_.dir + "/" + key + ext;
+}
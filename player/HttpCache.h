@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+
+// 网络源的本地磁盘缓存。每个 url 对应一个稀疏数据文件 <key>.data 和
+// 一个区间表 <key>.ranges，下载过的字节按原偏移写进数据文件。所有缓存
+// 共享一个字节预算，超出时按最近使用时间淘汰没有在用的文件
+class HttpCache {
+public:
+    struct Options {
+        std::string dir;
+        uint64_t budget = 2ull * 1024 * 1024 * 1024;
+    };
+
+    struct Stats {
+        uint64_t hitBytes;  // 从本地读出的
+        uint64_t missBytes; // 从网络下载的
+        uint64_t evictedFiles;
+        uint64_t diskBytes; // 最近一次淘汰时统计的占用
+    };
+
+    // 一个 url 的缓存，同一个 url 同时打开多次时共用
+    class File {
+    public:
+        ~File();
+
+        File(const File &) = delete;
+        File &operator=(const File &) = delete;
+
+        // 未知时为 -1
+        int64_t size() const;
+        // 和已知的大小不一样说明远端文件变了，丢掉旧数据
+        void setSize(int64_t size);
+        bool complete() const;
+
+        // pos 已缓存时返回所在区间的末尾，否则返回 -1，
+        // next 为 pos 之后第一个缓存区间的起点
+        int64_t cachedEnd(int64_t pos, int64_t &next) const;
+        ssize_t read(uint8_t *buf, size_t len, int64_t pos);
+        void write(const uint8_t *buf, size_t len, int64_t pos);
+
+    private:
+        friend class HttpCache;
+        File(HttpCache &cache, std::string url, std::string key);
+
+        bool load();
+        void save();
+
+        HttpCache &cache_;
+        std::string url_;
+        std::string key_;
+        int fd_{-1};
+        mutable std::mutex mtx_;
+        int64_t size_{-1};
+        std::map<int64_t, int64_t> ranges_; // begin -> end，互不重叠
+        uint64_t dirty_{};
+    };
+
+    explicit HttpCache(Options options);
+    ~HttpCache();
+
+    // 目录和预算来自 PLAYER_CACHE_DIR / PLAYER_CACHE_MB
+    static HttpCache &Default();
+
+    std::shared_ptr<File> Open(const std::string &url);
+    // 淘汰到预算以内，正在用的文件不动
+    void Evict();
+
+    Stats stats() const;
+
+    const std::string &dir() const {
+        return options_.dir;
+    }
+
+private:
+    std::string path(const std::string &key, const char *ext) const;
+
+    Options options_;
+    std::mutex mtx_;
+    std::map<std::string, std::weak_ptr<File>> open_;
+    std::atomic<uint64_t> hit_bytes_{0};
+    std::atomic<uint64_t> miss_bytes_{0};
+    std::atomic<uint64_t> evicted_files_{0};
+    std::atomic<uint64_t> disk_bytes_{0};
+};
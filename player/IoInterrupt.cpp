@@ -0,0 +1,65 @@
+#include "IoInterrupt.h"
+#include <spdlog/spdlog.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace {
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+IoInterrupt::Deadline::Deadline(IoInterrupt &io,
+                                std::chrono::milliseconds timeout)
+    : io_(io) {
+    io_.timed_out_ = false;
+    io_.deadline_ns_ =
+        nowNs() +
+        std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+}
+
+IoInterrupt::Deadline::~Deadline() {
+    io_.deadline_ns_ = 0;
+}
+
+IoInterrupt::IoInterrupt(Predicate extra) : extra_(std::move(extra)) {}
+
+void IoInterrupt::Install(AVFormatContext *ctx) {
+    Fill(ctx->interrupt_callback);
+}
+
+void IoInterrupt::Fill(AVIOInterruptCB &cb) {
+    cb.callback = &IoInterrupt::Interrupted;
+    cb.opaque = this;
+}
+
+void IoInterrupt::Stop() {
+    stopped_ = true;
+}
+
+void IoInterrupt::Reset() {
+    stopped_ = false;
+    timed_out_ = false;
+    deadline_ns_ = 0;
+}
+
+int IoInterrupt::Interrupted(void *opaque) {
+    return static_cast<IoInterrupt *>(opaque)->check();
+}
+
+bool IoInterrupt::check() {
+    if (stopped_) {
+        return true;
+    }
+    int64_t deadline = deadline_ns_;
+    if (deadline != 0 && nowNs() > deadline) {
+        if (!timed_out_.exchange(true)) {
+            spdlog::warn("io deadline exceeded, interrupting");
+        }
+        return true;
+    }
+    return extra_ && extra_();
+}
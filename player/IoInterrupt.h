@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+struct AVFormatContext;
+struct AVIOInterruptCB;
+
+// FFmpeg 阻塞 I/O 的中断回调：会话停止、当前操作超过截止时间，或者额外
+// 条件成立时让 avformat_open_input / av_read_frame / av_seek_frame 尽快
+// 返回 AVERROR_EXIT。网络协议大约每 100ms 检查一次，死掉的连接不用等到
+// TCP 超时。一个实例同一时间只给一个线程做 I/O 用
+class IoInterrupt {
+public:
+    using Predicate = std::function<bool()>;
+
+    // 一次操作的截止时间，析构时取消
+    class Deadline {
+    public:
+        Deadline(IoInterrupt &io, std::chrono::milliseconds timeout);
+        ~Deadline();
+
+        Deadline(const Deadline &) = delete;
+        Deadline &operator=(const Deadline &) = delete;
+
+    private:
+        IoInterrupt &io_;
+    };
+
+    explicit IoInterrupt(Predicate extra = {});
+
+    // 装到 ctx 上，ctx 的生命周期不能超过这个对象
+    void Install(AVFormatContext *ctx);
+    void Fill(AVIOInterruptCB &cb);
+
+    // 之后的 I/O 立刻返回，直到 Reset
+    void Stop();
+    void Reset();
+    bool Stopped() const {
+        return stopped_;
+    }
+
+    // 最近一次中断是不是因为超时，Deadline 构造时清掉
+    bool TimedOut() const {
+        return timed_out_;
+    }
+
+    static int Interrupted(void *opaque);
+
+private:
+    bool check();
+
+    Predicate extra_;
+    std::atomic_bool stopped_{false};
+    std::atomic_bool timed_out_{false};
+    // steady_clock 的纳秒数，0 表示没有截止时间
+    std::atomic<int64_t> deadline_ns_{0};
+};
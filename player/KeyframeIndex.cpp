@@ -0,0 +1,372 @@
+#include "KeyframeIndex.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <spdlog/spdlog.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace {
+int scanInterrupted(void *opaque) {
+    return static_cast<std::stop_token *>(opaque)->stop_requested();
+}
+
+bool byPts(KeyframeIndex::Entry const &a, KeyframeIndex::Entry const &b) {
+    return a.pts < b.pts;
+}
+
+constexpr char kSidecarMagic[8] = {'Q', 'P', 'K', 'F', 'I', 'D', 'X', '\0'};
+constexpr uint32_t kSidecarVersion = 1;
+
+// sidecar 文件：header 后面紧跟 count 个 Entry
+struct SidecarHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t streamIndex;
+    int32_t timeBaseNum;
+    int32_t timeBaseDen;
+    uint64_t mediaSize;
+    int64_t mediaMtime;
+    int64_t duration;
+    uint64_t count;
+    uint64_t checksum; // 所有 entry 的 FNV-1a
+};
+
+static_assert(sizeof(KeyframeIndex::Entry) == 16);
+static_assert(sizeof(SidecarHeader) % alignof(KeyframeIndex::Entry) == 0);
+
+uint64_t checksum(std::span<const KeyframeIndex::Entry> entries) {
+    uint64_t hash = 14695981039346656037ull;
+    auto *bytes = reinterpret_cast<const unsigned char *>(entries.data());
+    for (size_t i = 0; i < entries.size_bytes(); ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string sidecarPath(const std::string &url) {
+    return url + ".kfidx";
+}
+
+// 只有本地文件才有 sidecar
+bool mediaKey(const std::string &url, uint64_t &size, int64_t &mtime) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (!fs::is_regular_file(url, ec)) {
+        return false;
+    }
+    size = fs::file_size(url, ec);
+    mtime = fs::last_write_time(url, ec).time_since_epoch().count();
+    return !ec;
+}
+}
+
+void KeyframeIndex::Reset() {
+    scan_task_ = {};
+    std::lock_guard<std::mutex> lock(mtx_);
+    unmap();
+    entries_.clear();
+    view_ = {};
+    duration_ = -1;
+    from_scan_ = false;
+}
+
+void KeyframeIndex::unmap() {
+    if (map_) {
+        munmap(map_, map_size_);
+    }
+    map_ = nullptr;
+    map_size_ = 0;
+}
+
+bool KeyframeIndex::LoadSidecar(const std::string &url, int stream_index) {
+    uint64_t size;
+    int64_t mtime;
+    if (!mediaKey(url, size, mtime)) {
+        return false;
+    }
+    std::string path = sidecarPath(url);
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(SidecarHeader)) {
+        ::close(fd);
+        return false;
+    }
+    size_t map_size = st.st_size;
+    void *map = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    auto *header = static_cast<const SidecarHeader *>(map);
+    std::span<const Entry> entries;
+    bool valid = std::memcmp(header->magic, kSidecarMagic,
+                             sizeof(kSidecarMagic)) == 0 &&
+                 header->version == kSidecarVersion &&
+                 header->streamIndex == stream_index &&
+                 header->mediaSize == size && header->mediaMtime == mtime &&
+                 header->timeBaseDen > 0 && header->count > 0 &&
+                 header->count == (map_size - sizeof(SidecarHeader)) /
+                 sizeof(Entry);
+    if (valid) {
+        entries = {reinterpret_cast<const Entry *>(header + 1),
+                   header->count};
+        valid = checksum(entries) == header->checksum &&
+                std::is_sorted(entries.begin(), entries.end(), byPts);
+    }
+    if (!valid) {
+        // 媒体文件改过或者 sidecar 损坏，交给扫描重建
+        spdlog::info("keyframe sidecar {} is stale", path);
+        munmap(map, map_size);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    unmap();
+    entries_.clear();
+    map_ = map;
+    map_size_ = map_size;
+    view_ = entries;
+    time_base_ = {header->timeBaseNum, header->timeBaseDen};
+    duration_ = header->duration;
+    // 偏移来自扫描，一样可以按字节 seek
+    from_scan_ = true;
+    spdlog::info("keyframe sidecar loaded: {} keyframes", entries.size());
+    return true;
+}
+
+bool KeyframeIndex::SaveSidecar(const std::string &url,
+                                int stream_index) const {
+    uint64_t size;
+    int64_t mtime;
+    if (!mediaKey(url, size, mtime)) {
+        return false;
+    }
+    std::vector<Entry> entries;
+    SidecarHeader header{};
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        entries.assign(view_.begin(), view_.end());
+        header.timeBaseNum = time_base_.num;
+        header.timeBaseDen = time_base_.den;
+        header.duration = duration_;
+    }
+    if (entries.empty()) {
+        return false;
+    }
+    std::memcpy(header.magic, kSidecarMagic, sizeof(kSidecarMagic));
+    header.version = kSidecarVersion;
+    header.streamIndex = stream_index;
+    header.mediaSize = size;
+    header.mediaMtime = mtime;
+    header.count = entries.size();
+    header.checksum = checksum(entries);
+
+    // 先写临时文件再 rename，读到的要么是旧文件要么是完整的新文件
+    std::string path = sidecarPath(url);
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    size_t bytes = entries.size() * sizeof(Entry);
+    bool ok = ::write(fd, &header, sizeof(header)) ==
+              static_cast<ssize_t>(sizeof(header)) &&
+              ::write(fd, entries.data(), bytes) ==
+              static_cast<ssize_t>(bytes);
+    ::close(fd);
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    spdlog::info("keyframe sidecar saved: {}", path);
+    return true;
+}
+
+bool KeyframeIndex::BuildFromStream(AVStream *stream) {
+    std::vector<Entry> entries;
+    int count = avformat_index_get_entries_count(stream);
+    for (int i = 0; i < count; ++i) {
+        const AVIndexEntry *entry = avformat_index_get_entry(stream, i);
+        if (entry->flags & AVINDEX_KEYFRAME) {
+            entries.push_back({entry->timestamp, entry->pos});
+        }
+    }
+    if (entries.empty()) {
+        return false;
+    }
+    std::sort(entries.begin(), entries.end(), byPts);
+    // 通用索引是边读边建的，打开时只有开头几项，覆盖不到结尾就不可信
+    if (stream->duration != AV_NOPTS_VALUE &&
+        entries.back().pts < stream->duration * 9 / 10) {
+        spdlog::info("stream index incomplete: {} entries", entries.size());
+        return false;
+    }
+    publish(std::move(entries), stream->time_base,
+            stream->duration != AV_NOPTS_VALUE ? stream->duration : -1,
+            false);
+    return true;
+}
+
+bool KeyframeIndex::BuildByScan(const std::string &url, int stream_index,
+                                std::stop_token token) {
+    AVFormatContext *ctx = avformat_alloc_context();
+    ctx->interrupt_callback = {scanInterrupted, &token};
+    if (avformat_open_input(&ctx, url.c_str(), nullptr, nullptr) != 0) {
+        spdlog::error("keyframe scan: open {} failed", url);
+        return false;
+    }
+    if (avformat_find_stream_info(ctx, nullptr) < 0 ||
+        stream_index < 0 ||
+        stream_index >= static_cast<int>(ctx->nb_streams)) {
+        avformat_close_input(&ctx);
+        return false;
+    }
+    // 其它流的包直接丢弃，demuxer 不用拷贝数据
+    for (unsigned i = 0; i < ctx->nb_streams; ++i) {
+        if (static_cast<int>(i) != stream_index) {
+            ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    std::vector<Entry> entries;
+    int64_t end = -1;
+    AVPacket *packet = av_packet_alloc();
+    while (!token.stop_requested() && av_read_frame(ctx, packet) >= 0) {
+        if (packet->stream_index == stream_index &&
+            packet->pts != AV_NOPTS_VALUE) {
+            end = std::max(end, packet->pts + packet->duration);
+        }
+        if (packet->stream_index == stream_index &&
+            (packet->flags & AV_PKT_FLAG_KEY)) {
+            int64_t ts = packet->pts != AV_NOPTS_VALUE
+                             ? packet->pts
+                             : packet->dts;
+            if (ts != AV_NOPTS_VALUE) {
+                entries.push_back({ts, packet->pos});
+            }
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    AVRational time_base = ctx->streams[stream_index]->time_base;
+    int64_t start = ctx->streams[stream_index]->start_time;
+    avformat_close_input(&ctx);
+    if (end >= 0 && start != AV_NOPTS_VALUE) {
+        end -= start;
+    }
+
+    if (token.stop_requested() || entries.empty()) {
+        return false;
+    }
+    std::sort(entries.begin(), entries.end(), byPts);
+    spdlog::info("keyframe scan done: {} keyframes", entries.size());
+    publish(std::move(entries), time_base, end, true);
+    return true;
+}
+
+void KeyframeIndex::StartBackgroundScan(const std::string &url,
+                                        int stream_index) {
+    scan_task_ = std::jthread([this, url, stream_index](std::stop_token token) {
+        if (BuildByScan(url, stream_index, token)) {
+            SaveSidecar(url, stream_index);
+        }
+    });
+}
+
+void KeyframeIndex::publish(std::vector<Entry> entries, AVRational time_base,
+                            int64_t duration, bool from_scan) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    unmap();
+    entries_ = std::move(entries);
+    view_ = entries_;
+    time_base_ = time_base;
+    duration_ = duration;
+    from_scan_ = from_scan;
+}
+
+std::optional<KeyframeIndex::Entry> KeyframeIndex::Find(int64_t pts) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = std::upper_bound(view_.begin(), view_.end(),
+                               Entry{pts, -1}, byPts);
+    if (it == view_.begin()) {
+        return std::nullopt;
+    }
+    return *std::prev(it);
+}
+
+bool KeyframeIndex::fromScan() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return from_scan_;
+}
+
+bool KeyframeIndex::ready() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return !view_.empty();
+}
+
+size_t KeyframeIndex::size() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return view_.size();
+}
+
+AVRational KeyframeIndex::timeBase() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return time_base_;
+}
+
+std::optional<int64_t> KeyframeIndex::durationMs() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (duration_ < 0) {
+        return std::nullopt;
+    }
+    return av_rescale_q(duration_, time_base_, {1, 1000});
+}
+
+std::vector<KeyframeIndex::Entry> KeyframeIndex::entries() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return {view_.begin(), view_.end()};
+}
+
+bool seekToKeyframe(AVFormatContext *format_context, int video_stream,
+                    KeyframeIndex const &index, int64_t target_ms) {
+    if (video_stream < 0 || !index.ready()) {
+        return false;
+    }
+    AVStream *stream = format_context->streams[video_stream];
+    int64_t target = av_rescale_q(target_ms, {1, 1000}, stream->time_base);
+    auto keyframe = index.Find(target);
+    if (!keyframe) {
+        // 目标在第一个关键帧之前，跳到第一个关键帧
+        auto entries = index.entries();
+        if (entries.empty()) {
+            return false;
+        }
+        keyframe = entries.front();
+    }
+    int ret;
+    // 扫描出来的偏移可以直接按字节跳，省掉 demuxer 的线性查找
+    if (index.fromScan() && keyframe->pos >= 0 &&
+        !(format_context->iformat->flags & AVFMT_NO_BYTE_SEEK)) {
+        ret = av_seek_frame(format_context, video_stream, keyframe->pos,
+                            AVSEEK_FLAG_BYTE);
+    } else {
+        ret = av_seek_frame(format_context, video_stream, keyframe->pts,
+                            AVSEEK_FLAG_BACKWARD);
+    }
+    if (ret < 0) {
+        spdlog::warn("keyframe seek to {} failed", keyframe->pts);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavutil/rational.h>
+}
+
+struct AVStream;
+struct AVFormatContext;
+
+// 视频流关键帧索引，按 pts 排序，seek 时二分查找 O(log n)
+class KeyframeIndex {
+public:
+    struct Entry {
+        int64_t pts; // 视频流 time_base
+        int64_t pos; // 文件字节偏移，未知为 -1
+    };
+
+    ~KeyframeIndex() {
+        Reset();
+    }
+
+    void Reset();
+
+    // 扫描结果持久化到 <url>.kfidx，按文件大小和修改时间校验，
+    // 下次打开直接 mmap，不用重新扫描
+    bool LoadSidecar(const std::string &url, int stream_index);
+    bool SaveSidecar(const std::string &url, int stream_index) const;
+
+    // 直接用容器自带的索引（mp4/mkv 等）
+    bool BuildFromStream(AVStream *stream);
+
+    // 另开一个 demuxer 扫描全部视频关键帧（TS 等没有索引的容器），会阻塞
+    bool BuildByScan(const std::string &url, int stream_index,
+                     std::stop_token token = {});
+
+    // 后台线程扫描，扫描完成前 Find 返回空，完成后写 sidecar
+    void StartBackgroundScan(const std::string &url, int stream_index);
+
+    // 不晚于 pts 的最近关键帧
+    std::optional<Entry> Find(int64_t pts) const;
+
+    // 扫描得到的索引带有可靠的字节偏移，可以按字节 seek
+    bool fromScan() const;
+    bool ready() const;
+    size_t size() const;
+    AVRational timeBase() const;
+    // 扫描或 sidecar 得到的视频流时长，毫秒
+    std::optional<int64_t> durationMs() const;
+
+    std::vector<Entry> entries() const;
+
+private:
+    void publish(std::vector<Entry> entries, AVRational time_base,
+                 int64_t duration, bool from_scan);
+    void unmap();
+
+    mutable std::mutex mtx_;
+    std::vector<Entry> entries_;
+    // 指向 entries_ 或 sidecar 的 mmap
+    std::span<const Entry> view_;
+    void *map_{};
+    size_t map_size_{};
+    AVRational time_base_{1, 1000};
+    int64_t duration_{-1}; // 视频流 time_base，未知为 -1
+    bool from_scan_{};
+    std::jthread scan_task_;
+};
+
+// 用索引把 demuxer 定位到 target_ms 之前最近的视频关键帧，
+// 索引不可用时返回 false
+bool seekToKeyframe(AVFormatContext *format_context, int video_stream,
+                    KeyframeIndex const &index, int64_t target_ms);
@@ -0,0 +1,171 @@
+#include "LiveLatency.h"
+#include <algorithm>
+#include <chrono>
+#include <spdlog/spdlog.h>
+
+namespace {
+// pts 前后跳这么多认为流断开重连过，估计重新开始
+constexpr int64_t kDiscontinuityMs = 5000;
+}
+
+LiveLatency::LiveLatency() : LiveLatency(Options{}) {}
+
+LiveLatency::LiveLatency(Options options)
+    : options_(options), jitter_(options.jitter) {
+    Reset();
+}
+
+void LiveLatency::Reset() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    resetEstimates();
+    stats_ = {};
+    stats_.targetMs = options_.targetMs;
+    stats_.speed = 1.0;
+}
+
+void LiveLatency::Rebase() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    resetEstimates();
+    stats_.speed = 1.0;
+}
+
+void LiveLatency::resetEstimates() {
+    jitter_.Reset();
+    newest_pts_ms_ = INT64_MIN;
+    sender_offset_us_ = INT64_MIN;
+    window_.clear();
+    window_start_us_ = -1;
+    last_frame_us_ = -1;
+    catching_up_ = false;
+    settling_ = false;
+}
+
+void LiveLatency::SetTarget(int64_t target_ms) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    options_.targetMs = target_ms;
+    stats_.targetMs = target_ms;
+}
+
+void LiveLatency::OnPacket(int64_t pts_ms, int64_t dts_ms, int64_t sender_us,
+                           int64_t now_us) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (newest_pts_ms_ != INT64_MIN &&
+        std::abs(pts_ms - newest_pts_ms_) > kDiscontinuityMs) {
+        spdlog::info("live pts jumped {} -> {}, reset latency estimate",
+                     newest_pts_ms_, pts_ms);
+        newest_pts_ms_ = INT64_MIN;
+        jitter_.Reset();
+        resetWindow(now_us);
+    }
+    newest_pts_ms_ = std::max(newest_pts_ms_, pts_ms);
+    if (sender_us >= 0) {
+        sender_offset_us_ = sender_us - pts_ms * 1000;
+    }
+    jitter_.OnArrival(dts_ms, now_us);
+}
+
+double LiveLatency::OnFrame(int64_t pts_ms, int64_t now_us, int64_t late_ms) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    int64_t baseline = jitter_.baselineUs();
+    if (baseline == INT64_MAX) {
+        return 0;
+    }
+    bool measured = sender_offset_us_ != INT64_MIN;
+    // 网络本身的固定延迟，只有知道推流端时间时才量得出来
+    double floor_ms = measured ? (baseline - sender_offset_us_) / 1000.0 : 0;
+    double relative_ms = (now_us - pts_ms * 1000 - baseline) / 1000.0;
+    // 按时显示的帧的相对延迟就是当前的播放延迟
+    double playout_ms = relative_ms - static_cast<double>(
+                            std::max<int64_t>(late_ms, 0));
+    jitter_.SetPlayoutDelay(playout_ms);
+    stats_.latencyMs = relative_ms + floor_ms;
+    stats_.measured = measured;
+    stats_.bufferMs = static_cast<double>(newest_pts_ms_ - pts_ms);
+    stats_.playoutMs = playout_ms;
+    stats_.jitter = jitter_.stats();
+
+    // 端到端目标换算成播放延迟的上限，抖动缓冲的目标不超过它
+    double limit_ms = std::max(options_.targetMs - floor_ms, 0.0);
+    double target_ms = options_.adaptive
+                           ? std::min(jitter_.delayMs(), limit_ms)
+                           : limit_ms;
+
+    if (window_start_us_ < 0) {
+        resetWindow(now_us);
+    }
+    while (!window_.empty() && window_.back().second >= playout_ms) {
+        window_.pop_back();
+    }
+    window_.emplace_back(now_us, playout_ms);
+    while (window_.front().first < now_us - options_.windowMs * 1000) {
+        window_.pop_front();
+    }
+    double dt_ms = last_frame_us_ < 0
+                       ? 0
+                       : std::clamp((now_us - last_frame_us_) / 1000.0,
+                                    0.0, 100.0);
+    last_frame_us_ = now_us;
+
+    // 帧迟到说明缓冲不够：时钟退回去等一下，用一次卡顿换更大的延迟。
+    // 刚跳过的那些帧本来就晚，等到第一帧准时的再算
+    if (late_ms <= options_.toleranceMs) {
+        settling_ = false;
+    } else if (!settling_) {
+        stats_.underruns++;
+        double grow = std::min(static_cast<double>(late_ms),
+                               limit_ms - playout_ms);
+        if (options_.adaptive && grow > 0) {
+            catching_up_ = false;
+            return -grow;
+        }
+    }
+    // 窗口没满时最小值不可靠，不追
+    if (now_us - window_start_us_ < options_.windowMs * 1000) {
+        return 0;
+    }
+    double excess_ms = window_.front().second - target_ms;
+    if (excess_ms > options_.jumpThresholdMs) {
+        stats_.jumps++;
+        stats_.speed = 1.0;
+        catching_up_ = false;
+        settling_ = true;
+        resetWindow(now_us);
+        spdlog::info("live playout delay {:.0f}ms over target {:.0f}ms, jump",
+                     excess_ms + target_ms, target_ms);
+        return excess_ms;
+    }
+    // 窗口最小值超出一点就开始追，用当前值判断追上，避免过冲
+    if (excess_ms > options_.toleranceMs) {
+        catching_up_ = true;
+    } else if (playout_ms <= target_ms) {
+        catching_up_ = false;
+    }
+    bool growing = options_.adaptive && !catching_up_ &&
+                   playout_ms < target_ms - options_.toleranceMs;
+    stats_.speed = catching_up_ ? 1.0 + options_.maxSpeedup
+                   : growing    ? 1.0 - options_.maxSpeedup
+                                : 1.0;
+    return (stats_.speed - 1.0) * dt_ms;
+}
+
+void LiveLatency::OnDropped() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stats_.droppedFrames++;
+}
+
+LiveLatency::Stats LiveLatency::stats() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return stats_;
+}
+
+int64_t LiveLatency::NowUs() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(
+        system_clock::now().time_since_epoch()).count();
+}
+
+void LiveLatency::resetWindow(int64_t now_us) {
+    window_.clear();
+    window_start_us_ = now_us;
+    last_frame_us_ = -1;
+}
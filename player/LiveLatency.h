@@ -0,0 +1,79 @@
+#pragma once
+#include "AdaptiveJitterBuffer.h"
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+// 直播的延迟控制。读线程每收到一个视频包调用 OnPacket，视频线程每显示
+// 一帧调用 OnFrame。播放延迟的目标由抖动缓冲按网络抖动给出，上限是
+// 设置的端到端延迟目标：播放延迟不够、帧迟到时把时钟往回拨或者放慢，
+// 多出来时稍微走快追赶，超过太多时把时钟直接拨回目标，跳过去的帧由
+// 调用方丢掉。时间都是 unix 微秒，方便测试里模拟
+class LiveLatency {
+public:
+    struct Options {
+        int64_t targetMs = 1000;
+        // 超出目标这么多以内只加速，再多就跳
+        int64_t jumpThresholdMs = 2000;
+        int64_t toleranceMs = 50;
+        double maxSpeedup = 0.04;
+        int64_t windowMs = 2000;
+        // 关掉时只限制上限，不按抖动调整
+        bool adaptive = true;
+        AdaptiveJitterBuffer::Options jitter;
+    };
+
+    struct Stats {
+        int64_t targetMs;
+        // 端到端延迟。流里带了推流端时间（PRFT / start_time_realtime）时
+        // 是实测的采集到上屏，否则是相对最快到达的包的估计，不含网络本身
+        double latencyMs;
+        bool measured;
+        double bufferMs;  // 已经收到还没显示的部分
+        double playoutMs; // 当前播放延迟，相对最快到达的包
+        double speed;     // 当前时钟倍速
+        uint64_t jumps;
+        uint64_t droppedFrames;
+        uint64_t underruns; // 迟到显示的帧
+        AdaptiveJitterBuffer::Stats jitter;
+    };
+
+    LiveLatency();
+    explicit LiveLatency(Options options);
+
+    void Reset();
+    // 断线重连后 pts 和到达时间的基准都变了，重新估计，累计统计保留
+    void Rebase();
+    void SetTarget(int64_t target_ms);
+
+    // dts_ms 用来统计到达抖动，没有 dts 时传 pts；
+    // sender_us 为推流端采集这个包的时间，未知时为 -1
+    void OnPacket(int64_t pts_ms, int64_t dts_ms, int64_t sender_us,
+                  int64_t now_us);
+    // late_ms 为显示时比该显示的时刻晚了多少。
+    // 返回时钟需要往前拨的毫秒数，负数表示往回拨
+    double OnFrame(int64_t pts_ms, int64_t now_us, int64_t late_ms);
+    void OnDropped();
+
+    Stats stats() const;
+
+    static int64_t NowUs();
+
+private:
+    void resetWindow(int64_t now_us);
+    void resetEstimates();
+
+    Options options_;
+    mutable std::mutex mtx_;
+    AdaptiveJitterBuffer jitter_;
+    int64_t newest_pts_ms_{INT64_MIN};
+    // 推流端时间减 pts
+    int64_t sender_offset_us_{INT64_MIN};
+    // 单调队列，队首是窗口内最小的播放延迟
+    std::deque<std::pair<int64_t, double>> window_;
+    int64_t window_start_us_{-1};
+    int64_t last_frame_us_{-1};
+    bool catching_up_{};
+    bool settling_{}; // 刚跳过，还没有准时显示的帧
+    Stats stats_{};
+};
@@ -0,0 +1,35 @@
+#include "Log.h"
+#include <spdlog/async.h>
+#include <spdlog/cfg/env.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+namespace {
+// 队列里最多积压的条数
+constexpr size_t kQueueSize = 8192;
+}
+
+void logSuppressed(spdlog::level::level_enum level, const std::string &msg,
+                   uint64_t suppressed) {
+    if (suppressed) {
+        spdlog::log(level, "{} ({} more suppressed)", msg, suppressed);
+    } else {
+        spdlog::log(level, "{}", msg);
+    }
+}
+
+void InitLogging() {
+    spdlog::init_thread_pool(kQueueSize, 1);
+    auto sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+    auto logger = std::make_shared<spdlog::async_logger>(
+        "player", sink, spdlog::thread_pool(),
+        spdlog::async_overflow_policy::overrun_oldest);
+    spdlog::set_default_logger(logger);
+    spdlog::set_level(spdlog::level::warn);
+    spdlog::cfg::load_env_levels();
+    // 出错时尽快写出来，崩溃前的最后几条不会留在队列里
+    spdlog::flush_on(spdlog::level::err);
+}
+
+void ShutdownLogging() {
+    spdlog::shutdown();
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <spdlog/spdlog.h>
+
+// 每个包、每一帧都会走到的日志。默认整行编译掉，参数也不求值，
+// 调试时用 -DPLAYER_LOG_HOT_PATH=ON 编译，再设 SPDLOG_LEVEL=trace
+#ifdef PLAYER_LOG_HOT_PATH
+#define PLAYER_LOG_TRACE(...) spdlog::trace(__VA_ARGS__)
+#else
+#define PLAYER_LOG_TRACE(...) ((void)0)
+#endif
+
+// 循环里反复出现的情况，同一处每 interval_ms 最多打一条，中间压掉的
+// 条数附在下一条后面。级别被过滤掉时不格式化也不计数
+#define PLAYER_LOG_EVERY(level, interval_ms, ...)                             \
+    do {                                                                      \
+        if (spdlog::default_logger_raw()->should_log(level)) {                \
+            static RateLimit player_rate_limit_{                              \
+                std::chrono::milliseconds(interval_ms)};                      \
+            if (uint64_t player_suppressed_;                                  \
+                player_rate_limit_.Allow(player_suppressed_)) {               \
+                logSuppressed(level, fmt::format(__VA_ARGS__),                \
+                              player_suppressed_);                            \
+            }                                                                 \
+        }                                                                     \
+    } while (0)
+
+#define PLAYER_ERROR_EVERY(interval_ms, ...)                                  \
+    PLAYER_LOG_EVERY(spdlog::level::err, interval_ms, __VA_ARGS__)
+
+// 多个线程同时调用也只有一个能通过
+class RateLimit {
+public:
+    explicit RateLimit(std::chrono::milliseconds interval)
+        : interval_ns_(std::chrono::nanoseconds(interval).count()) {}
+
+    // 通过时 suppressed 是上次通过以来被压掉的条数
+    bool Allow(uint64_t &suppressed) {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t next = next_ns_.load(std::memory_order_relaxed);
+        if (now < next || !next_ns_.compare_exchange_strong(
+                              next, now + interval_ns_,
+                              std::memory_order_relaxed)) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    int64_t interval_ns_;
+    std::atomic<int64_t> next_ns_{0};
+    std::atomic<uint64_t> suppressed_{0};
+};
+
+void logSuppressed(spdlog::level::level_enum level, const std::string &msg,
+                   uint64_t suppressed);
+
+// 默认 logger 换成异步的：格式化之后放进队列由后台线程写出，队列满了
+// 丢最旧的，不会阻塞播放线程。级别默认 warn，可以用 SPDLOG_LEVEL 环境
+// 变量改，比如 SPDLOG_LEVEL=info。在 main 开头调用一次
+void InitLogging();
+// 退出前把队列里剩下的写完
+void ShutdownLogging();
@@ -7,12 +7,17 @@
 #include <qcoreapplication.h>
 #include <qevent.h>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QPushButton>
 #include <QHBoxLayout>
 #include <QSlider>
+#include <QProgressBar>
 #include <QStatusBar>
 #include <spdlog/spdlog.h>
 #include <QTimer>
+#include <QLabel>
+#include <QMouseEvent>
+#include "ThumbnailCache.h"
 #include <format>
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
@@ -29,14 +34,56 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
             "Video Files (*.mp4)");
         try {
             mController->Open(filePath.toStdString());
+            mThumbnails->Open(filePath.toStdString());
             // mController->Play();
         } catch (const std::exception &e) {
             spdlog::error("open file error:{}", e.what());
         }
     });
+    auto onPlaylist = file->addAction("add to playlist");
+    connect(onPlaylist, &QAction::triggered, this, [this] {
+        auto files = QFileDialog::getOpenFileNames(this, "Add To Playlist",
+            "",
+            "Video Files (*.mp4)");
+        for (auto const &path : files) {
+            try {
+                if (mController->state() == PlayerState::Idle) {
+                    mController->Open(path.toStdString());
+                    mThumbnails->Open(path.toStdString());
+                } else {
+                    mController->Enqueue(path.toStdString());
+                }
+            } catch (const std::exception &e) {
+                spdlog::error("open file error:{}", e.what());
+            }
+        }
+    });
     auto onUrl = file->addAction("open url");
-    connect(onUrl, &QAction::triggered, [] {
+    connect(onUrl, &QAction::triggered, this, [this] {
         spdlog::info("open url");
+        auto url = QInputDialog::getText(this, "Open Url", "url:");
+        if (url.isEmpty()) {
+            return;
+        }
+        try {
+            mController->Open(url.trimmed().toStdString());
+            // 缩略图要扫整个文件，网络源不生成。上一个文件的也关掉，进度条上
+            // 不能再显示它的画面
+            mThumbnails->Close();
+        } catch (const std::exception &e) {
+            spdlog::error("open url error:{}", e.what());
+        }
+    });
+    auto playback = menuBar()->addMenu("Playback");
+    auto exactSeek = playback->addAction("exact seek");
+    exactSeek->setCheckable(true);
+    connect(exactSeek, &QAction::toggled, this, [this](bool checked) {
+        mController->SetExactSeek(checked);
+    });
+    auto fastStart = playback->addAction("fast start");
+    fastStart->setCheckable(true);
+    connect(fastStart, &QAction::toggled, this, [this](bool checked) {
+        mController->SetFastStart(checked);
     });
     auto widget = new QWidget{};
     setCentralWidget(widget);
@@ -44,6 +91,18 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     mRender = new PlayerWidget{};
     layout->addWidget(mRender);
     mController = new PlayerController{mRender};
+    // 关闭时会换一个 controller，取数据时再读 mController
+    mRender->SetStatsProvider([this] {
+        return StatsOverlay::Sample{mController->Stream(),
+                                    mController->MetricsSnapshot(),
+                                    mController->Stalls()};
+    });
+    auto stats = playback->addAction("stats");
+    stats->setCheckable(true);
+    stats->setShortcut(Qt::Key_I);
+    connect(stats, &QAction::toggled, this, [this](bool checked) {
+        mRender->SetStatsVisible(checked);
+    });
 
     auto buttom = new QHBoxLayout{};
 
@@ -54,23 +113,71 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     mProgressBar = new QSlider{Qt::Horizontal};
     mProgressBar->setRange(0, 1000);
     mProgressBar->setValue(0);
+    mProgressBar->setMouseTracking(true);
+    mProgressBar->installEventFilter(this);
+    mThumbnails = std::make_unique<ThumbnailCache>();
+    mThumbPopup = new QLabel{this, Qt::ToolTip};
+    mThumbPopup->hide();
+    auto stepBack = new QPushButton{"上一帧"};
+    auto stepForward = new QPushButton{"下一帧"};
+    auto reverseBtn = new QPushButton{"倒放"};
+    reverseBtn->setCheckable(true);
     buttom->addWidget(before);
+    buttom->addWidget(stepBack);
     buttom->addWidget(playBtn);
+    buttom->addWidget(stepForward);
     buttom->addWidget(after);
+    buttom->addWidget(reverseBtn);
+    connect(stepBack, &QPushButton::clicked, this, [this] {
+        mController->StepFrame(-1);
+    });
+    connect(stepForward, &QPushButton::clicked, this, [this] {
+        mController->StepFrame(1);
+    });
+    connect(reverseBtn, &QPushButton::toggled, this, [this](bool checked) {
+        mController->SetReverse(checked);
+    });
     buttom->addWidget(mProgressBar);
+
+    auto muteBtn = new QPushButton{"静音"};
+    muteBtn->setCheckable(true);
+    auto volume = new QSlider{Qt::Horizontal};
+    volume->setRange(0, 200);
+    volume->setValue(100);
+    volume->setMaximumWidth(100);
+    auto meters = new QVBoxLayout{};
+    for (auto &bar : mLevelBars) {
+        bar = new QProgressBar{};
+        bar->setRange(0, 100);
+        bar->setTextVisible(false);
+        bar->setMaximumSize(100, 6);
+        meters->addWidget(bar);
+    }
+    buttom->addWidget(muteBtn);
+    buttom->addWidget(volume);
+    buttom->addLayout(meters);
     layout->addLayout(buttom);
+    connect(muteBtn, &QPushButton::toggled, this, [this](bool checked) {
+        mController->SetMute(checked);
+    });
+    connect(volume, &QSlider::valueChanged, this, [this](int value) {
+        mController->SetVolume(value / 100.0f);
+    });
     layout->addWidget(closeBnt);
     connect(closeBnt, &QPushButton::clicked, this, [this] {
         spdlog::info("close");
         delete mController;
         mController = new PlayerController{mRender};
+        mThumbnails->Close();
         mProgressTimer->stop();
         mProgressBar->setValue(0);
     });
     connect(mProgressTimer, &QTimer::timeout, this, [this] {
         if (mController->state() == PlayerState::Playing) {
             auto [curr, total] = mController->CurrentPosition();
-            mProgressBar->setValue(1.0 * curr / total * 1000.0);
+            if (total > 0) {
+                mProgressBar->setValue(1.0 * curr / total * 1000.0);
+            }
             mCurrentPos = curr;
             mTotalPos = total;
             int curr_min = curr / 1000 / 60;
@@ -79,14 +186,42 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
             int total_min = total / 1000 / 60;
             int total_sec = (total / 1000) % 60;
 
-            QString msg = QString::fromStdString(fmt::format(
-                "{:02}:{:02} / {:02}:{:02}",
+            auto sync = mController->SyncStats();
+            auto seek = mController->SeekLatencyStats();
+            auto startup = mController->StartupStats();
+            std::string text = fmt::format(
+                "{:02}:{:02} / {:02}:{:02}  drift: {:.1f}ms ({:+.2f}%)  "
+                "seek: keyframe {:.0f}ms exact {:.0f}ms  ttff: {:.0f}ms "
+                "click: {:.0f}ms",
                 curr_min, curr_sec,
-                total_min, total_sec));
+                total_min, total_sec,
+                sync.driftMs, sync.correctionPercent,
+                seek.keyframe.lastMs, seek.exact.lastMs, startup.totalMs,
+                startup.clickToFrameMs);
+            if (mController->IsLive()) {
+                // 没有推流端时间时是估计值，加 ~
+                auto live = mController->LiveStats();
+                text += fmt::format(
+                    "  live: {}{:.0f}ms / {}ms x{:.2f} dropped {}  "
+                    "jitter: delay {:.0f}ms jitter {:.1f}ms late {}",
+                    live.measured ? "" : "~", live.latencyMs, live.targetMs,
+                    live.speed, live.droppedFrames, live.playoutMs,
+                    live.jitter.jitterMs, live.jitter.late);
+                auto reconnect = mController->Reconnects();
+                if (reconnect.reconnecting) {
+                    text += "  reconnecting...";
+                } else if (reconnect.reconnects > 0) {
+                    text += fmt::format("  reconnects: {} down {:.0f}ms",
+                                        reconnect.reconnects,
+                                        reconnect.downtimeMs);
+                }
+            }
+            QString msg = QString::fromStdString(text);
 
             if (auto statusBar = this->statusBar()) {
                 statusBar->showMessage(msg);
             }
+            UpdateLevelMeters();
         }
     });
     connect(playBtn, &QPushButton::clicked, this, [this] {
@@ -99,23 +234,11 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
 
     connect(before, &QPushButton::clicked, this, [this,seekOffset] {
         spdlog::info("before");
-        // mController->Before();
-        // before 1 second
-        if (mCurrentPos - seekOffset < 0) {
-            mController->SeekTo(0);
-        } else {
-            mController->SeekTo(mCurrentPos - seekOffset);
-        }
+        mController->SeekBy(-seekOffset);
     });
     connect(after, &QPushButton::clicked, this, [this,seekOffset] {
-        spdlog::info("after curr:{},next:{}", mCurrentPos, mCurrentPos + 1000);
-        // mController->After();
-        // after 1 second
-        if (mCurrentPos + seekOffset > mTotalPos) {
-            mController->SeekTo(mTotalPos);
-        } else {
-            mController->SeekTo(mCurrentPos + seekOffset);
-        }
+        spdlog::info("after curr:{}", mCurrentPos);
+        mController->SeekBy(seekOffset);
     });
     connect(mProgressBar, &QSlider::valueChanged, this,
             &MainWindow::OnSliderValueChanged);
@@ -123,14 +246,28 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
             &MainWindow::OnSliderPressed);
     connect(mProgressBar, &QSlider::sliderReleased, this,
             &MainWindow::OnSliderValueReleased);
-    connect(mController, &PlayerController::StateChanged, this, [this,playBtn] {
+    connect(mController, &PlayerController::MediaChanged, this,
+            [this](const QString &url) {
+                setWindowTitle(url);
+                // 列表里也可能有网络源，缩略图只给本地文件生成
+                if (url.contains("://")) {
+                    mThumbnails->Close();
+                } else {
+                    mThumbnails->Open(url.toStdString());
+                }
+            });
+    connect(mController, &PlayerController::StateChanged, this,
+            [this,playBtn,reverseBtn] {
         spdlog::info("OnStateChanged");
         if (mController->state() == PlayerState::Playing) {
             playBtn->setText("暂停");
+            reverseBtn->setChecked(false);
             if (!mProgressTimer->isActive()) {
                 mProgressTimer->start();
                 auto [curr, total] = mController->CurrentPosition();
-                mProgressBar->setValue(1.0 * curr / total * 1000.0);
+                if (total > 0) {
+                    mProgressBar->setValue(1.0 * curr / total * 1000.0);
+                }
                 mCurrentPos = curr;
                 mTotalPos = total;
                 int curr_min = curr / 1000 / 60;
@@ -173,13 +310,58 @@ MainWindow::~MainWindow() {
     }
 }
 
+void MainWindow::UpdateLevelMeters() {
+    auto levels = mController->AudioLevels();
+    for (int ch = 0; ch < static_cast<int>(mLevelBars.size()); ++ch) {
+        float peak = ch < levels.channels ? levels.peak[ch] : 0.0f;
+        mLevelBars[ch]->setValue(static_cast<int>(peak * 100));
+    }
+}
+
+bool MainWindow::eventFilter(QObject *watched, QEvent *event) {
+    if (watched == mProgressBar) {
+        if (event->type() == QEvent::MouseMove) {
+            ShowThumbnail(static_cast<QMouseEvent *>(event)->pos().x());
+        } else if (event->type() == QEvent::Leave) {
+            mThumbPopup->hide();
+        }
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void MainWindow::ShowThumbnail(int x) {
+    int64_t total = mController->CurrentPosition().second;
+    if (total <= 0 || mProgressBar->width() <= 0) {
+        return;
+    }
+    int64_t pos = total * x / mProgressBar->width();
+    auto thumb = mThumbnails->Lookup(pos);
+    if (!thumb) {
+        mThumbPopup->hide();
+        return;
+    }
+    // sheet 在 mmap 里，拷一份再交给 QLabel
+    QImage image{thumb->pixels, thumb->width, thumb->height, thumb->stride,
+                 QImage::Format_ARGB32};
+    mThumbPopup->setPixmap(QPixmap::fromImage(image.copy()));
+    mThumbPopup->adjustSize();
+    QPoint at = mProgressBar->mapToGlobal(
+        QPoint{x - thumb->width / 2, -thumb->height - 8});
+    mThumbPopup->move(at);
+    mThumbPopup->show();
+}
+
 void MainWindow::OnSliderValueChanged(int value) {
+    if (mProgressBar->isSliderDown()) {
+        mController->ScrubTo(value * 1.0 / 1000 * mTotalPos);
+    }
     // spdlog::info("OnSliderValueChanged: {}", value);
     // spdlog::warn("OnSliderValueChanged: {}", value);
 }
 
 void MainWindow::OnSliderPressed() {
     mProgressTimer->stop();
+    mController->BeginScrub();
     // if (mController->state() == PlayerState::Playing) {
     //     mController->Play();
     // }
@@ -188,7 +370,7 @@ void MainWindow::OnSliderPressed() {
 
 void MainWindow::OnSliderValueReleased() {
     int value = mProgressBar->value();
-    mController->SeekTo(value * 1.0 / 1000 * mTotalPos);
+    mController->EndScrub(value * 1.0 / 1000 * mTotalPos);
     spdlog::warn("OnSliderValueReleased");
     mProgressTimer->start();
     // if (mController->state() == PlayerState::Paused) {
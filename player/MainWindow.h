@@ -1,9 +1,14 @@
 #pragma once
 
 #include <QMainWindow>
+#include <array>
+#include <memory>
 class RendererBridge;
 class PlayerController;
 class PlayerWidget;
+class QProgressBar;
+class QLabel;
+class ThumbnailCache;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -17,11 +22,22 @@ public Q_SLOTS:
     void OnSliderPressed();
     void OnSliderValueReleased();
 
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private:
+    void UpdateLevelMeters();
+    void ShowThumbnail(int x);
+
     PlayerWidget *mRender{};
     PlayerController *mController{};
     QTimer *mProgressTimer{};
     int64_t mCurrentPos;
     int64_t mTotalPos;
     struct QSlider* mProgressBar;
+    // 左右声道峰值电平
+    std::array<QProgressBar *, 2> mLevelBars{};
+    // 进度条悬停预览
+    std::unique_ptr<ThumbnailCache> mThumbnails;
+    QLabel *mThumbPopup{};
 };
@@ -0,0 +1,268 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <spdlog/spdlog.h>
+
+namespace {
+void updateMin(std::atomic<uint64_t> &target, uint64_t value) {
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value < current &&
+           !target.compare_exchange_weak(current, value,
+                                         std::memory_order_relaxed)) {}
+}
+
+void updateMax(std::atomic<uint64_t> &target, uint64_t value) {
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value > current &&
+           !target.compare_exchange_weak(current, value,
+                                         std::memory_order_relaxed)) {}
+}
+
+int64_t unixMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+}
+
+int Metrics::Histogram::bucketOf(uint64_t us) {
+    if (us < kSubBuckets) {
+        return static_cast<int>(us);
+    }
+    int exponent = std::bit_width(us) - 1;
+    if (exponent > kMaxExponent) {
+        return kBuckets - 1;
+    }
+    int sub = static_cast<int>(us >> (exponent - kSubBits)) &
+              (kSubBuckets - 1);
+    return kSubBuckets * (exponent - kSubBits + 1) + sub;
+}
+
+double Metrics::Histogram::valueOf(int bucket) {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    int exponent = bucket / kSubBuckets + kSubBits - 1;
+    int sub = bucket % kSubBuckets;
+    double width = std::ldexp(1.0, exponent - kSubBits);
+    return (kSubBuckets + sub) * width + width / 2;
+}
+
+void Metrics::Histogram::Record(double ms) {
+    uint64_t us = ms > 0 ? static_cast<uint64_t>(ms * 1000) : 0;
+    buckets_[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_us_.fetch_add(us, std::memory_order_relaxed);
+    updateMin(min_us_, us);
+    updateMax(max_us_, us);
+}
+
+Metrics::HistogramSnapshot Metrics::Histogram::snapshot() const {
+    HistogramSnapshot snapshot{};
+    // 各字段分别读，和并发的 Record 之间可能差几个样本
+    uint64_t total = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        if (uint64_t n = buckets_[i].load(std::memory_order_relaxed)) {
+            snapshot.buckets.emplace_back(i, n);
+            total += n;
+        }
+    }
+    if (total == 0) {
+        return snapshot;
+    }
+    double min_us = min_us_.load(std::memory_order_relaxed);
+    double max_us = max_us_.load(std::memory_order_relaxed);
+    snapshot.count = total;
+    snapshot.minMs = min_us / 1000;
+    snapshot.maxMs = max_us / 1000;
+    snapshot.meanMs = sum_us_.load(std::memory_order_relaxed) / 1000.0 /
+                      std::max<uint64_t>(count_, 1);
+    fillQuantiles(snapshot, min_us, max_us);
+    return snapshot;
+}
+
+void Metrics::Histogram::fillQuantiles(HistogramSnapshot &snapshot,
+                                       double min_us, double max_us) {
+    uint64_t total = 0;
+    for (auto [bucket, n] : snapshot.buckets) {
+        total += n;
+    }
+    auto quantile = [&](double q) {
+        uint64_t rank = std::max<uint64_t>(
+            1, static_cast<uint64_t>(std::ceil(q * total)));
+        uint64_t seen = 0;
+        for (auto [bucket, n] : snapshot.buckets) {
+            seen += n;
+            if (seen >= rank) {
+                return std::clamp(valueOf(bucket), min_us, max_us) / 1000;
+            }
+        }
+        return max_us / 1000;
+    };
+    snapshot.p50Ms = quantile(0.5);
+    snapshot.p90Ms = quantile(0.9);
+    snapshot.p99Ms = quantile(0.99);
+}
+
+Metrics::HistogramSnapshot Metrics::HistogramSnapshot::Since(
+    HistogramSnapshot const &before) const {
+    HistogramSnapshot delta{};
+    // 两边都按下标升序，归并着相减
+    auto old = before.buckets.begin();
+    for (auto [bucket, n] : buckets) {
+        while (old != before.buckets.end() && old->first < bucket) {
+            ++old;
+        }
+        uint64_t prev = old != before.buckets.end() && old->first == bucket
+                            ? old->second
+                            : 0;
+        if (n > prev) {
+            delta.buckets.emplace_back(bucket, n - prev);
+            delta.count += n - prev;
+        }
+    }
+    if (delta.buckets.empty() || count <= before.count) {
+        return {};
+    }
+    // 新增样本的最小最大值只知道落在哪个桶，不超出整体的范围
+    double min_us = std::clamp(
+        Histogram::valueOf(delta.buckets.front().first), minMs * 1000,
+        maxMs * 1000);
+    double max_us = std::clamp(
+        Histogram::valueOf(delta.buckets.back().first), minMs * 1000,
+        maxMs * 1000);
+    delta.minMs = min_us / 1000;
+    delta.maxMs = max_us / 1000;
+    delta.meanMs = (meanMs * count - before.meanMs * before.count) /
+                   static_cast<double>(count - before.count);
+    Histogram::fillQuantiles(delta, min_us, max_us);
+    return delta;
+}
+
+void Metrics::Histogram::reset() {
+    for (auto &bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_ = 0;
+    sum_us_ = 0;
+    min_us_ = UINT64_MAX;
+    max_us_ = 0;
+}
+
+std::string Metrics::Snapshot::ToJson() const {
+    std::string json = fmt::format("{{\"time\":{},\"counters\":{{", timeMs);
+    const char *sep = "";
+    for (auto const &[name, value] : counters) {
+        json += fmt::format("{}\"{}\":{}", sep, name, value);
+        sep = ",";
+    }
+    json += "},\"gauges\":{";
+    sep = "";
+    for (auto const &[name, value] : gauges) {
+        json += fmt::format("{}\"{}\":{:.3f}", sep, name, value);
+        sep = ",";
+    }
+    json += "},\"histograms\":{";
+    sep = "";
+    for (auto const &[name, h] : histograms) {
+        json += fmt::format(
+            "{}\"{}\":{{\"count\":{},\"min\":{:.3f},\"max\":{:.3f},"
+            "\"mean\":{:.3f},\"p50\":{:.3f},\"p90\":{:.3f},\"p99\":{:.3f}}}",
+            sep, name, h.count, h.minMs, h.maxMs, h.meanMs, h.p50Ms, h.p90Ms,
+            h.p99Ms);
+        sep = ",";
+    }
+    json += "}}";
+    return json;
+}
+
+Metrics &Metrics::Get() {
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::~Metrics() {
+    StopDump();
+}
+
+Metrics::Counter &Metrics::counter(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto &slot = counters_[name];
+    if (!slot) {
+        slot = std::make_unique<Counter>();
+    }
+    return *slot;
+}
+
+Metrics::Gauge &Metrics::gauge(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto &slot = gauges_[name];
+    if (!slot) {
+        slot = std::make_unique<Gauge>();
+    }
+    return *slot;
+}
+
+Metrics::Histogram &Metrics::histogram(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto &slot = histograms_[name];
+    if (!slot) {
+        slot = std::make_unique<Histogram>();
+    }
+    return *slot;
+}
+
+Metrics::Snapshot Metrics::snapshot() const {
+    Snapshot snapshot;
+    snapshot.timeMs = unixMs();
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto const &[name, counter] : counters_) {
+        snapshot.counters[name] = counter->value();
+    }
+    for (auto const &[name, gauge] : gauges_) {
+        snapshot.gauges[name] = gauge->value();
+    }
+    for (auto const &[name, histogram] : histograms_) {
+        snapshot.histograms[name] = histogram->snapshot();
+    }
+    return snapshot;
+}
+
+void Metrics::Reset() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto &[name, counter] : counters_) {
+        counter->value_ = 0;
+    }
+    for (auto &[name, gauge] : gauges_) {
+        gauge->value_ = 0;
+    }
+    for (auto &[name, histogram] : histograms_) {
+        histogram->reset();
+    }
+}
+
+void Metrics::StartDump(const std::string &path,
+                        std::chrono::milliseconds interval) {
+    StopDump();
+    spdlog::info("dump metrics to {} every {}ms", path, interval.count());
+    dump_ = std::jthread([this, path, interval](std::stop_token token) {
+        auto next = std::chrono::steady_clock::now() + interval;
+        while (!token.stop_requested()) {
+            if (std::chrono::steady_clock::now() < next) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                continue;
+            }
+            next += interval;
+            std::string line = snapshot().ToJson() + "\n";
+            if (FILE *file = fopen(path.c_str(), "a")) {
+                fwrite(line.data(), 1, line.size(), file);
+                fclose(file);
+            }
+        }
+    });
+}
+
+void Metrics::StopDump() {
+    dump_ = {};
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// 播放管线的指标：计数器、瞬时值和耗时直方图，记录时只有原子操作。
+// 名字第一次用到时注册，拿到的引用一直有效，热路径上用函数内的
+// static 引用缓存，不再查表。PLAYER_METRICS=<path> 时按
+// PLAYER_METRICS_MS（默认 1000）的间隔把快照按行追加成 JSON
+class Metrics {
+public:
+    class Counter {
+    public:
+        void Add(uint64_t n = 1) {
+            value_.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        uint64_t value() const {
+            return value_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        friend class Metrics;
+        std::atomic<uint64_t> value_{0};
+    };
+
+    class Gauge {
+    public:
+        void Set(double value) {
+            value_.store(value, std::memory_order_relaxed);
+        }
+
+        void Add(double delta) {
+            value_.fetch_add(delta, std::memory_order_relaxed);
+        }
+
+        double value() const {
+            return value_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        friend class Metrics;
+        std::atomic<double> value_{0};
+    };
+
+    struct HistogramSnapshot {
+        uint64_t count;
+        double minMs;
+        double maxMs;
+        double meanMs;
+        double p50Ms;
+        double p90Ms;
+        double p99Ms;
+        // 非空的桶：(下标, 样本数)，下标升序
+        std::vector<std::pair<int, uint64_t>> buckets;
+
+        // 同一个直方图在 before 之后新增样本的分布，比如浮层每次刷新
+        // 之间的分位数。min/max 只能精确到桶
+        HistogramSnapshot Since(HistogramSnapshot const &before) const;
+    };
+
+    // HDR 风格的对数分桶：按微秒记，每个 2 的幂区间再分 16 份，
+    // 相对误差不超过 1/16，范围到 2^40us
+    class Histogram {
+    public:
+        void Record(double ms);
+        HistogramSnapshot snapshot() const;
+
+        static constexpr int kSubBits = 4;
+        static constexpr int kSubBuckets = 1 << kSubBits;
+        static constexpr int kMaxExponent = 40;
+        static constexpr int kBuckets =
+            kSubBuckets * (kMaxExponent - kSubBits + 2);
+
+    private:
+        friend class Metrics;
+        friend struct HistogramSnapshot;
+        static int bucketOf(uint64_t us);
+        // 桶的中点
+        static double valueOf(int bucket);
+        // 按 snapshot.buckets 填 p50/p90/p99，结果限制在 [min_us, max_us]
+        static void fillQuantiles(HistogramSnapshot &snapshot, double min_us,
+                                  double max_us);
+        void reset();
+
+        std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> sum_us_{0};
+        std::atomic<uint64_t> min_us_{UINT64_MAX};
+        std::atomic<uint64_t> max_us_{0};
+    };
+
+    struct Snapshot {
+        int64_t timeMs; // unix 时间
+        std::map<std::string, uint64_t> counters;
+        std::map<std::string, double> gauges;
+        std::map<std::string, HistogramSnapshot> histograms;
+
+        std::string ToJson() const;
+    };
+
+    static Metrics &Get();
+
+    Counter &counter(const std::string &name);
+    Gauge &gauge(const std::string &name);
+    Histogram &histogram(const std::string &name);
+
+    Snapshot snapshot() const;
+    // 全部清零，已经拿到的引用仍然有效
+    void Reset();
+
+    // 定期把快照追加到 path，一行一个 JSON
+    void StartDump(const std::string &path,
+                   std::chrono::milliseconds interval);
+    void StopDump();
+
+    ~Metrics();
+
+private:
+    Metrics() = default;
+
+    mutable std::mutex mtx_;
+    std::map<std::string, std::unique_ptr<Counter>> counters_;
+    std::map<std::string, std::unique_ptr<Gauge>> gauges_;
+    std::map<std::string, std::unique_ptr<Histogram>> histograms_;
+    std::jthread dump_;
+};
+
+// 作用域结束时把经过的毫秒数记进直方图
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Metrics::Histogram &histogram)
+        : histogram_(histogram), begin_(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+        histogram_.Record(std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - begin_).count());
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    Metrics::Histogram &histogram_;
+    std::chrono::steady_clock::time_point begin_;
+};
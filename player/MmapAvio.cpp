@@ -0,0 +1,104 @@
+#include "MmapAvio.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+MmapAvio::~MmapAvio() {
+    if (data_) {
+        munmap(const_cast<uint8_t *>(data_), size_);
+    }
+}
+
+std::unique_ptr<MmapAvio> MmapAvio::Open(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    std::unique_ptr<MmapAvio> source(new MmapAvio);
+    source->data_ = static_cast<const uint8_t *>(data);
+    source->size_ = st.st_size;
+    if (!source->initAvio(kBufferSize)) {
+        return nullptr;
+    }
+    source->advise(0);
+    return source;
+}
+
+MmapAvio::Stats MmapAvio::stats() const {
+    return {reads_, seeks_, advises_, bytes_};
+}
+
+int MmapAvio::read(uint8_t *buf, int size) {
+    if (pos_ >= size_) {
+        return AVERROR_EOF;
+    }
+    // 读到预读窗口后半段时把下一段提前交给内核
+    if (advised_end_ < size_ && pos_ + kReadAhead / 2 > advised_end_) {
+        advise(pos_);
+    }
+    size_t n = std::min<size_t>(size, size_ - pos_);
+    std::memcpy(buf, data_ + pos_, n);
+    pos_ += n;
+    reads_.fetch_add(1, std::memory_order_relaxed);
+    bytes_.fetch_add(n, std::memory_order_relaxed);
+    return static_cast<int>(n);
+}
+
+int64_t MmapAvio::seek(int64_t offset, int whence) {
+    if (whence == AVSEEK_SIZE) {
+        return size_;
+    }
+    int64_t pos;
+    switch (whence) {
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = pos_ + offset;
+        break;
+    case SEEK_END:
+        pos = size_ + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0 || pos > static_cast<int64_t>(size_)) {
+        return AVERROR(EINVAL);
+    }
+    pos_ = pos;
+    // 跳到新位置后下次 read 重新提示预读
+    advised_end_ = pos;
+    seeks_.fetch_add(1, std::memory_order_relaxed);
+    return pos;
+}
+
+void MmapAvio::advise(size_t pos) {
+    static const size_t page = sysconf(_SC_PAGESIZE);
+    size_t start = pos & ~(page - 1);
+    if (start >= size_) {
+        return;
+    }
+    size_t len = std::min(kReadAhead, size_ - start);
+    madvise(const_cast<uint8_t *>(data_) + start, len, MADV_WILLNEED);
+    advised_end_ = start + len;
+    advises_.fetch_add(1, std::memory_order_relaxed);
+}
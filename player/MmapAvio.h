@@ -0,0 +1,54 @@
+#pragma once
+#include "AvioSource.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// 本地文件的 AVIO：整个文件 mmap 进来，read 直接从映射拷到 AVIO 的
+// 缓冲，不再走 file 协议的 read() 系统调用；seek 只改偏移。读位置前方
+// 用 madvise(WILLNEED) 提示内核预读，整体标 MADV_SEQUENTIAL
+class MmapAvio : public AvioSource {
+public:
+    struct Stats {
+        uint64_t reads;
+        uint64_t seeks;
+        uint64_t advises; // madvise 调用次数，也是唯一的系统调用
+        uint64_t bytes;
+    };
+
+    ~MmapAvio() override;
+
+    // 不是普通文件或者映射失败时返回空，调用方退回默认协议
+    static std::unique_ptr<MmapAvio> Open(const std::string &path);
+
+    size_t size() const {
+        return size_;
+    }
+
+    Stats stats() const;
+
+    static constexpr int kBufferSize = 64 * 1024;
+    static constexpr size_t kReadAhead = 4 * 1024 * 1024;
+
+protected:
+    int read(uint8_t *buf, int size) override;
+    int64_t seek(int64_t offset, int whence) override;
+
+private:
+    MmapAvio() = default;
+
+    void advise(size_t pos);
+
+    const uint8_t *data_{};
+    size_t size_{};
+    size_t pos_{};
+    size_t advised_end_{}; // 已经 WILLNEED 过的区间末尾
+
+    // 只在 demux 线程更新，统计读取可以在别的线程
+    std::atomic<uint64_t> reads_{0};
+    std::atomic<uint64_t> seeks_{0};
+    std::atomic<uint64_t> advises_{0};
+    std::atomic<uint64_t> bytes_{0};
+};
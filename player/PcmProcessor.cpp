@@ -0,0 +1,339 @@
+#include "PcmProcessor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PCM_HAVE_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PCM_HAVE_NEON 1
+#endif
+
+namespace {
+// 增益为 Q14 定点数，1.0 == 16384，上限 32767（约 2.0）
+constexpr int kGainShift = 14;
+constexpr int32_t kGainRound = 1 << (kGainShift - 1);
+
+struct Accum {
+    uint16_t peak[PcmLevels::kMaxChannels]{};
+    uint64_t sumsq[PcmLevels::kMaxChannels]{};
+};
+
+inline int16_t applyGain(int16_t s, int32_t gain) {
+    int32_t v = (static_cast<int32_t>(s) * gain + kGainRound) >> kGainShift;
+    return static_cast<int16_t>(std::clamp(v, -32768, 32767));
+}
+
+inline void meter(int16_t s, int ch, Accum &acc) {
+    // 与 SIMD 版本一致，-32768 饱和到 32767
+    uint16_t a = s == -32768 ? 32767 : static_cast<uint16_t>(std::abs(s));
+    acc.peak[ch] = std::max(acc.peak[ch], a);
+    acc.sumsq[ch] += static_cast<uint64_t>(static_cast<int32_t>(s) * s);
+}
+
+// 任意声道数，也处理 SIMD 剩下的尾巴
+void scalarKernel(int16_t *data, size_t count, int nch, size_t offset,
+                  int32_t gain, Accum &acc) {
+    for (size_t i = 0; i < count; ++i) {
+        int16_t s = applyGain(data[i], gain);
+        data[i] = s;
+        meter(s, static_cast<int>((offset + i) % nch), acc);
+    }
+}
+
+using Kernel = size_t (*)(int16_t *data, size_t count, int nch, int32_t gain,
+                          Accum &acc);
+
+// 全部交给 scalarKernel
+size_t scalarOnly(int16_t *, size_t, int, int32_t, Accum &) {
+    return 0;
+}
+
+// 平方和最大 2^30，32 位无符号累加器装 3 个向量不会溢出，之后扩展到
+// 64 位。不做移位，和标量版本的结果完全一样
+constexpr size_t kBlockVectors = 3;
+
+// SIMD 只处理 1/2 声道：偶数 lane 属于声道 0，奇数 lane 属于声道 1 % nch，
+// 返回处理了多少个采样
+#ifdef PCM_HAVE_X86
+size_t sse2Kernel(int16_t *data, size_t count, int nch, int32_t gain,
+                  Accum &acc) {
+    const __m128i g = _mm_set1_epi16(static_cast<int16_t>(gain));
+    const __m128i rnd = _mm_set1_epi32(kGainRound);
+    const __m128i even = _mm_set1_epi32(0x0000ffff);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i peak = zero;
+    __m128i acc_even = zero;
+    __m128i acc_odd = zero;
+
+    size_t n = count & ~size_t{7};
+    for (size_t block = 0; block < n; block += kBlockVectors * 8) {
+        // 平方和先累加到 32 位，每个块结束再扩展到 64 位
+        __m128i sum_even = zero;
+        __m128i sum_odd = zero;
+        size_t end = std::min(n, block + kBlockVectors * 8);
+        for (size_t i = block; i < end; i += 8) {
+            auto *p = reinterpret_cast<__m128i *>(data + i);
+            __m128i x = _mm_loadu_si128(p);
+            __m128i lo = _mm_mullo_epi16(x, g);
+            __m128i hi = _mm_mulhi_epi16(x, g);
+            __m128i p0 = _mm_srai_epi32(
+                _mm_add_epi32(_mm_unpacklo_epi16(lo, hi), rnd), kGainShift);
+            __m128i p1 = _mm_srai_epi32(
+                _mm_add_epi32(_mm_unpackhi_epi16(lo, hi), rnd), kGainShift);
+            __m128i y = _mm_packs_epi32(p0, p1);
+            _mm_storeu_si128(p, y);
+
+            peak = _mm_max_epi16(peak,
+                                 _mm_max_epi16(y, _mm_subs_epi16(zero, y)));
+
+            __m128i e = _mm_madd_epi16(_mm_and_si128(y, even), y);
+            __m128i o = _mm_madd_epi16(_mm_andnot_si128(even, y), y);
+            sum_even = _mm_add_epi32(sum_even, e);
+            sum_odd = _mm_add_epi32(sum_odd, o);
+        }
+        acc_even = _mm_add_epi64(acc_even, _mm_unpacklo_epi32(sum_even, zero));
+        acc_even = _mm_add_epi64(acc_even, _mm_unpackhi_epi32(sum_even, zero));
+        acc_odd = _mm_add_epi64(acc_odd, _mm_unpacklo_epi32(sum_odd, zero));
+        acc_odd = _mm_add_epi64(acc_odd, _mm_unpackhi_epi32(sum_odd, zero));
+    }
+
+    alignas(16) int16_t peaks[8];
+    alignas(16) uint64_t sums_even[2];
+    alignas(16) uint64_t sums_odd[2];
+    _mm_store_si128(reinterpret_cast<__m128i *>(peaks), peak);
+    _mm_store_si128(reinterpret_cast<__m128i *>(sums_even), acc_even);
+    _mm_store_si128(reinterpret_cast<__m128i *>(sums_odd), acc_odd);
+    int odd_ch = 1 % nch;
+    for (int l = 0; l < 8; ++l) {
+        int ch = l % 2 ? odd_ch : 0;
+        acc.peak[ch] = std::max(acc.peak[ch], static_cast<uint16_t>(peaks[l]));
+    }
+    acc.sumsq[0] += sums_even[0] + sums_even[1];
+    acc.sumsq[odd_ch] += sums_odd[0] + sums_odd[1];
+    return n;
+}
+
+__attribute__((target("avx2")))
+size_t avx2Kernel(int16_t *data, size_t count, int nch, int32_t gain,
+                  Accum &acc) {
+    const __m256i g = _mm256_set1_epi16(static_cast<int16_t>(gain));
+    const __m256i rnd = _mm256_set1_epi32(kGainRound);
+    const __m256i even = _mm256_set1_epi32(0x0000ffff);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i peak = zero;
+    __m256i acc_even = zero;
+    __m256i acc_odd = zero;
+
+    // unpack/pack 都按 128 位通道进行，顺序能互相抵消
+    size_t n = count & ~size_t{15};
+    for (size_t block = 0; block < n; block += kBlockVectors * 16) {
+        __m256i sum_even = zero;
+        __m256i sum_odd = zero;
+        size_t end = std::min(n, block + kBlockVectors * 16);
+        for (size_t i = block; i < end; i += 16) {
+            auto *p = reinterpret_cast<__m256i *>(data + i);
+            __m256i x = _mm256_loadu_si256(p);
+            __m256i lo = _mm256_mullo_epi16(x, g);
+            __m256i hi = _mm256_mulhi_epi16(x, g);
+            __m256i p0 = _mm256_srai_epi32(
+                _mm256_add_epi32(_mm256_unpacklo_epi16(lo, hi), rnd),
+                kGainShift);
+            __m256i p1 = _mm256_srai_epi32(
+                _mm256_add_epi32(_mm256_unpackhi_epi16(lo, hi), rnd),
+                kGainShift);
+            __m256i y = _mm256_packs_epi32(p0, p1);
+            _mm256_storeu_si256(p, y);
+
+            peak = _mm256_max_epi16(
+                peak, _mm256_max_epi16(y, _mm256_subs_epi16(zero, y)));
+
+            __m256i e = _mm256_madd_epi16(_mm256_and_si256(y, even), y);
+            __m256i o = _mm256_madd_epi16(_mm256_andnot_si256(even, y), y);
+            sum_even = _mm256_add_epi32(sum_even, e);
+            sum_odd = _mm256_add_epi32(sum_odd, o);
+        }
+        acc_even = _mm256_add_epi64(acc_even,
+                                    _mm256_unpacklo_epi32(sum_even, zero));
+        acc_even = _mm256_add_epi64(acc_even,
+                                    _mm256_unpackhi_epi32(sum_even, zero));
+        acc_odd = _mm256_add_epi64(acc_odd,
+                                   _mm256_unpacklo_epi32(sum_odd, zero));
+        acc_odd = _mm256_add_epi64(acc_odd,
+                                   _mm256_unpackhi_epi32(sum_odd, zero));
+    }
+
+    alignas(32) int16_t peaks[16];
+    alignas(32) uint64_t sums_even[4];
+    alignas(32) uint64_t sums_odd[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(peaks), peak);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(sums_even), acc_even);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(sums_odd), acc_odd);
+    int odd_ch = 1 % nch;
+    for (int l = 0; l < 16; ++l) {
+        int ch = l % 2 ? odd_ch : 0;
+        acc.peak[ch] = std::max(acc.peak[ch], static_cast<uint16_t>(peaks[l]));
+    }
+    for (int l = 0; l < 4; ++l) {
+        acc.sumsq[0] += sums_even[l];
+        acc.sumsq[odd_ch] += sums_odd[l];
+    }
+    return n;
+}
+#endif
+
+#ifdef PCM_HAVE_NEON
+size_t neonKernel(int16_t *data, size_t count, int nch, int32_t gain,
+                  Accum &acc) {
+    const int16x4_t g = vdup_n_s16(static_cast<int16_t>(gain));
+    int16x8_t peak = vdupq_n_s16(0);
+    uint64x2_t acc_even = vdupq_n_u64(0);
+    uint64x2_t acc_odd = vdupq_n_u64(0);
+
+    size_t n = count & ~size_t{7};
+    for (size_t i = 0; i < n; i += 8) {
+        int16x8_t x = vld1q_s16(data + i);
+        int32x4_t lo = vrshrq_n_s32(vmull_s16(vget_low_s16(x), g), kGainShift);
+        int32x4_t hi = vrshrq_n_s32(vmull_s16(vget_high_s16(x), g),
+                                    kGainShift);
+        int16x8_t y = vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+        vst1q_s16(data + i, y);
+
+        peak = vmaxq_s16(peak, vqabsq_s16(y));
+
+        uint32x4_t sq_lo = vreinterpretq_u32_s32(
+            vmull_s16(vget_low_s16(y), vget_low_s16(y)));
+        uint32x4_t sq_hi = vreinterpretq_u32_s32(
+            vmull_s16(vget_high_s16(y), vget_high_s16(y)));
+        uint32x4x2_t uz = vuzpq_u32(sq_lo, sq_hi);
+        acc_even = vpadalq_u32(acc_even, uz.val[0]);
+        acc_odd = vpadalq_u32(acc_odd, uz.val[1]);
+    }
+
+    int16_t peaks[8];
+    vst1q_s16(peaks, peak);
+    int odd_ch = 1 % nch;
+    for (int l = 0; l < 8; ++l) {
+        int ch = l % 2 ? odd_ch : 0;
+        acc.peak[ch] = std::max(acc.peak[ch], static_cast<uint16_t>(peaks[l]));
+    }
+    acc.sumsq[0] += vgetq_lane_u64(acc_even, 0) + vgetq_lane_u64(acc_even, 1);
+    acc.sumsq[odd_ch] += vgetq_lane_u64(acc_odd, 0) +
+        vgetq_lane_u64(acc_odd, 1);
+    return n;
+}
+#endif
+
+struct KernelChoice {
+    Kernel kernel;
+    const char *name;
+};
+
+// 这台机器能用的实现，从快到慢
+std::vector<KernelChoice> availableKernels() {
+    std::vector<KernelChoice> kernels;
+#ifdef PCM_HAVE_X86
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({avx2Kernel, "avx2"});
+    }
+    kernels.push_back({sse2Kernel, "sse2"});
+#elif defined(PCM_HAVE_NEON)
+    kernels.push_back({neonKernel, "neon"});
+#endif
+    kernels.push_back({scalarOnly, "scalar"});
+    return kernels;
+}
+
+const std::vector<KernelChoice> g_kernels = availableKernels();
+std::atomic<const KernelChoice *> g_kernel{&g_kernels.front()};
+}
+
+void PcmProcessor::SetVolume(float volume) {
+    volume_ = std::clamp(volume, 0.0f, 2.0f);
+}
+
+void PcmProcessor::SetMute(bool mute) {
+    muted_ = mute;
+}
+
+int32_t PcmProcessor::targetGain() const {
+    if (muted_) {
+        return 0;
+    }
+    return std::min<int32_t>(std::lround(volume_ * (1 << kGainShift)), 32767);
+}
+
+const char *PcmProcessor::KernelName() {
+    return g_kernel.load(std::memory_order_relaxed)->name;
+}
+
+std::vector<std::string> PcmProcessor::Kernels() {
+    std::vector<std::string> names;
+    for (auto const &kernel : g_kernels) {
+        names.emplace_back(kernel.name);
+    }
+    return names;
+}
+
+bool PcmProcessor::UseKernel(const std::string &name) {
+    for (auto const &kernel : g_kernels) {
+        if (name == kernel.name) {
+            g_kernel.store(&kernel, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void PcmProcessor::Process(int16_t *samples, int frames, int channels,
+                           int rate) {
+    if (!samples || frames <= 0 || channels <= 0 ||
+        channels > PcmLevels::kMaxChannels) {
+        return;
+    }
+    Accum acc;
+    size_t total = static_cast<size_t>(frames) * channels;
+    size_t done = 0;
+
+    // 增益变化时先逐帧线性渐变，再走 SIMD 的恒定增益路径
+    int32_t target = targetGain();
+    if (gain_q14_ != target) {
+        int ramp_frames = std::min(
+            frames, std::max(1, rate * kRampMs / 1000));
+        int32_t start = gain_q14_;
+        for (int f = 0; f < ramp_frames; ++f) {
+            int32_t gain = start + (target - start) * (f + 1) / ramp_frames;
+            scalarKernel(samples + done, channels, channels, 0, gain, acc);
+            done += channels;
+        }
+        gain_q14_ = target;
+    }
+
+    int16_t *rest = samples + done;
+    size_t remain = total - done;
+    size_t simd = 0;
+    if (channels <= 2) {
+        simd = g_kernel.load(std::memory_order_relaxed)->kernel(
+            rest, remain, channels, gain_q14_, acc);
+    }
+    // SIMD 块长度是声道数的整数倍，尾巴从声道 0 开始
+    scalarKernel(rest + simd, remain - simd, channels, 0, gain_q14_, acc);
+
+    PcmLevels levels;
+    levels.channels = channels;
+    for (int ch = 0; ch < channels; ++ch) {
+        levels.peak[ch] = acc.peak[ch] / 32768.0f;
+        levels.rms[ch] = static_cast<float>(
+            std::sqrt(static_cast<double>(acc.sumsq[ch]) / frames) / 32768.0);
+    }
+    std::lock_guard<std::mutex> lock(levels_mtx_);
+    levels_ = levels;
+}
+
+PcmLevels PcmProcessor::Levels() const {
+    std::lock_guard<std::mutex> lock(levels_mtx_);
+    return levels_;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 每个声道的电平，范围 0~1
+struct PcmLevels {
+    static constexpr int kMaxChannels = 8;
+    int channels{};
+    std::array<float, kMaxChannels> peak{};
+    std::array<float, kMaxChannels> rms{};
+};
+
+// SwrConvert 之后的 S16 交错 PCM 处理：音量、静音渐变，
+// 同一遍扫描里顺便统计每个声道的峰值和 RMS
+class PcmProcessor {
+public:
+    // 0 ~ 2，超过 1 为放大
+    void SetVolume(float volume);
+    void SetMute(bool mute);
+
+    float volume() const {
+        return volume_;
+    }
+
+    bool muted() const {
+        return muted_;
+    }
+
+    void Process(int16_t *samples, int frames, int channels, int rate);
+    PcmLevels Levels() const;
+
+    // 当前使用的 SIMD 实现：avx2 / sse2 / neon / scalar
+    static const char *KernelName();
+    // 这台机器能用的实现，第一个是默认的
+    static std::vector<std::string> Kernels();
+    // 换成指定的实现，测试和 benchmark 对比用，不支持时返回 false
+    static bool UseKernel(const std::string &name);
+
+    // 音量变化时的渐变时长，避免拉链噪声
+    static constexpr int kRampMs = 10;
+
+private:
+    int32_t targetGain() const;
+
+    std::atomic<float> volume_{1.0f};
+    std::atomic<bool> muted_{false};
+    int32_t gain_q14_{1 << 14}; // 只在音频线程访问
+
+    mutable std::mutex levels_mtx_;
+    PcmLevels levels_{};
+};
@@ -1,10 +1,27 @@
 #include "PlayerController.h"
 #include <spdlog/spdlog.h>
 #include "FFmpegWrapper.h"
+#include "AvioSource.h"
 #include "PlayerWidget.h"
+#include "KeyframeIndex.h"
+#include "Scrubber.h"
+#include "FrameNavigator.h"
+#include "LiveLatency.h"
+#include "IoInterrupt.h"
+#include "Metrics.h"
+#include "Tracer.h"
+#include "Log.h"
 #include <boost/lockfree/spsc_queue.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <future>
 
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
 namespace {
 AVFormatContext *g_format_context;
 AVCodecContext *videoCodecContext;
@@ -12,7 +29,12 @@ AVCodecContext *audioCodecContext;
 int videoStream;
 int audioStream;
 std::chrono::milliseconds g_start_time;
-std::chrono::milliseconds g_total_video_time;
+// 后台探测和建索引的线程会补上时长，界面线程读
+std::atomic<int64_t> g_total_video_ms = 0;
+// 每换一次输入（播放列表切节目、直播重连）加一。后台探测按它判断节目
+// 有没有换，换节目和探测写时长都在 g_duration_mtx 里
+std::atomic<uint64_t> g_media_generation = 0;
+std::mutex g_duration_mtx;
 
 std::mutex g_mtx_pause;
 std::condition_variable g_cv_pause;
@@ -22,13 +44,827 @@ std::atomic_bool g_is_paused = false;
 std::atomic_bool g_is_seeking = false;
 std::atomic_int g_seek_pos_ms = 0;
 
-boost::lockfree::spsc_queue<AVPacket *, boost::lockfree::capacity<128>>
+// 精确 seek：落到关键帧后继续解码，目标之前的帧直接丢掉，不转换也不显示
+std::atomic_bool g_exact_seek = false;
+std::atomic<int64_t> g_video_discard_until_ms = -1;
+std::atomic<int64_t> g_audio_discard_until_ms = -1;
+// 音频等视频解到目标帧最多等这么久，解码太慢时先出声
+constexpr std::chrono::milliseconds kExactSeekAudioWait{3000};
+std::atomic<std::chrono::steady_clock::time_point> g_seek_request_time;
+// 暂停中的 seek：做完以后仍然暂停，目标帧当封面显示
+std::atomic_bool g_seek_keep_paused = false;
+// 每次 SeekTo 加一，读线程只执行最新的一次；g_in_seek 期间
+// 来了新请求时 demuxer 的中断回调让正在进行的 av_seek_frame 返回
+std::atomic<uint64_t> g_seek_generation = 0;
+std::atomic<uint64_t> g_active_seek_generation = 0;
+std::atomic_bool g_in_seek = false;
+std::atomic_int g_seek_requests = 0;
+std::atomic_int g_last_seek_coalesced = 0;
+std::atomic<uint64_t> g_seeks_superseded = 0;
+// seek 后第一帧画面送出时记录耗时：0 不记录，1 关键帧 seek，2 精确 seek
+std::atomic_int g_seek_measure = 0;
+std::mutex g_seek_stats_mtx;
+SeekStats g_seek_stats;
+// 最近送出显示的视频帧的时间戳（视频流 time_base），逐帧/倒放从这里开始
+std::atomic<int64_t> g_last_video_pts = 0;
+// 起播耗时，g_startup_stage 是正在等的阶段：
+// 1 首个视频包，2 首个解码帧，3 首次上屏，0 不在测量
+std::atomic_bool g_fast_start = false;
+std::mutex g_startup_mtx;
+StartupTiming g_startup;
+std::chrono::steady_clock::time_point g_startup_mark;
+std::atomic_int g_startup_stage = 0;
+// 点播放到下一帧上屏：1 等视频线程送帧，2 等上屏
+std::chrono::steady_clock::time_point g_click_time;
+std::atomic_int g_click_stage = 0;
+// Ready 状态预加载中，视频线程解出的第一帧不等时钟直接当封面
+std::atomic_bool g_prerolling = false;
+// 直播：时钟对齐到第一个包的 pts，延迟超过目标时加速或跳着追，
+// 追赶中落后太多的音视频帧直接丢掉
+std::atomic_bool g_live = false;
+std::atomic_bool g_live_aligned = false;
+LiveLatency g_live_latency;
+constexpr int64_t kLiveDropLateMs = 200;
+// 直播断线重连，间隔从 250ms 开始翻倍，最多 8s
+std::mutex g_reconnect_mtx;
+ReconnectStats g_reconnect;
+constexpr std::chrono::milliseconds kReconnectMinBackoff{250};
+constexpr std::chrono::milliseconds kReconnectMaxBackoff{8000};
+// 卡顿统计。g_clock_shifted_ms 累计 shiftClock 拨过的量，比较晚到时
+// 扣掉，直播追赶拨时钟造成的晚到不算卡住
+constexpr int64_t kStallMs = 20;
+std::mutex g_stall_mtx;
+StallStats g_stalls;
+int64_t g_stall_last_late = 0;
+std::atomic<int64_t> g_clock_shifted_ms = 0;
+
+constexpr int kVideoQueueCapacity = 128;
+constexpr int kAudioQueueCapacity = 1024;
+boost::lockfree::spsc_queue<AVPacket *,
+                            boost::lockfree::capacity<kVideoQueueCapacity>>
 g_buffer_video;
-boost::lockfree::spsc_queue<AVPacket *, boost::lockfree::capacity<1024>>
+boost::lockfree::spsc_queue<AVPacket *,
+                            boost::lockfree::capacity<kAudioQueueCapacity>>
 g_buffer_audio;
 FFmpeg::SwrResample *g_swr{};
+AudioSinkFactory g_audio_sink_factory;
+PcmProcessor g_pcm_processor;
+KeyframeIndex g_keyframe_index;
 AVRational g_audio_pts_base;
 std::chrono::time_point<std::chrono::system_clock> g_last_pause_point;
+
+// 播放列表：下一项在后台提前打开，读线程读到 EOF 时无缝切换
+struct PreparedItem {
+    std::string url;
+    AVFormatContext *format_context{};
+    AVCodecContext *video_codec{};
+    AVCodecContext *audio_codec{};
+    int video_stream{-1};
+    int audio_stream{-1};
+    std::chrono::milliseconds total{};
+    std::deque<AVPacket *> first_gop;
+
+    ~PreparedItem() {
+        for (auto *packet : first_gop) {
+            av_packet_free(&packet);
+        }
+        avcodec_free_context(&video_codec);
+        avcodec_free_context(&audio_codec);
+        AvioSource::CloseInput(format_context);
+    }
+};
+
+constexpr std::chrono::milliseconds kPreloadAhead{5000};
+constexpr int kMaxPrerollPackets = 500;
+constexpr int kAllSwitchAcks = 0b11;
+
+std::mutex g_playlist_mtx;
+std::deque<std::string> g_playlist;
+std::future<std::unique_ptr<PreparedItem>> g_next_item;
+// 读线程要求两个解码线程确认已经消费完当前节目
+std::atomic_bool g_switching = false;
+std::atomic_int g_switch_acks = 0;
+// 停在暂停点的解码线程，位和 g_switch_acks 一样，在 g_mtx_pause 里改
+std::atomic_int g_parked = 0;
+// 当前节目已读到的最大结束时间
+int64_t g_item_end_ms = 0;
+
+double msSince(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - begin).count();
+}
+
+// 包的 pts 换算成毫秒，没有 pts 返回 -1
+int64_t packetMs(AVPacket const *packet) {
+    if (packet->pts == AV_NOPTS_VALUE || !g_format_context ||
+        packet->stream_index >=
+        static_cast<int>(g_format_context->nb_streams)) {
+        return -1;
+    }
+    return av_rescale_q(packet->pts,
+                        g_format_context->streams[packet->stream_index]->
+                        time_base, {1, 1000});
+}
+
+// 包队列的深度。毫秒数是最后入队和最后出队的包的 pts 之差
+struct QueueMetrics {
+    explicit QueueMetrics(const std::string &name)
+        : packets(Metrics::Get().gauge(name + ".queue_packets")),
+          bytes(Metrics::Get().gauge(name + ".queue_bytes")),
+          ms(Metrics::Get().gauge(name + ".queue_ms")) {}
+
+    // 入队成功之后记，解码线程可能抢先出队，计数会短暂少一个
+    void Push(int size, int64_t pts_ms) {
+        packets.Add(1);
+        bytes.Add(size);
+        if (pts_ms >= 0) {
+            in_ms = pts_ms;
+            update();
+        }
+    }
+
+    void Pop(AVPacket const *packet) {
+        packets.Add(-1);
+        bytes.Add(-packet->size);
+        if (int64_t pts_ms = packetMs(packet); pts_ms >= 0) {
+            out_ms = pts_ms;
+            update();
+        }
+    }
+
+    // seek 清空队列之后和换节目时调用，pts 重新开始算
+    void Clear() {
+        packets.Set(0);
+        bytes.Set(0);
+        ms.Set(0);
+        in_ms = -1;
+        out_ms = -1;
+    }
+
+    Metrics::Gauge &packets;
+    Metrics::Gauge &bytes;
+    Metrics::Gauge &ms;
+
+private:
+    void update() {
+        int64_t in = in_ms;
+        int64_t out = out_ms;
+        if (in >= 0 && out >= 0) {
+            ms.Set(static_cast<double>(std::max<int64_t>(in - out, 0)));
+        }
+    }
+
+    std::atomic<int64_t> in_ms{-1};
+    std::atomic<int64_t> out_ms{-1};
+};
+
+// 管线各阶段的指标，第一次用到时注册，之后热路径上只有原子操作。
+// 计数和直方图从进程启动开始累计，不随 Open 清零
+struct PipelineMetrics {
+    Metrics::Histogram &readMs = Metrics::Get().histogram("demux.read_ms");
+    Metrics::Counter &readErrors = Metrics::Get().counter("demux.errors");
+    Metrics::Counter &queueFull = Metrics::Get().counter("demux.queue_full");
+    QueueMetrics videoQueue{"video"};
+    QueueMetrics audioQueue{"audio"};
+    Metrics::Counter &videoStarved =
+        Metrics::Get().counter("video.queue_empty");
+    Metrics::Histogram &videoDecodeMs =
+        Metrics::Get().histogram("video.decode_ms");
+    Metrics::Histogram &audioDecodeMs =
+        Metrics::Get().histogram("audio.decode_ms");
+    // 重采样加写入音频设备
+    Metrics::Histogram &audioOutputMs =
+        Metrics::Get().histogram("audio.output_ms");
+    // 送出显示时比该显示的时刻晚多少，早到的记 0
+    Metrics::Histogram &lateMs = Metrics::Get().histogram("video.late_ms");
+    Metrics::Counter &videoFrames = Metrics::Get().counter("video.frames");
+    // 直播追赶丢掉的帧
+    Metrics::Counter &videoDropped = Metrics::Get().counter("video.dropped");
+    Metrics::Counter &audioDropped = Metrics::Get().counter("audio.dropped");
+    // 精确 seek 解码后丢掉的目标前的帧
+    Metrics::Counter &videoDiscarded =
+        Metrics::Get().counter("video.discarded");
+    Metrics::Gauge &driftMs = Metrics::Get().gauge("av.drift_ms");
+    Metrics::Gauge &correction =
+        Metrics::Get().gauge("av.correction_percent");
+};
+
+PipelineMetrics g_metrics;
+
+// 界面线程来读，解码器和 demuxer 换掉时读线程在这里更新一份
+std::mutex g_stream_mtx;
+StreamInfo g_stream_info;
+
+void updateStreamInfo() {
+    StreamInfo info;
+    // 直播可能只有一路，没有的那路留空
+    if (videoStream >= 0) {
+        AVStream *video = g_format_context->streams[videoStream];
+        info.videoCodec = videoCodecContext->codec->name;
+        info.width = video->codecpar->width;
+        info.height = video->codecpar->height;
+        if (const char *name = av_get_pix_fmt_name(
+                static_cast<AVPixelFormat>(video->codecpar->format))) {
+            info.pixelFormat = name;
+        }
+        if (video->avg_frame_rate.num > 0 && video->avg_frame_rate.den > 0) {
+            info.fps = av_q2d(video->avg_frame_rate);
+        }
+    }
+    if (audioStream >= 0) {
+        AVStream *audio = g_format_context->streams[audioStream];
+        info.audioCodec = audioCodecContext->codec->name;
+        info.sampleRate = audio->codecpar->sample_rate;
+        info.channels = audio->codecpar->channels;
+    }
+    info.videoQueueCapacity = kVideoQueueCapacity;
+    info.audioQueueCapacity = kAudioQueueCapacity;
+    std::lock_guard<std::mutex> lock(g_stream_mtx);
+    g_stream_info = std::move(info);
+}
+
+void recordSeekLatency(bool exact, int discarded_frames) {
+    double ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - g_seek_request_time.load()).count();
+    std::lock_guard<std::mutex> lock(g_seek_stats_mtx);
+    SeekLatency &latency = exact ? g_seek_stats.exact : g_seek_stats.keyframe;
+    latency.lastMs = ms;
+    latency.count++;
+    latency.avgMs += (ms - latency.avgMs) / latency.count;
+    if (exact) {
+        g_seek_stats.discardedFrames = discarded_frames;
+    }
+    g_seek_stats.coalesced = g_last_seek_coalesced;
+    g_seek_stats.superseded = g_seeks_superseded;
+    spdlog::info("{} seek #{}: first frame after {:.1f}ms, coalesced {} "
+                 "requests, discarded {} frames",
+                 exact ? "exact" : "keyframe", g_seek_generation.load(), ms,
+                 g_seek_stats.coalesced, discarded_frames);
+}
+
+double startupLap() {
+    auto now = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(
+        now - g_startup_mark).count();
+    g_startup_mark = now;
+    return ms;
+}
+
+void markStartup(int stage) {
+    if (g_startup_stage != stage) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(g_startup_mtx);
+    if (g_startup_stage != stage) {
+        return;
+    }
+    StartupTiming &t = g_startup;
+    switch (stage) {
+    case 1:
+        t.firstPacketMs = startupLap();
+        break;
+    case 2:
+        t.firstFrameMs = startupLap();
+        break;
+    default:
+        t.firstPaintMs = startupLap();
+        t.totalMs = t.openMs + t.probeMs + t.codecMs + t.firstPacketMs +
+                    t.firstFrameMs + t.firstPaintMs;
+        t.complete = true;
+        spdlog::info("startup{}: open {:.1f}ms, probe {:.1f}ms{}, codec "
+                     "{:.1f}ms, first packet {:.1f}ms, first frame {:.1f}ms, "
+                     "first paint {:.1f}ms, total {:.1f}ms",
+                     t.fastStart ? " (fast)" : "", t.openMs, t.probeMs,
+                     t.probeSkipped ? " (skipped)" : "", t.codecMs,
+                     t.firstPacketMs, t.firstFrameMs, t.firstPaintMs,
+                     t.totalMs);
+        break;
+    }
+    g_startup_stage = stage == 3 ? 0 : stage + 1;
+}
+
+void markClick(int stage) {
+    if (g_click_stage != stage) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(g_startup_mtx);
+    if (g_click_stage != stage) {
+        return;
+    }
+    if (stage == 1) {
+        g_click_stage = 2;
+        return;
+    }
+    g_startup.clickToFrameMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - g_click_time).count();
+    spdlog::info("click to first frame {:.1f}ms", g_startup.clickToFrameMs);
+    g_click_stage = 0;
+}
+
+// 正数让时钟往回拨，负数往前拨
+void shiftClock(std::chrono::milliseconds delta) {
+    std::chrono::milliseconds current = g_pause_time.load();
+    while (!g_pause_time.compare_exchange_weak(current, current + delta)) {}
+    g_clock_shifted_ms += delta.count();
+}
+
+int64_t clockMs() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(
+        (system_clock::now() - g_pause_time.load() - g_start_time).
+        time_since_epoch()).count();
+}
+
+// 帧送出时调用，late_ms 为比该显示的时刻晚了多少。晚到在帧之间变多
+// 说明画面停住了，数据到了以后后面的帧不等时钟连着送出，晚到又降回去
+void recordLateness(int64_t late_ms, bool reset) {
+    std::lock_guard<std::mutex> lock(g_stall_mtx);
+    int64_t shifted = g_clock_shifted_ms;
+    // 上一帧的晚到换算到现在的时钟上
+    int64_t last = g_stall_last_late - shifted;
+    g_stall_last_late = late_ms + shifted;
+    if (reset || late_ms <= kStallMs) {
+        return;
+    }
+    int64_t grown = late_ms - std::max<int64_t>(last, 0);
+    if (grown > 0) {
+        if (last <= kStallMs) {
+            g_stalls.underruns++;
+        }
+        g_stalls.rebufferMs += grown;
+    }
+    g_stalls.lateFrames++;
+    g_stalls.maxLateMs = std::max<double>(g_stalls.maxLateMs, late_ms);
+}
+
+// 推流端采集这个包的 unix 时间：优先包上的 PRFT，其次 RTSP 的
+// RTCP SR 之类给出的 start_time_realtime，都没有返回 -1
+int64_t senderClockUs(AVPacket const *packet, int64_t pts_ms) {
+    size_t size = 0;
+    auto *prft = reinterpret_cast<AVProducerReferenceTime const *>(
+        av_packet_get_side_data(packet, AV_PKT_DATA_PRFT, &size));
+    if (prft && size >= sizeof(*prft)) {
+        return prft->wallclock;
+    }
+    if (g_format_context->start_time_realtime != AV_NOPTS_VALUE &&
+        g_format_context->start_time != AV_NOPTS_VALUE) {
+        return g_format_context->start_time_realtime + pts_ms * 1000 -
+               g_format_context->start_time;
+    }
+    return -1;
+}
+
+// 暂停期间的时长加到 g_pause_time 里，时钟从暂停点继续
+void resumeClock() {
+    auto now = std::chrono::system_clock::now();
+    auto delta = std::chrono::duration_cast<std::chrono::milliseconds>(
+        now - g_last_pause_point);
+
+    // 自旋 CAS（compare-exchange）实现原子加法
+    std::chrono::milliseconds current = g_pause_time.load();
+    while (!g_pause_time.compare_exchange_weak(current, current + delta)) {}
+    g_is_paused = false;
+    g_cv_pause.notify_all();
+}
+
+// fast start 跳过或截断了探测，第一帧上屏后另开一个 demuxer 做完整的
+// find_stream_info，补上容器头里没有的时长
+void deferredProbe(std::stop_token token, std::string url,
+                   uint64_t generation) {
+    while (!token.stop_requested() && g_startup_stage != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (token.stop_requested()) {
+        return;
+    }
+    AVFormatContext *ctx = avformat_alloc_context();
+    ctx->interrupt_callback = {
+        [](void *opaque) {
+            return static_cast<int>(
+                static_cast<std::stop_token *>(opaque)->stop_requested());
+        },
+        &token};
+    if (AvioSource::OpenInput(ctx, url) != 0) {
+        return;
+    }
+    if (avformat_find_stream_info(ctx, nullptr) >= 0) {
+        int64_t duration_ms = ctx->duration != AV_NOPTS_VALUE
+                                  ? ctx->duration / 1000
+                                  : 0;
+        // 播放列表已经切走的话不再改，期间别处已经给了时长也不覆盖
+        if (duration_ms > 0) {
+            int64_t unknown = 0;
+            std::lock_guard<std::mutex> lock(g_duration_mtx);
+            if (g_media_generation == generation) {
+                g_total_video_ms.compare_exchange_strong(unknown,
+                                                         duration_ms);
+            }
+        }
+        spdlog::info("deferred probe {}: {} streams, duration {}ms", url,
+                     ctx->nb_streams, duration_ms);
+    }
+    AvioSource::CloseInput(ctx);
+}
+
+// 只在 seek 期间生效，打断已经过时的 av_seek_frame
+int seekInterrupted(void *) {
+    return g_in_seek && g_seek_generation != g_active_seek_generation;
+}
+
+// 当前节目的 demuxer 只在 Open 和读线程里做 I/O，播放列表预加载另用
+// 一个。StopThreads 先让两者的 I/O 立刻返回再 join，每次打开、读包、
+// seek 另有截止时间，断掉的网络源不会让关闭和 seek 一直卡住
+IoInterrupt g_io([] { return seekInterrupted(nullptr) != 0; });
+IoInterrupt g_preload_io;
+constexpr std::chrono::milliseconds kOpenTimeout{10000};
+constexpr std::chrono::milliseconds kReadTimeout{10000};
+constexpr std::chrono::milliseconds kSeekTimeout{5000};
+
+FFmpeg::HasError readPacket(AVPacket *&packet, int64_t seq) {
+    IoInterrupt::Deadline deadline(g_io, kReadTimeout);
+    ScopedTimer timer(g_metrics.readMs);
+    Tracer::Span span("read");
+    auto err = FFmpeg::readPaket(g_format_context, packet);
+    if (err && err.errorCode != AVERROR_EOF &&
+        err.errorCode != AVERROR(EAGAIN)) {
+        g_metrics.readErrors.Add();
+    }
+    if (!err && Tracer::Enabled()) {
+        span.SetPts(packetMs(packet), seq);
+    }
+    return err;
+}
+
+// 读线程先放包再置 g_switching，看到 g_switching 以后再看一次队列，
+// 刚放进去的包（比如结尾的 drain 包）不会被当成已经消费完
+template <typename Queue>
+void ackSwitch(int bit, Queue &queue) {
+    if (g_switching && queue.read_available() == 0) {
+        g_switch_acks.fetch_or(bit);
+    }
+}
+
+// 暂停时解码线程停在这里，停着的时候不碰解码器和 demuxer。暂停中
+// 重连等不到缓冲播完，靠 g_parked 知道可以直接换输入。返回 true 表示
+// 停着的时候输入换了，手上解出来的是旧连接的帧
+bool waitWhilePaused(std::stop_token const &token, int bit) {
+    std::unique_lock<std::mutex> lock(g_mtx_pause);
+    uint64_t generation = g_media_generation;
+    if (g_is_paused && !token.stop_requested() && !g_is_seeking) {
+        g_parked.fetch_or(bit);
+        while (g_is_paused && !token.stop_requested() && !g_is_seeking) {
+            g_cv_pause.wait(lock);
+        }
+        g_parked.fetch_and(~bit);
+    }
+    return g_media_generation != generation;
+}
+
+// 没有数据的包，解码器收到后吐出还压着的帧（B 帧重排、帧级多线程）
+bool isDrainPacket(AVPacket const *packet) {
+    return !packet->data && packet->size == 0;
+}
+
+// 读到结尾时给两个解码线程各放一个 drain 包，最后几帧和音频解码器里
+// 缓冲的数据在换节目之前播完
+void queueDrainPackets(std::stop_token const &token) {
+    auto push = [&token](auto &queue, QueueMetrics &metrics) {
+        AVPacket *packet = av_packet_alloc();
+        while (!queue.push(packet)) {
+            if (token.stop_requested() || g_is_seeking) {
+                av_packet_free(&packet);
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(3));
+        }
+        metrics.Push(0, -1);
+    };
+    push(g_buffer_video, g_metrics.videoQueue);
+    push(g_buffer_audio, g_metrics.audioQueue);
+}
+
+void buildKeyframeIndex(const std::string &url) {
+    g_keyframe_index.Reset();
+    AVStream *stream = g_format_context->streams[videoStream];
+    if (g_keyframe_index.BuildFromStream(stream)) {
+        return;
+    }
+    // 上次扫描留下的 sidecar 还有效就直接 mmap，省掉整文件扫描
+    if (!g_keyframe_index.LoadSidecar(url, videoStream)) {
+        g_keyframe_index.StartBackgroundScan(url, videoStream);
+        return;
+    }
+    // 容器里没有时长（裸流之类）时用 sidecar 里扫出来的
+    auto duration = g_keyframe_index.durationMs();
+    if (stream->duration == AV_NOPTS_VALUE && duration) {
+        g_total_video_ms = *duration;
+    }
+}
+
+std::unique_ptr<PreparedItem> prepareItem(const std::string &url) {
+    auto item = std::make_unique<PreparedItem>();
+    item->url = url;
+    // 打开加上预读第一个 GOP 算一次操作
+    IoInterrupt::Deadline deadline(g_preload_io, kOpenTimeout);
+    AVIOInterruptCB interrupt{};
+    g_preload_io.Fill(interrupt);
+    try {
+        FFmpeg::openFile(item->format_context, url, item->audio_stream,
+                         item->video_stream, FFmpeg::OpenMode::Normal,
+                         nullptr, &interrupt);
+        FFmpeg::openCodec(item->video_codec, item->video_stream,
+                          item->format_context);
+        FFmpeg::openCodec(item->audio_codec, item->audio_stream,
+                          item->format_context);
+    } catch (const std::exception &e) {
+        spdlog::error("prepare {} failed: {}", url, e.what());
+        return nullptr;
+    }
+    AVStream *stream = item->format_context->streams[item->video_stream];
+    item->total = std::chrono::milliseconds(static_cast<int64_t>(
+        stream->duration * av_q2d(stream->time_base) * 1000));
+
+    // 预读第一个 GOP：读到下一个视频关键帧为止
+    int keyframes = 0;
+    while (static_cast<int>(item->first_gop.size()) < kMaxPrerollPackets) {
+        AVPacket *packet{};
+        if (FFmpeg::readPaket(item->format_context, packet)) {
+            av_packet_free(&packet);
+            break;
+        }
+        if (packet->stream_index != item->video_stream &&
+            packet->stream_index != item->audio_stream) {
+            av_packet_free(&packet);
+            continue;
+        }
+        item->first_gop.push_back(packet);
+        if (packet->stream_index == item->video_stream &&
+            (packet->flags & AV_PKT_FLAG_KEY) && ++keyframes == 2) {
+            break;
+        }
+    }
+    spdlog::info("prepared {} with {} packets", url, item->first_gop.size());
+    return item;
+}
+
+std::unique_ptr<PreparedItem> takeNextItem() {
+    std::future<std::unique_ptr<PreparedItem>> next;
+    std::string url;
+    {
+        std::lock_guard<std::mutex> lock(g_playlist_mtx);
+        if (g_next_item.valid()) {
+            next = std::move(g_next_item);
+        } else if (!g_playlist.empty()) {
+            url = g_playlist.front();
+            g_playlist.pop_front();
+        } else {
+            return nullptr;
+        }
+    }
+    // 预加载还没开始就在读线程上同步打开，解码线程仍在消耗缓冲
+    return next.valid() ? next.get() : prepareItem(url);
+}
+
+void installItem(PreparedItem &item, PlayerController *controller) {
+    using namespace std::chrono;
+    avcodec_free_context(&videoCodecContext);
+    avcodec_free_context(&audioCodecContext);
+    if (g_format_context) {
+        AvioSource::CloseInput(g_format_context);
+    }
+    g_format_context = std::exchange(item.format_context, nullptr);
+    g_io.Install(g_format_context);
+    // 两个队列都已经消费完，新节目的 pts 重新开始
+    g_metrics.videoQueue.Clear();
+    g_metrics.audioQueue.Clear();
+    videoCodecContext = std::exchange(item.video_codec, nullptr);
+    audioCodecContext = std::exchange(item.audio_codec, nullptr);
+    videoStream = item.video_stream;
+    audioStream = item.audio_stream;
+    g_audio_pts_base = g_format_context->streams[audioStream]->time_base;
+    {
+        std::lock_guard<std::mutex> lock(g_duration_mtx);
+        g_media_generation++;
+        g_total_video_ms = item.total.count();
+    }
+    updateStreamInfo();
+    buildKeyframeIndex(item.url);
+
+    // 新节目接在上一个节目结束点后面，如果已经晚了就从现在开始
+    milliseconds now = duration_cast<milliseconds>(
+        (system_clock::now() - g_pause_time.load()).time_since_epoch());
+    g_start_time = std::max(g_start_time + milliseconds(g_item_end_ms), now);
+    g_item_end_ms = 0;
+    g_video_discard_until_ms = -1;
+    g_audio_discard_until_ms = -1;
+
+    QMetaObject::invokeMethod(controller, "MediaChanged",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, QString::fromStdString(item.url)));
+}
+
+bool switchToNextItem(std::stop_token const &token,
+                      PlayerController *controller,
+                      std::deque<AVPacket *> &pending) {
+    auto next = takeNextItem();
+    if (!next) {
+        return false;
+    }
+    g_switch_acks = 0;
+    g_switching = true;
+    while (!token.stop_requested() && g_switch_acks != kAllSwitchAcks) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (token.stop_requested()) {
+        g_switching = false;
+        return false;
+    }
+    installItem(*next, controller);
+    pending = std::move(next->first_gop);
+    g_switching = false;
+    spdlog::info("switched to {}", next->url);
+    return true;
+}
+
+// 新连接的流参数和正在用的解码器一致时解码器可以接着用
+bool sameParameters(AVCodecParameters const *par,
+                    AVCodecContext const *codec) {
+    if (par->codec_id != codec->codec_id ||
+        par->extradata_size != codec->extradata_size ||
+        (par->extradata_size > 0 &&
+         std::memcmp(par->extradata, codec->extradata,
+                     par->extradata_size) != 0)) {
+        return false;
+    }
+    if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+        return par->width == codec->width && par->height == codec->height &&
+               par->format == codec->pix_fmt;
+    }
+    return par->sample_rate == codec->sample_rate &&
+           par->format == codec->sample_fmt &&
+           par->channel_layout == codec->channel_layout;
+}
+
+// 在读线程上重开输入，退避重试到连上或者停止播放。连上以后和切换
+// 节目一样等解码线程把缓冲里的包播完再换 demuxer，断线期间缓冲里的
+// 画面和声音照常播放。流参数没变时解码器只清空，变了才重建，音频
+// 输出一直不动
+bool reconnectLive(std::stop_token const &token, const std::string &url) {
+    using namespace std::chrono;
+    {
+        std::lock_guard<std::mutex> lock(g_reconnect_mtx);
+        g_reconnect.reconnecting = true;
+    }
+    auto give_up = [] {
+        std::lock_guard<std::mutex> lock(g_reconnect_mtx);
+        g_reconnect.reconnecting = false;
+        return false;
+    };
+    spdlog::warn("live input {} dropped, reconnecting", url);
+    AVFormatContext *ctx = nullptr;
+    int audio = -1;
+    int video = -1;
+    milliseconds backoff = kReconnectMinBackoff;
+    while (!token.stop_requested() && !g_io.Stopped()) {
+        {
+            std::lock_guard<std::mutex> lock(g_reconnect_mtx);
+            g_reconnect.attempts++;
+        }
+        AVIOInterruptCB interrupt{};
+        g_io.Fill(interrupt);
+        try {
+            IoInterrupt::Deadline deadline(g_io, kOpenTimeout);
+            FFmpeg::openFile(ctx, url, audio, video, FFmpeg::OpenMode::Live,
+                             nullptr, &interrupt);
+            // 正在播的流新连接里都要有，多出来的那路不播
+            if ((audioStream < 0 || audio >= 0) &&
+                (videoStream < 0 || video >= 0)) {
+                audio = audioStream < 0 ? -1 : audio;
+                video = videoStream < 0 ? -1 : video;
+                break;
+            }
+            spdlog::warn("reconnected {} without the streams being played",
+                         url);
+        } catch (const std::exception &e) {
+            spdlog::warn("reconnect {} failed: {}, retry in {}ms", url,
+                         e.what(), backoff.count());
+        }
+        AvioSource::CloseInput(ctx);
+        auto retry = steady_clock::now() + backoff;
+        while (steady_clock::now() < retry && !token.stop_requested() &&
+               !g_io.Stopped()) {
+            std::this_thread::sleep_for(milliseconds(10));
+        }
+        backoff = std::min(backoff * 2, kReconnectMaxBackoff);
+    }
+    if (!ctx) {
+        return give_up();
+    }
+
+    // 暂停时解码线程停在暂停点，缓冲永远播不完。停着的线程不碰解码器，
+    // 拿着 g_mtx_pause 换输入，换完之前它们醒不过来
+    std::unique_lock<std::mutex> parked(g_mtx_pause, std::defer_lock);
+    g_switch_acks = 0;
+    g_switching = true;
+    while (!token.stop_requested() && g_switch_acks != kAllSwitchAcks) {
+        if (g_is_paused) {
+            parked.lock();
+            if ((g_switch_acks | g_parked) == kAllSwitchAcks) {
+                break;
+            }
+            parked.unlock();
+        }
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    if (token.stop_requested()) {
+        g_switching = false;
+        AvioSource::CloseInput(ctx);
+        return give_up();
+    }
+    if (parked.owns_lock()) {
+        // 断线前没播完的包，醒来以后已经不是直播最新处了
+        g_buffer_video.consume_all([](AVPacket *packet) {
+            av_packet_free(&packet);
+        });
+        g_buffer_audio.consume_all([](AVPacket *packet) {
+            av_packet_free(&packet);
+        });
+    }
+    bool same_video = video < 0 ||
+                      sameParameters(ctx->streams[video]->codecpar,
+                                     videoCodecContext);
+    bool same_audio = audio < 0 ||
+                      sameParameters(ctx->streams[audio]->codecpar,
+                                     audioCodecContext);
+    AvioSource::CloseInput(g_format_context);
+    g_format_context = ctx;
+    g_media_generation++;
+    g_metrics.videoQueue.Clear();
+    g_metrics.audioQueue.Clear();
+    videoStream = video;
+    audioStream = audio;
+    if (audio >= 0) {
+        g_audio_pts_base = ctx->streams[audio]->time_base;
+    }
+    try {
+        // 只有一路的直播，另一路没有解码器
+        if (video >= 0 && same_video) {
+            avcodec_flush_buffers(videoCodecContext);
+        } else if (video >= 0) {
+            avcodec_free_context(&videoCodecContext);
+            FFmpeg::openCodec(videoCodecContext, video, ctx, true);
+        }
+        if (audio >= 0 && same_audio) {
+            avcodec_flush_buffers(audioCodecContext);
+        } else if (audio >= 0) {
+            avcodec_free_context(&audioCodecContext);
+            FFmpeg::openCodec(audioCodecContext, audio, ctx, true);
+        }
+    } catch (const std::exception &e) {
+        spdlog::error("reopen decoder for {} failed: {}", url, e.what());
+        g_switching = false;
+        return give_up();
+    }
+    updateStreamInfo();
+    if (!same_video || !same_audio) {
+        spdlog::info("{} stream parameters changed, decoders rebuilt", url);
+        std::lock_guard<std::mutex> lock(g_reconnect_mtx);
+        g_reconnect.decoderResets++;
+    }
+    // 按新连接的第一个包重新对齐时钟，到达时间的基准也重新估计
+    g_live_aligned = false;
+    g_live_latency.Rebase();
+    g_switching = false;
+    return true;
+}
+
+void finishReconnect(std::chrono::steady_clock::time_point lost) {
+    double downtime = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - lost).count();
+    std::lock_guard<std::mutex> lock(g_reconnect_mtx);
+    g_reconnect.reconnects++;
+    g_reconnect.downtimeMs += downtime;
+    g_reconnect.lastDowntimeMs = downtime;
+    g_reconnect.reconnecting = false;
+    spdlog::info("live input back after {:.0f}ms", downtime);
+}
+
+void startPreload(std::stop_token token, PlayerController *controller) {
+    while (!token.stop_requested()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        auto [curr, total] = controller->CurrentPosition();
+        if (total - curr > kPreloadAhead.count()) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(g_playlist_mtx);
+        if (g_next_item.valid() || g_playlist.empty()) {
+            continue;
+        }
+        g_next_item = std::async(std::launch::async, prepareItem,
+                                 g_playlist.front());
+        g_playlist.pop_front();
+    }
+}
 #ifdef  use_old_seek
 void doSeek(int64_t seek_pos_ms, int64_t curr_playing_ms) {
     int64_t base_position =
@@ -48,24 +884,21 @@ void doSeek(int64_t seek_pos_ms, int64_t curr_playing_ms) {
 #else
 void doSeek(int64_t seek_pos_ms, int64_t curr_playing_ms,
             bool precise_seek = false) {
-    // 1. 获取音频流的时间基（正确计算 PTS）
-    AVStream *audio_stream = g_format_context->streams[audioStream];
+    // 0. 有关键帧索引时直接定位到目标之前最近的视频关键帧
+    if (seekToKeyframe(g_format_context, videoStream, g_keyframe_index,
+                       seek_pos_ms)) {
+        return;
+    }
+    // 1. 获取音频流的时间基（正确计算 PTS），只有视频的直播用视频流
+    int seek_stream = audioStream >= 0 ? audioStream : videoStream;
+    AVStream *audio_stream = g_format_context->streams[seek_stream];
     double time_base = av_q2d(audio_stream->time_base) * 1000; // 转毫秒
     int64_t target_pts = seek_pos_ms / time_base;
 
-    // 2. 动态选择 seek_flag
-#if 0
-    int seek_flags = AVSEEK_FLAG_BACKWARD; // 默认向后搜索关键帧
-    if (precise_seek) {
-        seek_flags = AVSEEK_FLAG_ANY; // 精确到任意帧（可能无法解码）
-    } else if (seek_pos_ms > curr_playing_ms) {
-        seek_flags |= AVSEEK_FLAG_FRAME; // 向前搜索时允许帧跳转
-    }
-#else
-    int seek_flags = AVSEEK_FLAG_FRAME;
-#endif
+    // 2. 精确 seek 要落在目标之前的关键帧，再由解码线程丢帧追到目标
+    int seek_flags = precise_seek ? AVSEEK_FLAG_BACKWARD : AVSEEK_FLAG_FRAME;
     // 3. 执行跳转
-    if (av_seek_frame(g_format_context, audioStream, target_pts, seek_flags) <
+    if (av_seek_frame(g_format_context, seek_stream, target_pts, seek_flags) <
         0) {
         throw std::runtime_error("Seek failed");
     }
@@ -75,15 +908,54 @@ void doSeek(int64_t seek_pos_ms, int64_t curr_playing_ms,
 }
 #endif
 void startReadPacket(std::stop_token token, PlayerController *controller) {
+    Tracer::SetThreadName("read");
     AVPacket *packet{};
+    std::deque<AVPacket *> pending;
+    // 读到的第几个包，追踪里用
+    int64_t seq = 0;
+    // 重连后等第一个视频关键帧，对齐时钟并结束停顿计时
+    bool reconnected = false;
+    std::chrono::steady_clock::time_point lost;
+    auto reconnect = [&] {
+        lost = std::chrono::steady_clock::now();
+        reconnected = reconnectLive(token, controller->url());
+        return reconnected;
+    };
     while (!token.stop_requested()) {
-        if (auto err = FFmpeg::readPaket(g_format_context, packet)) {
+        if (!pending.empty()) {
+            packet = pending.front();
+            pending.pop_front();
+        } else if (auto err = readPacket(packet, seq)) {
             if (err.errorCode == AVERROR_EOF) {
+                av_packet_free(&packet);
+                // 直播断开以后解码器要接着用，不 drain
+                if (!g_live) {
+                    queueDrainPackets(token);
+                }
+                if (switchToNextItem(token, controller, pending)) {
+                    continue;
+                }
+                // 直播的 EOF 是服务器断开了
+                if (g_live && !g_io.Stopped() && reconnect()) {
+                    continue;
+                }
                 spdlog::warn("EOF detected, restarting...");
                 // controller->Close(true);
                 return;
             }
-            spdlog::error("readPaket error");
+            if (g_io.TimedOut()) {
+                spdlog::warn("no data for {}ms", kReadTimeout.count());
+            }
+            if (g_live && !g_io.Stopped() && !token.stop_requested() &&
+                err.errorCode != AVERROR(EAGAIN)) {
+                av_packet_free(&packet);
+                if (reconnect()) {
+                    continue;
+                }
+                return;
+            }
+            PLAYER_ERROR_EVERY(1000, "readPaket error: {}",
+                               FFmpeg::errorString(err.errorCode));
             std::this_thread::sleep_for(std::chrono::microseconds(1));
             continue;
         }
@@ -93,13 +965,64 @@ void startReadPacket(std::stop_token token, PlayerController *controller) {
         }
         if (packet->stream_index !=
             audioStream && packet->stream_index != videoStream) {
-            spdlog::info("skip packet");
+            PLAYER_LOG_TRACE("skip packet");
             continue;
         }
         bool isVideo = packet->stream_index == videoStream;
         bool isAudio = packet->stream_index == audioStream;
-        spdlog::info("push packet");
+        // 没有视频的直播由音频包开始计时、估计抖动
+        bool leading = isVideo || videoStream < 0;
+        if (reconnected) {
+            // 解码器清空了，关键帧之前的包解不出完整画面
+            if (!leading || !(packet->flags & AV_PKT_FLAG_KEY)) {
+                av_packet_free(&packet);
+                continue;
+            }
+            reconnected = false;
+            finishReconnect(lost);
+        }
+        if (leading) {
+            markStartup(1);
+        }
+        if (g_live && packet->pts != AV_NOPTS_VALUE) {
+            AVStream *stream = g_format_context->streams[packet->
+                stream_index];
+            int64_t pts_ms = av_rescale_q(packet->pts, stream->time_base,
+                                          {1, 1000});
+            // 直播的 pts 不从 0 开始，Ready 时钟停在 0，减掉之后
+            // 点播放时从第一个包开始走。重连后从当前时钟直接接到新连接
+            // 的第一个包，也就是直播最新处
+            if (!g_live_aligned.exchange(true)) {
+                int64_t from =
+                    lost == std::chrono::steady_clock::time_point{}
+                        ? 0
+                        : clockMs();
+                shiftClock(-std::chrono::milliseconds(pts_ms - from));
+            }
+            // 到达抖动只看视频，音频和视频交织的先后会被当成抖动
+            if (leading) {
+                int64_t dts_ms = packet->dts != AV_NOPTS_VALUE
+                                     ? av_rescale_q(packet->dts,
+                                                    stream->time_base,
+                                                    {1, 1000})
+                                     : pts_ms;
+                g_live_latency.OnPacket(pts_ms, dts_ms,
+                                        senderClockUs(packet, pts_ms),
+                                        LiveLatency::NowUs());
+            }
+        }
+        if (packet->pts != AV_NOPTS_VALUE) {
+            AVStream *stream = g_format_context->streams[packet->
+                stream_index];
+            g_item_end_ms = std::max(g_item_end_ms, av_rescale_q(
+                                         packet->pts + packet->duration,
+                                         stream->time_base, {1, 1000}));
+        }
+        PLAYER_LOG_TRACE("push packet");
 
+        // 队列满的时候在这里等
+        Tracer::Span push_span(isVideo ? "push video" : "push audio",
+                               packetMs(packet), seq++);
         while (true) {
             if (token.stop_requested()) {
                 spdlog::info("stop decode thread");
@@ -107,9 +1030,12 @@ void startReadPacket(std::stop_token token, PlayerController *controller) {
             }
             // spdlog::info("g_is_seeking:{}", g_is_seeking.load());
             if (g_is_seeking.load()) {
+                Tracer::Span seek_span("seek");
                 spdlog::info("trigger seeking");
                 g_buffer_video.consume_all([](auto) {});
                 g_buffer_audio.consume_all([](auto) {});
+                g_metrics.videoQueue.Clear();
+                g_metrics.audioQueue.Clear();
                 assert(g_buffer_video.empty());
                 assert(g_buffer_audio.empty());
                 using namespace std::chrono;
@@ -118,35 +1044,93 @@ void startReadPacket(std::stop_token token, PlayerController *controller) {
                     time_since_epoch()
                     ).count();
 
-                doSeek(g_seek_pos_ms, current_ms);
+                bool exact = g_exact_seek.load();
+                // 连续的 seek 只执行最新的目标，执行中来了新请求就放弃重来
+                int64_t target;
+                uint64_t generation;
+                do {
+                    generation = g_seek_generation;
+                    target = g_seek_pos_ms;
+                    g_active_seek_generation = generation;
+                    g_in_seek = true;
+                    try {
+                        IoInterrupt::Deadline deadline(g_io, kSeekTimeout);
+                        doSeek(target, current_ms, exact);
+                    } catch (const std::exception &e) {
+                        if (generation == g_seek_generation) {
+                            spdlog::error("seek to {} failed: {}", target,
+                                          e.what());
+                        }
+                    }
+                    g_in_seek = false;
+                    if (generation != g_seek_generation) {
+                        g_seeks_superseded++;
+                        spdlog::info("seek to {} superseded", target);
+                    }
+                } while (generation != g_seek_generation &&
+                         !token.stop_requested());
+                g_last_seek_coalesced = std::max(
+                    g_seek_requests.exchange(0) - 1, 0);
+                if (exact) {
+                    g_video_discard_until_ms = target;
+                    g_audio_discard_until_ms = target;
+                }
+                g_seek_measure = exact ? 2 : 1;
+
+                if (g_seek_keep_paused.exchange(false)) {
+                    // 时钟停在暂停点，把暂停点的位置挪到目标，Play 时从
+                    // 目标接着走。视频线程不等时钟显示目标帧，之后和音频
+                    // 一起停在暂停点
+                    milliseconds paused_at = duration_cast<milliseconds>(
+                        (g_last_pause_point - g_pause_time.load() -
+                         g_start_time).time_since_epoch());
+                    g_pause_time = g_pause_time.load() -
+                                   (milliseconds(target) - paused_at);
+                    g_prerolling = true;
+                    g_is_seeking = generation != g_seek_generation;
+                    g_cv_pause.notify_all();
+                    break;
+                }
 
                 auto now = std::chrono::system_clock::now();
                 auto delta = std::chrono::duration_cast<
                     std::chrono::milliseconds>(
                     now - g_last_pause_point);
-                spdlog::info("seekoffset :{}", g_seek_pos_ms - current_ms);
+                spdlog::info("seekoffset :{}", target - current_ms);
                 g_pause_time = -std::chrono::milliseconds(
-                                   g_seek_pos_ms - current_ms) + g_pause_time.
+                                   target - current_ms) + g_pause_time.
                                load();
                 std::chrono::milliseconds current = g_pause_time.load();
                 while (!g_pause_time.
                     compare_exchange_weak(current, current + delta)) {}
                 g_is_paused = false;
                 g_is_seeking = false;
+                // 清标志和新请求之间有竞争，新请求不能丢
+                if (generation != g_seek_generation) {
+                    g_is_seeking = true;
+                }
                 g_cv_pause.notify_all();
                 break;
             }
             if (isAudio) {
-                spdlog::warn("audio push");
+                PLAYER_LOG_TRACE("audio push");
             }
+            // 入队之后包就归解码线程了，先取出要记的值
+            int64_t pts_ms = packetMs(packet);
+            int size = packet->size;
             if (isVideo && !g_buffer_video.push(packet)) {
+                g_metrics.queueFull.Add();
                 std::this_thread::sleep_for(std::chrono::microseconds(3));
                 continue;
             } else if (isAudio && !g_buffer_audio.push(packet)) {
+                g_metrics.queueFull.Add();
                 std::this_thread::sleep_for(std::chrono::microseconds(3));
-                spdlog::info("audio buffer full");
+                PLAYER_LOG_EVERY(spdlog::level::info, 1000,
+                                 "audio buffer full");
                 continue;
             }
+            (isVideo ? g_metrics.videoQueue : g_metrics.audioQueue).
+                Push(size, pts_ms);
             break;
         }
     }
@@ -156,20 +1140,24 @@ void startVideoDecode(std::stop_token token, PlayerController *controller) {
     while (!token.stop_requested()) {
         AVPacket *packet{};
         if (g_is_seeking) {
-            spdlog::info("video decode is seeking");
+            PLAYER_LOG_TRACE("video decode is seeking");
             std::this_thread::sleep_for(std::chrono::microseconds(1));
             continue;
         }
         if (!g_buffer_video.pop(packet)) {
-            spdlog::info("video buffer empty");
+            PLAYER_LOG_EVERY(spdlog::level::info, 1000,
+                             "video buffer empty");
+            ackSwitch(0b01, g_buffer_video);
             std::this_thread::sleep_for(std::chrono::microseconds(1));
             continue;
         }
+        g_metrics.videoQueue.Pop(packet);
         std::vector<AVFrame *> frames;
         // spdlog::info("sendVideo frame");
-        if (FFmpeg::sendPacket2(videoCodecContext, packet, frames).
-            hasErr()) {
-            spdlog::error("sendPacket2 error");
+        if (auto err = FFmpeg::sendPacket2(videoCodecContext, packet,
+                                           frames)) {
+            PLAYER_ERROR_EVERY(1000, "video sendPacket2 error: {}",
+                               FFmpeg::errorString(err.errorCode));
             continue;
         }
         while (!token.stop_requested() && !frames.empty() && !g_is_seeking.
@@ -179,8 +1167,8 @@ void startVideoDecode(std::stop_token token, PlayerController *controller) {
 
             uint64_t pts = packet->pts;
 
-            spdlog::info("sendVideoPacket frame [{}] [{}]", frame->width,
-                         frame->height);
+            PLAYER_LOG_TRACE("sendVideoPacket frame [{}] [{}]", frame->width,
+                             frame->height);
             std::vector<uint8_t> y;
             std::vector<uint8_t> u;
             std::vector<uint8_t> v;
@@ -190,9 +1178,9 @@ void startVideoDecode(std::stop_token token, PlayerController *controller) {
             info.width = frame->width;
             info.height = frame->height;
             av_frame_free(&frame);
-            spdlog::info("decodeVideo VideoInfo frame [{}] [{}]",
-                         info.width,
-                         info.height);
+            PLAYER_LOG_TRACE("decodeVideo VideoInfo frame [{}] [{}]",
+                             info.width,
+                             info.height);
             info.y = y.data();
             info.u = u.data();
             info.v = v.data();
@@ -239,32 +1227,85 @@ void startVideoDecode(std::stop_token token, PlayerController *controller) {
 }
 
 void startVideoDecode2(std::stop_token token, PlayerController *controller) {
+    Tracer::SetThreadName("video");
+    int discarded = 0;
+    // 解码的第几个包、送出的第几帧，追踪里用
+    int64_t packet_seq = 0;
+    int64_t frame_seq = 0;
+    // 直播追赶的时钟调整不足 1ms 的部分
+    double live_carry = 0;
+    // 队列连续空着只算一次
+    bool starved = false;
     while (!token.stop_requested()) {
         AVPacket *packet{};
+        if (!videoCodecContext) {
+            // 只有音频的直播，切换时照样确认
+            ackSwitch(0b01, g_buffer_video);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
         if (g_is_seeking) {
-            spdlog::info("video decode is seeking");
+            PLAYER_LOG_TRACE("video decode is seeking");
             avcodec_flush_buffers(videoCodecContext);
+            videoCodecContext->skip_frame = AVDISCARD_DEFAULT;
+            discarded = 0;
             std::this_thread::sleep_for(std::chrono::microseconds(1));
             continue;
         }
         if (!g_buffer_video.pop(packet)) {
-            spdlog::info("video buffer empty");
+            PLAYER_LOG_EVERY(spdlog::level::info, 1000,
+                             "video buffer empty");
+            if (!starved && !g_is_paused && !g_switching) {
+                g_metrics.videoStarved.Add();
+            }
+            starved = true;
+            ackSwitch(0b01, g_buffer_video);
             std::this_thread::sleep_for(std::chrono::microseconds(1));
             continue;
         }
+        starved = false;
+        g_metrics.videoQueue.Pop(packet);
         std::vector<AVFrame *> frames;
+        AVRational time_base = g_format_context->streams[videoStream]->
+            time_base;
+        int64_t discard_until_ms = g_video_discard_until_ms;
+        if (discard_until_ms >= 0) {
+            // 目标之前的非参考帧不会被后面的帧引用，让解码器直接跳过
+            bool before_target = packet->pts != AV_NOPTS_VALUE &&
+                                 av_rescale_q(packet->pts, time_base,
+                                              {1, 1000}) < discard_until_ms;
+            videoCodecContext->skip_frame = before_target
+                                                ? AVDISCARD_NONREF
+                                                : AVDISCARD_DEFAULT;
+        }
         // spdlog::info("sendVideo frame");
-        if (FFmpeg::sendPacket2(videoCodecContext, packet, frames).
-            hasErr()) {
-            spdlog::error("sendPacket2 error");
-            continue;
+        auto decode_begin = std::chrono::steady_clock::now();
+        {
+            Tracer::Span span("decode", packetMs(packet), packet_seq++);
+            if (auto err = FFmpeg::sendPacket2(videoCodecContext, packet,
+                                               frames)) {
+                PLAYER_ERROR_EVERY(1000, "video sendPacket2 error: {}",
+                                   FFmpeg::errorString(err.errorCode));
+                continue;
+            }
+        }
+        g_metrics.videoDecodeMs.Record(msSince(decode_begin));
+        bool drain = isDrainPacket(packet);
+        if (drain) {
+            // 下面从后往前取，drain 一次出好几帧，要按顺序播
+            std::reverse(frames.begin(), frames.end());
         }
         while (!token.stop_requested() && !frames.empty() && !g_is_seeking.
                load()) {
             AVFrame *frame = frames.back();
             frames.pop_back();
 
-            uint64_t pts = packet->pts;
+            if (drain && frame->best_effort_timestamp == AV_NOPTS_VALUE) {
+                // 没有时间戳排不进时钟
+                av_frame_free(&frame);
+                continue;
+            }
+            uint64_t pts = drain ? frame->best_effort_timestamp : packet->pts;
 
             uint64_t currentPosMillis = av_q2d(
                                             g_format_context->streams[
@@ -277,24 +1318,100 @@ void startVideoDecode2(std::stop_token token, PlayerController *controller) {
             milliseconds deadline = g_start_time + milliseconds(
                                         currentPosMillis);
 
-            while (!g_is_seeking && (duration_cast<milliseconds>(
-                       (system_clock::now() - g_pause_time.load()).
-                       time_since_epoch()))
-                   <
-                   deadline && !token.stop_requested()) {
-                std::this_thread::sleep_for(10us); // 精细等待
+            if (discard_until_ms >= 0) {
+                int64_t frame_pts = frame->best_effort_timestamp !=
+                                    AV_NOPTS_VALUE
+                                        ? frame->best_effort_timestamp
+                                        : packet->pts;
+                if (av_rescale_q(frame_pts, time_base, {1, 1000}) <
+                    discard_until_ms) {
+                    discarded++;
+                    g_metrics.videoDiscarded.Add();
+                    Tracer::Instant("discard", av_rescale_q(
+                                        frame_pts, time_base, {1, 1000}));
+                    av_frame_free(&frame);
+                    continue;
+                }
+                // 丢帧解码花掉的时间从时钟里扣掉，目标帧按时显示
+                milliseconds late = duration_cast<milliseconds>(
+                                        (system_clock::now() - g_pause_time.
+                                         load()).time_since_epoch()) -
+                                    deadline;
+                // 暂停中 seek 的目标帧不按时钟显示，不用扣
+                if (late.count() > 0 && !g_is_paused) {
+                    milliseconds current = g_pause_time.load();
+                    while (!g_pause_time.compare_exchange_weak(
+                        current, current + late)) {}
+                }
+                videoCodecContext->skip_frame = AVDISCARD_DEFAULT;
+                g_video_discard_until_ms = -1;
+                discard_until_ms = -1;
+            }
+            markStartup(2);
+            bool poster = g_prerolling.exchange(false);
+            if (g_live && !poster && !g_is_paused &&
+                clockMs() - static_cast<int64_t>(currentPosMillis) >
+                kLiveDropLateMs) {
+                g_live_latency.OnDropped();
+                g_metrics.videoDropped.Add();
+                Tracer::Instant("drop",
+                                static_cast<int64_t>(currentPosMillis));
+                av_frame_free(&frame);
+                continue;
             }
-            QMetaObject::invokeMethod(controller, "VideoFrameReady",
-                                      Qt::QueuedConnection,
-                                      Q_ARG(VideoFrame2, frame));
             {
-                std::unique_lock<std::mutex> lock(g_mtx_pause);
-                while (g_is_paused && !token.stop_requested() && !
-                       g_is_seeking) {
-                    g_cv_pause.wait(lock);
+                Tracer::Span span("wait",
+                                  static_cast<int64_t>(currentPosMillis),
+                                  frame_seq);
+                while (!poster && !g_is_seeking &&
+                       (duration_cast<milliseconds>(
+                           (system_clock::now() - g_pause_time.load()).
+                           time_since_epoch()))
+                       <
+                       deadline && !token.stop_requested()) {
+                    std::this_thread::sleep_for(10us); // 精细等待
                 }
             }
-            if (g_is_seeking) {
+            int seek_mode = g_seek_measure.exchange(0);
+            if (seek_mode) {
+                recordSeekLatency(seek_mode == 2, discarded);
+                discarded = 0;
+            }
+            // 按帧自己的时间戳记，和导航器缓存里的帧对得上。packet->pts
+            // 在有 B 帧时不是这一帧的
+            g_last_video_pts = frame->best_effort_timestamp != AV_NOPTS_VALUE
+                                   ? frame->best_effort_timestamp
+                                   : static_cast<int64_t>(pts);
+            if (!g_is_paused) {
+                int64_t late_ms = clockMs() -
+                                  static_cast<int64_t>(currentPosMillis);
+                recordLateness(late_ms, poster || seek_mode);
+                if (!poster && !seek_mode) {
+                    g_metrics.lateMs.Record(
+                        static_cast<double>(std::max<int64_t>(late_ms, 0)));
+                }
+            }
+            g_metrics.videoFrames.Add();
+            if (g_live && !poster && !g_is_paused) {
+                int64_t pos_ms = static_cast<int64_t>(currentPosMillis);
+                live_carry += g_live_latency.OnFrame(
+                    pos_ms, LiveLatency::NowUs(), clockMs() - pos_ms);
+                if (auto whole = static_cast<int64_t>(live_carry)) {
+                    shiftClock(-milliseconds(whole));
+                    live_carry -= whole;
+                }
+            }
+            // 界面线程转换和绘制时按 pts 对上这一帧
+            frame->opaque = reinterpret_cast<void *>(
+                static_cast<intptr_t>(currentPosMillis));
+            Tracer::Instant("present", static_cast<int64_t>(currentPosMillis),
+                            frame_seq++);
+            QMetaObject::invokeMethod(controller, "VideoFrameReady",
+                                      Qt::QueuedConnection,
+                                      Q_ARG(VideoFrame2, frame));
+            markClick(1);
+            bool replaced = waitWhilePaused(token, 0b01);
+            if (g_is_seeking || replaced) {
                 spdlog::info("video break");
                 av_frame_free(&frame);
                 break;
@@ -304,34 +1421,66 @@ void startVideoDecode2(std::stop_token token, PlayerController *controller) {
                 break;
             }
         }
+        if (drain && discard_until_ms >= 0) {
+            // 目标在最后一帧之后，解到结尾也没有帧可显示。只清掉还是这次
+            // 目标的，期间来了新的 seek 不受影响，音频不用再等
+            g_video_discard_until_ms.compare_exchange_strong(discard_until_ms,
+                                                             -1);
+        }
         av_packet_free(&packet);
     }
 }
 
 void startAudioDecode(std::stop_token token, PlayerController *controller) {
+    Tracer::SetThreadName("audio");
+    int64_t packet_seq = 0;
     while (!token.stop_requested()) {
         AVPacket *packet{};
+        if (!audioCodecContext) {
+            // 只有视频的直播，画面按系统时钟走
+            ackSwitch(0b10, g_buffer_audio);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
         if (g_is_seeking) {
             avcodec_flush_buffers(audioCodecContext);
             std::this_thread::sleep_for(std::chrono::milliseconds(1));
             continue;
         }
         if (!g_buffer_audio.pop(packet)) {
+            ackSwitch(0b10, g_buffer_audio);
             std::this_thread::sleep_for(std::chrono::milliseconds(1));
             continue;
         }
+        g_metrics.audioQueue.Pop(packet);
         // spdlog::info("sendAudioPacket frame");
         std::vector<AVFrame *> frames;
-        if (FFmpeg::sendPacket2(audioCodecContext, packet, frames).
-            hasErr()) {
-            spdlog::error("sendPacket2 error");
-            continue;
+        auto decode_begin = std::chrono::steady_clock::now();
+        int64_t seq = packet_seq++;
+        {
+            Tracer::Span span("decode", packetMs(packet), seq);
+            if (auto err = FFmpeg::sendPacket2(audioCodecContext, packet,
+                                               frames)) {
+                PLAYER_ERROR_EVERY(1000, "audio sendPacket2 error: {}",
+                                   FFmpeg::errorString(err.errorCode));
+                continue;
+            }
+        }
+        g_metrics.audioDecodeMs.Record(msSince(decode_begin));
+        bool drain = isDrainPacket(packet);
+        if (drain) {
+            std::reverse(frames.begin(), frames.end());
         }
         while (!token.stop_requested() && !frames.empty()) {
             AVFrame *frame = frames.back();
             frames.pop_back();
 
-            uint64_t pts = packet->pts;
+            if (drain && frame->best_effort_timestamp == AV_NOPTS_VALUE) {
+                // 没有时间戳排不进时钟
+                av_frame_free(&frame);
+                continue;
+            }
+            uint64_t pts = drain ? frame->best_effort_timestamp : packet->pts;
 
             uint64_t currentPosMillis = av_q2d(
                                             g_format_context->streams[
@@ -344,6 +1493,21 @@ void startAudioDecode(std::stop_token token, PlayerController *controller) {
             milliseconds deadline = g_start_time + milliseconds(
                                         currentPosMillis);
 
+            if (int64_t until = g_audio_discard_until_ms; until >= 0) {
+                if (static_cast<int64_t>(currentPosMillis) < until) {
+                    av_frame_free(&frame);
+                    continue;
+                }
+                g_audio_discard_until_ms = -1;
+                // 等视频解到目标帧、时钟校正完再出声
+                auto give_up = steady_clock::now() + kExactSeekAudioWait;
+                while (g_video_discard_until_ms >= 0 && !g_is_seeking &&
+                       !g_switching && !token.stop_requested() &&
+                       steady_clock::now() < give_up) {
+                    std::this_thread::sleep_for(1ms);
+                }
+            }
+
             while (!g_is_seeking && (duration_cast<milliseconds>(
                        (system_clock::now() - g_pause_time.load()).
                        time_since_epoch()))
@@ -351,24 +1515,45 @@ void startAudioDecode(std::stop_token token, PlayerController *controller) {
                    deadline && !token.stop_requested()) {
                 std::this_thread::sleep_for(10us); // 精细等待
             }
-            {
-                std::unique_lock<std::mutex> lock(g_mtx_pause);
-                while (g_is_paused && !token.stop_requested() && !
-                       g_is_seeking) {
-                    g_cv_pause.wait(lock);
-                }
-            }
-            if (g_is_seeking) {
+            bool replaced = waitWhilePaused(token, 0b10);
+            if (g_is_seeking || replaced) {
                 spdlog::info("audio break");
                 break;
             }
-            if (FFmpeg::decodeAudio(g_swr, frame, audioCodecContext).
+            // 和视频一样，暂停期间时钟不走，不按晚到丢
+            if (g_live && !g_is_paused &&
+                clockMs() - static_cast<int64_t>(currentPosMillis) >
+                kLiveDropLateMs) {
+                g_metrics.audioDropped.Add();
+                av_frame_free(&frame);
+                continue;
+            }
+            if (g_swr) {
+                g_swr->SetMaxCorrection(
+                    g_live ? FFmpeg::SwrResample::kLiveMaxCorrection
+                           : FFmpeg::SwrResample::kMaxCorrection);
+                // 设备缓冲里的数据正好播放到当前帧之前
+                int64_t heard_ms = static_cast<int64_t>(currentPosMillis) -
+                                   g_swr->audioSink().bufferedMs();
+                int64_t master_ms = duration_cast<milliseconds>(
+                    (system_clock::now() - g_pause_time.load() -
+                     g_start_time).time_since_epoch()).count();
+                g_swr->UpdateDrift(static_cast<double>(heard_ms - master_ms));
+                g_metrics.driftMs.Set(g_swr->DriftMs());
+                g_metrics.correction.Set(g_swr->CorrectionPercent());
+            }
+            auto output_begin = std::chrono::steady_clock::now();
+            Tracer::Span span("output", static_cast<int64_t>(currentPosMillis),
+                              seq);
+            if (FFmpeg::decodeAudio(g_swr, frame, audioCodecContext,
+                                    g_audio_sink_factory, &g_pcm_processor).
                 hasErr()) {
-                spdlog::error("decodeAudio error");
+                PLAYER_ERROR_EVERY(1000, "decodeAudio error");
 
                 av_frame_free(&frame);
                 continue;
             }
+            g_metrics.audioOutputMs.Record(msSince(output_begin));
             av_frame_free(&frame);
         }
         av_packet_free(&packet);
@@ -379,11 +1564,41 @@ void startAudioDecode(std::stop_token token, PlayerController *controller) {
 PlayerController::PlayerController(PlayerWidget *rendererBridge) {
     qRegisterMetaType<VideoInfo>("VideoInfo");
     qRegisterMetaType<PlayerState>("PlayerState");
+    // PLAYER_AUDIO_SINK=null / wav:<path> 可以在没有声卡的机器上运行
+    if (const char *spec = std::getenv("PLAYER_AUDIO_SINK")) {
+        SetAudioSinkFactory([spec = std::string{spec}] {
+            return FFmpeg::makeAudioSink(spec);
+        });
+    }
+    if (const char *target = std::getenv("PLAYER_LIVE_LATENCY_MS")) {
+        SetLiveLatency(std::atoll(target));
+    }
+    // PLAYER_TRACE=<path> 记录管线活动，析构时写成 Chrome trace JSON
+    if (std::getenv("PLAYER_TRACE")) {
+        Tracer::SetThreadName("gui");
+        Tracer::Start();
+    }
+    // PLAYER_METRICS=<path> 定期把指标快照追加到文件里
+    if (const char *path = std::getenv("PLAYER_METRICS")) {
+        const char *interval = std::getenv("PLAYER_METRICS_MS");
+        Metrics::Get().StartDump(
+            path, std::chrono::milliseconds(
+                      interval ? std::max(std::atoll(interval), 100LL)
+                               : 1000));
+    }
     connect(
         this, qOverload<VideoFrame2>(&PlayerController::VideoFrameReady),
         rendererBridge,
         qOverload<VideoFrame2>(&PlayerWidget::onFrameChanged),
         Qt::DirectConnection);
+    connect(rendererBridge, &PlayerWidget::FramePainted, this, [] {
+        markStartup(3);
+        markClick(2);
+    });
+    connect(this, &PlayerController::MediaChanged, this,
+            [this](const QString &url) {
+                mUrl = url.toStdString();
+            });
     // connect(
     //     this, qOverload<VideoFrame>(&PlayerController::VideoFrameReady),
     //     rendererBridge,
@@ -392,6 +1607,15 @@ PlayerController::PlayerController(PlayerWidget *rendererBridge) {
 }
 
 PlayerController::~PlayerController() {
+    // 预览和逐帧线程会往 this 投递帧，先停掉
+    mScrubber.reset();
+    mNavigator.reset();
+    StopThreads();
+    if (const char *path = std::getenv("PLAYER_TRACE")) {
+        Tracer::Stop(path);
+    }
+    ClearPlaylist();
+    g_keyframe_index.Reset();
     if (g_swr) {
         delete g_swr;
         g_swr = nullptr;
@@ -405,14 +1629,35 @@ PlayerController::~PlayerController() {
         audioCodecContext = nullptr;
     }
     if (g_format_context) {
-        avformat_close_input(&g_format_context);
+        AvioSource::CloseInput(g_format_context);
         g_format_context = nullptr;
     }
 }
 
 void PlayerController::Open(const std::string &url) {
+    // 逐帧/倒放和预览还在解上一个文件，倒放会一直往这边投递旧文件的帧
+    mNavigator.reset();
+    mNavigating = false;
+    mScrubber.reset();
+    mScrubbing = false;
+    if (mReadTask.joinable()) {
+        // Ready 状态的预加载线程（或者还没停的播放线程）在用当前的
+        // demuxer 和解码器，先停掉，队列里旧节目的包也不能留给新节目
+        StopThreads();
+        g_buffer_video.consume_all([](AVPacket *packet) {
+            av_packet_free(&packet);
+        });
+        g_buffer_audio.consume_all([](AVPacket *packet) {
+            av_packet_free(&packet);
+        });
+        g_metrics.videoQueue.Clear();
+        g_metrics.audioQueue.Clear();
+        g_is_seeking = false;
+        g_switching = false;
+        mState = PlayerState::Idle;
+    }
     if (g_format_context) {
-        avformat_close_input(&g_format_context);
+        AvioSource::CloseInput(g_format_context);
         g_format_context = nullptr;
     }
     if (videoCodecContext) {
@@ -421,24 +1666,128 @@ void PlayerController::Open(const std::string &url) {
     }
     if (audioCodecContext) {
         avcodec_close(audioCodecContext);
+        // 只有视频的直播不会再开音频解码器，音频线程按空指针判断
+        audioCodecContext = nullptr;
     }
     if (mState == PlayerState::Idle) {
         mState = PlayerState::Ready;
         mUrl = url;
         spdlog::info("open url:{}", url);
-        FFmpeg::openFile(g_format_context, url, audioStream, videoStream);
-        FFmpeg::openCodec(videoCodecContext, videoStream, g_format_context);
-        FFmpeg::openCodec(audioCodecContext, audioStream, g_format_context);
-        spdlog::warn("coded_width: {}", videoCodecContext->coded_width);
+        bool fast_start = g_fast_start;
+        auto mode = FFmpeg::isLiveUrl(url)
+                        ? FFmpeg::OpenMode::Live
+                        : fast_start
+                        ? FFmpeg::OpenMode::FastStart
+                        : FFmpeg::OpenMode::Normal;
+        FFmpeg::OpenTiming timing;
+        g_io.Reset();
+        g_preload_io.Reset();
+        AVIOInterruptCB interrupt{};
+        g_io.Fill(interrupt);
+        {
+            IoInterrupt::Deadline deadline(g_io, kOpenTimeout);
+            FFmpeg::openFile(g_format_context, url, audioStream, videoStream,
+                             mode, &timing, &interrupt);
+        }
+        bool live = FFmpeg::isLiveInput(url, g_format_context);
+        g_live = live;
+        g_live_aligned = false;
+        g_live_latency.Reset();
+        if (live) {
+            spdlog::info("{} is live, latency target {}ms", url,
+                         g_live_latency.stats().targetMs);
+        }
+        // 只有音频或只有视频的直播（电台、监控摄像头）也能播；点播的
+        // seek、预览和逐帧都离不开两路流
+        if (videoStream < 0 && audioStream < 0) {
+            throw std::runtime_error("no audio or video stream");
+        }
+        if (!live && (videoStream < 0 || audioStream < 0)) {
+            throw std::runtime_error("need both audio and video streams");
+        }
+        auto codec_begin = std::chrono::steady_clock::now();
+        if (videoStream >= 0) {
+            FFmpeg::openCodec(videoCodecContext, videoStream,
+                              g_format_context, live);
+            spdlog::warn("coded_width: {}", videoCodecContext->coded_width);
+        }
+        if (audioStream >= 0) {
+            FFmpeg::openCodec(audioCodecContext, audioStream,
+                              g_format_context, live);
+        }
+        updateStreamInfo();
+        {
+            std::lock_guard<std::mutex> lock(g_startup_mtx);
+            g_startup = {};
+            g_startup.openMs = timing.openMs;
+            g_startup.probeMs = timing.probeMs;
+            g_startup.codecMs = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - codec_begin).count();
+            g_startup.fastStart = mode != FFmpeg::OpenMode::Normal;
+            g_startup.probeSkipped = timing.probeSkipped;
+            g_startup_stage = 0;
+        }
 
-        AVStream *stream = g_format_context->streams[videoStream];
+        AVStream *stream = g_format_context->streams[
+            videoStream >= 0 ? videoStream : audioStream];
         AVRational pts_base = stream->time_base;
-        int64_t video_ms = stream->duration * av_q2d(pts_base) * 1000;
-        g_total_video_time = std::chrono::milliseconds(video_ms);
+        // 跳过探测时流上可能没有时长，先用容器的，都没有就等后台探测
+        int64_t video_ms = stream->duration != AV_NOPTS_VALUE
+                               ? stream->duration * av_q2d(pts_base) * 1000
+                               : g_format_context->duration != AV_NOPTS_VALUE
+                               ? g_format_context->duration / 1000
+                               : 0;
+        g_total_video_ms = video_ms;
+        g_item_end_ms = 0;
+        g_video_discard_until_ms = -1;
+        g_audio_discard_until_ms = -1;
+        // 直播没有索引可建，后台扫描会再连一次服务器
+        if (live) {
+            g_keyframe_index.Reset();
+        } else {
+            buildKeyframeIndex(url);
+        }
         spdlog::info("file total len: {}.{}s", video_ms / 1000 / 60,
                      video_ms / 1000 % 60);
-        g_audio_pts_base = g_format_context->streams[audioStream]->time_base;
+        if (audioStream >= 0) {
+            g_audio_pts_base =
+                g_format_context->streams[audioStream]->time_base;
+        }
         emit StateChanged(mState);
+        StartPreroll();
+    }
+}
+
+void PlayerController::StartPreroll() {
+    using namespace std::chrono;
+    // 线程在 Ready 状态就跑起来，时钟停在 0：读线程填满包队列，
+    // 视频线程解出第一帧当封面显示，音频线程解出第一帧后停在暂停点。
+    // Play 只需要解除暂停
+    auto now = system_clock::now();
+    g_start_time = duration_cast<milliseconds>(now.time_since_epoch());
+    g_pause_time = milliseconds(0);
+    g_last_pause_point = now;
+    g_is_paused = true;
+    g_prerolling = true;
+    {
+        std::lock_guard<std::mutex> lock(g_stall_mtx);
+        g_stalls = {};
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_reconnect_mtx);
+        g_reconnect = {};
+    }
+    spdlog::info("start decode thread");
+    mReadTask = std::jthread(startReadPacket, this);
+    mVideoTask = std::jthread(startVideoDecode2, this);
+    mAudioTask = std::jthread(startAudioDecode, this);
+    mPreloadTask = std::jthread(startPreload, this);
+    std::lock_guard<std::mutex> lock(g_startup_mtx);
+    g_startup_mark = steady_clock::now();
+    g_startup_stage = 1;
+    if (g_startup.fastStart && !g_live) {
+        mProbeTask = std::jthread(deferredProbe, mUrl,
+                                  g_media_generation.load());
     }
 }
 
@@ -451,32 +1800,29 @@ void PlayerController::Play() {
         emit StateChanged(mState);
         return;
     }
+    if (mState == PlayerState::Paused && mNavigating) {
+        // 逐帧/倒放之后从当前显示的那一帧继续
+        mNavigating = false;
+        mNavigator->StopReverse();
+        mState = PlayerState::Playing;
+        SeekTo(mNavigator->positionMs());
+        return;
+    }
     if (mState == PlayerState::Paused) {
         mState = PlayerState::Playing;
-        spdlog::info("start decode thread");
-
-        auto now = std::chrono::system_clock::now();
-        auto delta = std::chrono::duration_cast<std::chrono::milliseconds>(
-            now - g_last_pause_point);
-
-        // 自旋 CAS（compare-exchange）实现原子加法
-        std::chrono::milliseconds current = g_pause_time.load();
-        while (!g_pause_time.compare_exchange_weak(current, current + delta)) {}
-        g_is_paused = false;
-        g_cv_pause.notify_all();
+        resumeClock();
         emit StateChanged(mState);
         return;
     }
     if (mState == PlayerState::Ready) {
+        // 线程和封面在 Open 时已经准备好，这里只是解除暂停
         mState = PlayerState::Playing;
-        spdlog::info("start decode thread");
-
-        g_start_time = std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::system_clock::now().time_since_epoch());
-        mReadTask = std::jthread(startReadPacket, this);
-        mVideoTask = std::jthread(startVideoDecode2, this);
-        // mAudioTask = std::jthread(startAudioDecode, this);
-
+        {
+            std::lock_guard<std::mutex> lock(g_startup_mtx);
+            g_click_time = std::chrono::steady_clock::now();
+            g_click_stage = 1;
+        }
+        resumeClock();
         emit StateChanged(mState);
     }
 }
@@ -496,10 +1842,15 @@ void PlayerController::SeekTo(int64_t seek_pos) {
         mState = PlayerState::Seeking;
         {
             g_last_pause_point = std::chrono::system_clock::now();
+            g_seek_request_time = std::chrono::steady_clock::now();
             g_is_paused = true;
-            g_is_seeking = true;
             spdlog::info("seek to {}", seek_pos);
+            // 先写目标再置标志，读线程看到标志时目标一定是新的
+            g_seek_keep_paused = false;
             g_seek_pos_ms = seek_pos;
+            g_seek_requests++;
+            g_seek_generation++;
+            g_is_seeking = true;
         }
         emit StateChanged(mState);
         mState = PlayerState::Playing;
@@ -509,11 +1860,254 @@ void PlayerController::SeekTo(int64_t seek_pos) {
 
     if (mState == PlayerState::Paused) {
         mState = PlayerState::Seeking;
+        g_seek_request_time = std::chrono::steady_clock::now();
+        spdlog::info("seek to {} while paused", seek_pos);
+        g_seek_keep_paused = true;
+        g_seek_pos_ms = seek_pos;
+        g_seek_requests++;
+        g_seek_generation++;
+        {
+            std::lock_guard<std::mutex> lock(g_mtx_pause);
+            g_is_seeking = true;
+        }
+        // 解码线程停在暂停点上，叫醒它们丢掉手上的帧
+        g_cv_pause.notify_all();
         emit StateChanged(mState);
         mState = PlayerState::Paused;
+        emit StateChanged(mState);
+    }
+}
+
+
+void PlayerController::Enqueue(const std::string &url) {
+    std::lock_guard<std::mutex> lock(g_playlist_mtx);
+    g_playlist.push_back(url);
+}
+
+void PlayerController::ClearPlaylist() {
+    std::future<std::unique_ptr<PreparedItem>> next;
+    {
+        std::lock_guard<std::mutex> lock(g_playlist_mtx);
+        g_playlist.clear();
+        next = std::move(g_next_item);
+    }
+    // 在锁外等待正在预加载的节目结束并释放
+    if (next.valid()) {
+        next.wait();
+    }
+}
+
+size_t PlayerController::PlaylistSize() const {
+    std::lock_guard<std::mutex> lock(g_playlist_mtx);
+    return g_playlist.size() + (g_next_item.valid() ? 1 : 0);
+}
+
+void PlayerController::SetAudioSinkFactory(AudioSinkFactory factory) {
+    g_audio_sink_factory = std::move(factory);
+}
+
+void PlayerController::SetVolume(float volume) {
+    g_pcm_processor.SetVolume(volume);
+}
+
+void PlayerController::SetMute(bool mute) {
+    g_pcm_processor.SetMute(mute);
+}
+
+PcmLevels PlayerController::AudioLevels() const {
+    return g_pcm_processor.Levels();
+}
+
+AVSyncStats PlayerController::SyncStats() const {
+    if (!g_swr) {
+        return {};
+    }
+    return {g_swr->DriftMs(), g_swr->CorrectionPercent()};
+}
+
+void PlayerController::SetFastStart(bool fast) {
+    g_fast_start = fast;
+}
+
+bool PlayerController::FastStart() const {
+    return g_fast_start;
+}
+
+StartupTiming PlayerController::StartupStats() const {
+    std::lock_guard<std::mutex> lock(g_startup_mtx);
+    return g_startup;
+}
+
+StallStats PlayerController::Stalls() const {
+    std::lock_guard<std::mutex> lock(g_stall_mtx);
+    return g_stalls;
+}
+
+void PlayerController::SetLiveLatency(int64_t target_ms) {
+    g_live_latency.SetTarget(target_ms);
+}
+
+bool PlayerController::IsLive() const {
+    return g_live;
+}
+
+LiveLatency::Stats PlayerController::LiveStats() const {
+    return g_live_latency.stats();
+}
+
+ReconnectStats PlayerController::Reconnects() const {
+    std::lock_guard<std::mutex> lock(g_reconnect_mtx);
+    return g_reconnect;
+}
+
+Metrics::Snapshot PlayerController::MetricsSnapshot() const {
+    return Metrics::Get().snapshot();
+}
+
+StreamInfo PlayerController::Stream() const {
+    std::lock_guard<std::mutex> lock(g_stream_mtx);
+    return g_stream_info;
+}
+
+void PlayerController::SeekBy(int64_t delta_ms) {
+    // 连按快进/快退时以还没执行完的目标为基准累加
+    int64_t base = g_is_seeking
+                       ? g_seek_pos_ms.load()
+                       : CurrentPosition().first;
+    int64_t target = std::max<int64_t>(base + delta_ms, 0);
+    // 直播和还没探测出时长的文件没有上限可卡
+    int64_t total = g_total_video_ms;
+    if (total > 0) {
+        target = std::min(target, total);
+    }
+    SeekTo(target);
+}
+
+void PlayerController::BeginScrub() {
+    if (mScrubbing || (mState != PlayerState::Playing &&
+                       mState != PlayerState::Paused)) {
+        return;
+    }
+    if (!mScrubber || mScrubber->url() != mUrl) {
+        mScrubber = std::make_unique<Scrubber>(
+            [this](AVFrame *frame, int64_t) {
+                QMetaObject::invokeMethod(this, "VideoFrameReady",
+                                          Qt::QueuedConnection,
+                                          Q_ARG(VideoFrame2, frame));
+            });
+        if (!mScrubber->Open(mUrl, &g_keyframe_index)) {
+            mScrubber.reset();
+            return;
+        }
+    }
+    if (mNavigating) {
+        mNavigating = false;
+        mNavigator->StopReverse();
+    }
+    // 暂停正常播放，画面交给预览
+    mScrubResume = mState == PlayerState::Playing;
+    if (mScrubResume) {
+        Play();
+    }
+    mScrubbing = true;
+}
+
+void PlayerController::ScrubTo(int64_t pos) {
+    if (mScrubbing) {
+        mScrubber->Request(pos);
+    }
+}
+
+void PlayerController::EndScrub(int64_t pos) {
+    if (mScrubbing) {
+        mScrubbing = false;
+        mScrubber->Cancel();
+        // seek 会按目标位置重新校准时钟，不需要先恢复暂停
+        if (mScrubResume) {
+            mState = PlayerState::Playing;
+        }
     }
+    SeekTo(pos);
 }
 
+bool PlayerController::PrepareNavigator() {
+    if (mState == PlayerState::Playing) {
+        Play();
+    }
+    if (mState != PlayerState::Paused) {
+        return false;
+    }
+    if (!mNavigator || mNavigator->url() != mUrl) {
+        mNavigator = std::make_unique<FrameNavigator>(
+            [this](AVFrame *frame, int64_t) {
+                QMetaObject::invokeMethod(this, "VideoFrameReady",
+                                          Qt::QueuedConnection,
+                                          Q_ARG(VideoFrame2, frame));
+            });
+        if (!mNavigator->Open(mUrl, &g_keyframe_index)) {
+            mNavigator.reset();
+            return false;
+        }
+        mNavigating = false;
+    }
+    if (!mNavigating) {
+        mNavigator->SetPosition(g_last_video_pts);
+        mNavigating = true;
+    }
+    return true;
+}
+
+void PlayerController::StepFrame(int direction) {
+    if (PrepareNavigator()) {
+        mNavigator->Step(direction);
+    }
+}
+
+void PlayerController::SetReverse(bool reverse) {
+    if (!reverse) {
+        if (mNavigator) {
+            mNavigator->StopReverse();
+        }
+        return;
+    }
+    if (PrepareNavigator()) {
+        mNavigator->StartReverse();
+    }
+}
+
+void PlayerController::SetExactSeek(bool exact) {
+    g_exact_seek = exact;
+}
+
+bool PlayerController::ExactSeek() const {
+    return g_exact_seek;
+}
+
+SeekStats PlayerController::SeekLatencyStats() const {
+    std::lock_guard<std::mutex> lock(g_seek_stats_mtx);
+    return g_seek_stats;
+}
+
+void PlayerController::StopThreads() {
+    // 读线程可能正卡在网络 I/O 里，先让它返回
+    g_io.Stop();
+    g_preload_io.Stop();
+    mReadTask.request_stop();
+    mVideoTask.request_stop();
+    mAudioTask.request_stop();
+    mPreloadTask.request_stop();
+    mProbeTask.request_stop();
+    {
+        std::lock_guard<std::mutex> lock(g_mtx_pause);
+    }
+    g_cv_pause.notify_all();
+    // jthread 移动赋值会先 join 旧线程
+    mReadTask = {};
+    mVideoTask = {};
+    mAudioTask = {};
+    mPreloadTask = {};
+    mProbeTask = {};
+}
 
 std::pair<int64_t, int64_t> PlayerController::CurrentPosition() const {
     using namespace std::chrono;
@@ -523,6 +2117,6 @@ std::pair<int64_t, int64_t> PlayerController::CurrentPosition() const {
         time_since_epoch()
         ).count();
 
-    int64_t total_ms = g_total_video_time.count();
+    int64_t total_ms = g_total_video_ms;
     return {current_ms, total_ms};
 }
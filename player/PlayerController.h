@@ -3,6 +3,10 @@
 #include <memory>
 #include <qobjectdefs.h>
 #include "Demuxer.h"
+#include "AudioSink.h"
+#include "PcmProcessor.h"
+#include "LiveLatency.h"
+#include "Metrics.h"
 #include <qobject.h>
 #include <future>
 #include <thread>
@@ -23,12 +27,90 @@ enum class PlayerState {
     Error,
 };
 
+// 音视频同步状态，drift 为音频时钟减主时钟
+struct AVSyncStats {
+    double driftMs{};
+    double correctionPercent{};
+};
+
+// seek 请求到第一帧画面送出的耗时
+struct SeekLatency {
+    double lastMs{};
+    double avgMs{};
+    int count{};
+};
+
+struct SeekStats {
+    SeekLatency keyframe;
+    SeekLatency exact;
+    // 最近一次精确 seek 丢掉的帧数
+    int discardedFrames{};
+    // 最近一次 seek 合并掉的请求数
+    int coalesced{};
+    // 执行中被更新的请求打断的 seek 总数
+    uint64_t superseded{};
+};
+
+// 播放卡顿：帧送出时比该显示的时刻晚了 20ms 以上算卡住，比上一帧多晚
+// 的部分计入卡顿时长。seek 和直播追赶拨时钟的那一帧不算
+struct StallStats {
+    uint64_t underruns{}; // 连续晚的帧算一次
+    double rebufferMs{};
+    uint64_t lateFrames{};
+    double maxLateMs{};
+};
+
+// 直播断线重连。停顿时间从读失败算到新连接的第一个关键帧
+struct ReconnectStats {
+    uint64_t reconnects{};
+    uint64_t attempts{}; // 包括失败的
+    // 新连接的流参数变了，重建了解码器
+    uint64_t decoderResets{};
+    double downtimeMs{};
+    double lastDowntimeMs{};
+    bool reconnecting{};
+};
+
+// 当前节目的流参数，换节目和重连后更新
+struct StreamInfo {
+    std::string videoCodec; // 解码器名
+    std::string audioCodec;
+    int width{};
+    int height{};
+    std::string pixelFormat;
+    double fps{}; // 容器给出的平均帧率，不知道时为 0
+    int sampleRate{};
+    int channels{};
+    // 包队列的容量，和队列深度的指标一起看
+    int videoQueueCapacity{};
+    int audioQueueCapacity{};
+};
+
+// 打开到第一帧上屏的各阶段耗时，每项是相对上一阶段的增量。
+// 首包/首帧/上屏是 Ready 状态下预加载封面的耗时
+struct StartupTiming {
+    double openMs{};
+    double probeMs{};
+    double codecMs{};
+    double firstPacketMs{};
+    double firstFrameMs{};
+    double firstPaintMs{};
+    double totalMs{};
+    // 点播放到下一帧上屏，封面已经预加载好时只剩一个帧间隔
+    double clickToFrameMs{};
+    bool fastStart{};
+    bool probeSkipped{};
+    bool complete{};
+};
+
 Q_DECLARE_METATYPE(VideoFrame);
 
 Q_DECLARE_METATYPE(VideoFrame2);
 
 class PlayerWidget;
 class RendererBridge;
+class Scrubber;
+class FrameNavigator;
 
 class PlayerController : public QObject {
     Q_OBJECT
@@ -36,17 +118,64 @@ class PlayerController : public QObject {
 public:
     PlayerController(PlayerWidget *rendererBridge);
     ~PlayerController() override;
-    void Open(const std::string &url); // 支持本地/网络
+    // 支持本地/网络。打开后在 Ready 状态预加载并显示第一帧
+    void Open(const std::string &url);
     void Play();
     void Close();
     void SeekTo(int64_t seek_pos);
+    // 相对当前位置跳转，连续调用会合并成一次 seek
+    void SeekBy(int64_t delta_ms);
+    // 精确 seek：从关键帧解码到目标帧再显示，否则停在目标前的关键帧
+    void SetExactSeek(bool exact);
+    bool ExactSeek() const;
+    SeekStats SeekLatencyStats() const;
+    // 快速起播：限制探测量，容器头完整时跳过 find_stream_info，
+    // 完整的流信息在第一帧之后后台补齐。下一次 Open 生效
+    void SetFastStart(bool fast);
+    bool FastStart() const;
+    StartupTiming StartupStats() const;
+    // 从 Open 开始累计
+    StallStats Stalls() const;
+    // 直播：推流协议和没有时长又不能 seek 的流自动进入。播放延迟按
+    // 网络抖动自适应，上限是端到端延迟目标；超出时时钟小幅加速追赶，
+    // 超出太多直接跳到目标并丢掉落后的帧。
+    // 目标默认 1s，也可以用 PLAYER_LIVE_LATENCY_MS 设置
+    void SetLiveLatency(int64_t target_ms);
+    bool IsLive() const;
+    LiveLatency::Stats LiveStats() const;
+    // 直播断线时自动重连，退避重试直到连上或者停止播放。只重开输入，
+    // 解码器、音频输出和画面都保留，从直播最新处接着播
+    ReconnectStats Reconnects() const;
+    // 管线各阶段的计数、队列深度和耗时分布，从进程启动开始累计。
+    // 设置 PLAYER_METRICS=<path> 时另外定期写成 JSON
+    Metrics::Snapshot MetricsSnapshot() const;
+    StreamInfo Stream() const;
+    // 拖动进度条时只解关键帧做预览，松开后 seek 到最终位置
+    void BeginScrub();
+    void ScrubTo(int64_t pos);
+    void EndScrub(int64_t pos);
+    // 暂停后逐帧前进/后退、倒放，再次播放时从停下的那一帧继续
+    void StepFrame(int direction);
+    void SetReverse(bool reverse);
+    // 播放列表：当前节目结束后无缝切到下一项
+    void Enqueue(const std::string &url);
+    void ClearPlaylist();
+    size_t PlaylistSize() const;
     std::pair<int64_t, int64_t> CurrentPosition() const;
+    AVSyncStats SyncStats() const;
+    // 需要在第一帧音频解码前设置
+    void SetAudioSinkFactory(AudioSinkFactory factory);
+    // 音量 0~2，在输出 PCM 上做渐变，不经过 QAudioOutput::setVolume
+    void SetVolume(float volume);
+    void SetMute(bool mute);
+    PcmLevels AudioLevels() const;
 Q_SIGNALS:
     void VideoFrameReady(VideoFrame2 frame);
     void VideoFrameReady(VideoFrame frame);
     void AudioFrameReady(AudioFrame frame);
     void ErrorOccurred(std::string msg);
     void StateChanged(PlayerState state);
+    void MediaChanged(const QString &url);
 
 public:
     PlayerState state() const {
@@ -58,9 +187,20 @@ public:
     }
 
 private:
+    void StopThreads();
+    void StartPreroll();
+    bool PrepareNavigator();
+
     PlayerState mState{PlayerState::Idle};
     std::string mUrl{};
     std::jthread mReadTask{};
     std::jthread mVideoTask{};
     std::jthread mAudioTask{};
+    std::jthread mPreloadTask{};
+    std::jthread mProbeTask{};
+    std::unique_ptr<Scrubber> mScrubber;
+    bool mScrubbing{};
+    bool mScrubResume{};
+    std::unique_ptr<FrameNavigator> mNavigator;
+    bool mNavigating{};
 };
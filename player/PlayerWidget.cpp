@@ -1,8 +1,11 @@
 #include "PlayerWidget.h"
 #include <spdlog/spdlog.h>
 #include "PlayerController.h"
+#include "Metrics.h"
+#include "Tracer.h"
 #include <QPainter>
-#include <spdlog/spdlog.h>
+#include <QTimer>
+#include <utility>
 #include "libyuv.h"
 
 extern "C" {
@@ -15,7 +18,45 @@ PlayerWidget::PlayerWidget(QWidget *parent):
 #else
     QWidget(parent)
 #endif
-{}
+{
+    mStatsTimer = new QTimer(this);
+    mStatsTimer->setInterval(StatsOverlay::kRefresh);
+    connect(mStatsTimer, &QTimer::timeout, this, [this] {
+        refreshStats();
+    });
+}
+
+void PlayerWidget::SetStatsProvider(
+    std::function<StatsOverlay::Sample()> provider) {
+    mStatsProvider = std::move(provider);
+}
+
+void PlayerWidget::SetStatsVisible(bool visible) {
+    if (visible == StatsVisible()) {
+        return;
+    }
+    if (visible) {
+        mStats = std::make_unique<StatsOverlay>();
+        refreshStats();
+        mStatsTimer->start();
+    } else {
+        mStatsTimer->stop();
+        mStats.reset();
+        update();
+    }
+}
+
+bool PlayerWidget::StatsVisible() const {
+    return mStats != nullptr;
+}
+
+void PlayerWidget::refreshStats() {
+    if (!mStats || !mStatsProvider) {
+        return;
+    }
+    mStats->Update(mStatsProvider());
+    update();
+}
 
 namespace {
 uint8_t *yuvData = nullptr;
@@ -51,6 +92,17 @@ scaleKeepAspectRatio(const QRect &outer, int inner_w, int inner_h) {
 }
 
 namespace {
+// YUV 转 RGB 和绘制一帧的耗时
+Metrics::Histogram &g_convert_ms = Metrics::Get().histogram(
+    "video.convert_ms");
+Metrics::Histogram &g_paint_ms = Metrics::Get().histogram("video.paint_ms");
+Metrics::Counter &g_painted = Metrics::Get().counter("video.painted");
+// 当前画面的 pts 毫秒，视频线程放在 frame->opaque 里，追踪里用
+int64_t g_pts_ms = -1;
+int64_t g_frame_seq = 0;
+// 有新帧还没画。浮层刷新也会触发重绘，那种重绘不算绘制耗时和帧数
+bool g_fresh_frame = false;
+
 std::vector<uint8_t> g_rgbaData;
 int g_width = 0;
 int g_height = 0;
@@ -73,6 +125,9 @@ void PlayerWidget::onFrameChanged(VideoFrame2 frame) {
     g_width = frame->width;
     g_height = frame->height;
 
+    g_pts_ms = reinterpret_cast<intptr_t>(frame->opaque);
+    Tracer::Span span("convert", g_pts_ms, g_frame_seq++);
+    ScopedTimer timer(g_convert_ms);
     g_rgbaData = std::vector<uint8_t>(g_width * g_height * 4);
     g_stride = g_width * 4;
 
@@ -84,6 +139,7 @@ void PlayerWidget::onFrameChanged(VideoFrame2 frame) {
         g_rgbaData.data(), g_stride,
         g_width, g_height
         );
+    g_fresh_frame = true;
     this->update();
 }
 #else
@@ -106,15 +162,19 @@ void PlayerWidget::onFrameChanged(VideoFrame2 frame) {
 
     g_rgbaData = std::vector<uint8_t>(g_width * g_height * 4);
     g_stride = g_width * 4;
-    spdlog::warn(" onFrameChangedbefore: VideoFrame2");
     // 调用转换
-    libyuv::I420ToABGR(
-        src_y, src_stride_y,
-        src_u, src_stride_u,
-        src_v, src_stride_v,
-        g_rgbaData.data(), g_stride,
-        g_width, g_height
-        );
+    {
+        g_pts_ms = reinterpret_cast<intptr_t>(frame->opaque);
+        Tracer::Span span("convert", g_pts_ms, g_frame_seq++);
+        ScopedTimer timer(g_convert_ms);
+        libyuv::I420ToABGR(
+            src_y, src_stride_y,
+            src_u, src_stride_u,
+            src_v, src_stride_v,
+            g_rgbaData.data(), g_stride,
+            g_width, g_height
+            );
+    }
     makeCurrent(); // 确保当前 OpenGL 上下文激活
     glBindTexture(GL_TEXTURE_2D, textureId);
 
@@ -129,6 +189,7 @@ void PlayerWidget::onFrameChanged(VideoFrame2 frame) {
     }
     glBindTexture(GL_TEXTURE_2D, 0);
     doneCurrent();
+    g_fresh_frame = true;
     update();
     av_frame_free(&frame);
 }
@@ -144,9 +205,15 @@ void PlayerWidget::paintEvent(QPaintEvent *event) {
     }
 #else
     if (g_rgbaData.empty()) {
+        if (mStats) {
+            QPainter painter(this);
+            mStats->Paint(painter);
+        }
         return;
     }
 #endif
+    auto paint_begin = std::chrono::steady_clock::now();
+    Tracer::Span span("paint", g_pts_ms);
     QPainter painter(this);
 
     const QRect viewRect = rect();
@@ -172,6 +239,19 @@ void PlayerWidget::paintEvent(QPaintEvent *event) {
                  Qt::SmoothTransformation);
 #endif
     painter.drawImage(dstRect, rgbImage);
+    bool fresh = std::exchange(g_fresh_frame, false);
+    if (fresh) {
+        g_paint_ms.Record(std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - paint_begin).count());
+        g_painted.Add();
+    }
+    // 浮层不计入绘制耗时
+    if (mStats) {
+        mStats->Paint(painter);
+    }
+    if (fresh) {
+        emit FramePainted();
+    }
 }
 #endif
 #ifdef use_gl_widget
@@ -187,6 +267,8 @@ void PlayerWidget::initializeGL() {
 }
 
 void PlayerWidget::paintGL() {
+    auto paint_begin = std::chrono::steady_clock::now();
+    Tracer::Span span("paint", g_pts_ms);
     glClear(GL_COLOR_BUFFER_BIT);
 
     glEnable(GL_TEXTURE_2D); // 如果 core profile 会无效，推荐用 shader pipeline
@@ -204,6 +286,19 @@ void PlayerWidget::paintGL() {
     glEnd();
 
     glBindTexture(GL_TEXTURE_2D, 0);
+    bool fresh = std::exchange(g_fresh_frame, false);
+    if (fresh) {
+        g_paint_ms.Record(std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - paint_begin).count());
+        g_painted.Add();
+    }
+    if (mStats) {
+        QPainter painter(this);
+        mStats->Paint(painter);
+    }
+    if (fresh) {
+        emit FramePainted();
+    }
 }
 #endif
 
@@ -2,10 +2,14 @@
 
 #include <QWidget>
 #include <array>
+#include <functional>
+#include <memory>
 #include "Demuxer.h"
+#include "StatsOverlay.h"
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions>
 class PlayerController;
+class QTimer;
 // #define use_gl_widget
 
 class PlayerWidget :
@@ -28,9 +32,23 @@ public:
     void paintEvent(QPaintEvent *event) override;
 #endif
 
+    // 统计浮层每次刷新时从这里取数据
+    void SetStatsProvider(std::function<StatsOverlay::Sample()> provider);
+    void SetStatsVisible(bool visible);
+    bool StatsVisible() const;
+
 public Q_SLOTS:
     void onFrameChanged(VideoFrame);
     void onFrameChanged(VideoFrame2);
 
+Q_SIGNALS:
+    // 一帧画面真正画到窗口上之后
+    void FramePainted();
+
 private:
+    void refreshStats();
+
+    std::function<StatsOverlay::Sample()> mStatsProvider;
+    std::unique_ptr<StatsOverlay> mStats;
+    QTimer *mStatsTimer{};
 };
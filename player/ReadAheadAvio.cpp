@@ -0,0 +1,540 @@
+#include "ReadAheadAvio.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <spdlog/spdlog.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+using PreadFn = std::function<ssize_t(int, void *, size_t, off_t)>;
+
+struct ReadAheadAvio::Block {
+    int64_t offset;
+    size_t length; // 最后一块可能不满
+    uint8_t *data;
+    std::atomic<ssize_t> result{0};
+    std::atomic_bool done{false};
+};
+
+class ReadAheadAvio::Backend {
+public:
+    virtual ~Backend() = default;
+    virtual const char *name() const = 0;
+    // 队列满时返回 false
+    virtual bool submit(Block &block) = 0;
+    virtual void wait(Block &block) = 0;
+    // 不阻塞地收割已经完成的请求
+    virtual void poll() {}
+};
+
+namespace {
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// pread 可能读不满，读到要求的长度、EOF 或者出错为止
+ssize_t readFully(PreadFn const &pread, int fd, uint8_t *buf, size_t len,
+                  off_t offset) {
+    size_t total = 0;
+    while (total < len) {
+        ssize_t n = pread(fd, buf + total, len - total, offset + total);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -errno;
+        }
+        if (n == 0) {
+            break;
+        }
+        total += n;
+    }
+    return total;
+}
+
+class PoolBackend : public ReadAheadAvio::Backend {
+public:
+    PoolBackend(int fd, int threads, PreadFn pread)
+        : fd_(fd), pread_(std::move(pread)) {
+        for (int i = 0; i < std::max(threads, 1); ++i) {
+            workers_.emplace_back([this](std::stop_token token) {
+                work(token);
+            });
+        }
+    }
+
+    ~PoolBackend() override {
+        for (auto &worker : workers_) {
+            worker.request_stop();
+        }
+        workers_.clear();
+    }
+
+    const char *name() const override {
+        return "threadpool";
+    }
+
+    bool submit(ReadAheadAvio::Block &block) override {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            queue_.push_back(&block);
+        }
+        cv_.notify_one();
+        return true;
+    }
+
+    void wait(ReadAheadAvio::Block &block) override {
+        std::unique_lock<std::mutex> lock(mtx_);
+        done_cv_.wait(lock, [&] {
+            return block.done.load();
+        });
+    }
+
+private:
+    void work(std::stop_token token) {
+        while (true) {
+            ReadAheadAvio::Block *block;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                if (!cv_.wait(lock, token, [this] {
+                    return !queue_.empty();
+                })) {
+                    return;
+                }
+                block = queue_.front();
+                queue_.pop_front();
+            }
+            block->result = readFully(pread_, fd_, block->data, block->length,
+                                      block->offset);
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                block->done = true;
+            }
+            done_cv_.notify_all();
+        }
+    }
+
+    int fd_;
+    PreadFn pread_;
+    std::mutex mtx_;
+    std::condition_variable_any cv_;
+    std::condition_variable_any done_cv_;
+    std::deque<ReadAheadAvio::Block *> queue_;
+    std::vector<std::jthread> workers_;
+};
+
+#ifdef HAVE_LIBURING
+// 提交和收割都在 demux 线程，不需要额外的线程和锁
+class UringBackend : public ReadAheadAvio::Backend {
+public:
+    static std::unique_ptr<UringBackend> Create(int fd, unsigned depth) {
+        std::unique_ptr<UringBackend> backend(new UringBackend(fd));
+        int ret = io_uring_queue_init(depth, &backend->ring_, 0);
+        if (ret < 0) {
+            spdlog::warn("io_uring_queue_init failed: {}", strerror(-ret));
+            return nullptr;
+        }
+        backend->ready_ = true;
+        return backend;
+    }
+
+    ~UringBackend() override {
+        if (ready_) {
+            io_uring_queue_exit(&ring_);
+        }
+    }
+
+    const char *name() const override {
+        return "io_uring";
+    }
+
+    bool submit(ReadAheadAvio::Block &block) override {
+        if (broken_) {
+            return false;
+        }
+        io_uring_sqe *sqe = io_uring_get_sqe(&ring_);
+        if (!sqe) {
+            return false;
+        }
+        io_uring_prep_read(sqe, fd_, block.data, block.length, block.offset);
+        io_uring_sqe_set_data(sqe, &block);
+        // SQE 拿到以后收不回来，下次 io_uring_submit 总会带上它。所以这次
+        // 没交上去也算提交成功，块留在 blocks_ 里等到完成，不会被释放
+        queued_.push_back(&block);
+        flush();
+        return true;
+    }
+
+    void wait(ReadAheadAvio::Block &block) override {
+        while (!block.done) {
+            flush();
+            if (block.done) {
+                return;
+            }
+            if (in_flight_ == 0) {
+                // 还没交给内核，资源暂时不够，过一会儿再交
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            io_uring_cqe *cqe;
+            int ret = io_uring_wait_cqe(&ring_, &cqe);
+            if (ret == -EINTR) {
+                continue;
+            }
+            if (ret < 0) {
+                block.result = ret;
+                block.done = true;
+                return;
+            }
+            complete(cqe);
+        }
+    }
+
+    void poll() override {
+        io_uring_cqe *cqe;
+        while (io_uring_peek_cqe(&ring_, &cqe) == 0) {
+            complete(cqe);
+        }
+        flush();
+    }
+
+private:
+    explicit UringBackend(int fd) : fd_(fd) {}
+
+    // 把环里还没交给内核的 SQE 交上去。EAGAIN/EBUSY 是暂时的，收割一些
+    // 完成事件以后再交；其他错误说明环不能用了，之后不再提交，留在环里的
+    // SQE 到不了内核。排队的块按读了 0 字节完成，由 finish 同步读
+    void flush() {
+        while (!queued_.empty() && !broken_) {
+            int ret = io_uring_submit(&ring_);
+            if (ret == -EINTR) {
+                continue;
+            }
+            if (ret == -EAGAIN || ret == -EBUSY) {
+                return;
+            }
+            if (ret < 0) {
+                spdlog::warn("io_uring_submit failed: {}, read synchronously",
+                             strerror(-ret));
+                broken_ = true;
+                for (auto *block : queued_) {
+                    block->result = 0;
+                    block->done = true;
+                }
+                queued_.clear();
+                return;
+            }
+            size_t n = std::min<size_t>(ret, queued_.size());
+            queued_.erase(queued_.begin(), queued_.begin() + n);
+            in_flight_ += n;
+            if (n == 0) {
+                return;
+            }
+        }
+    }
+
+    // 读不满的部分由 finish 同步补齐
+    void complete(io_uring_cqe *cqe) {
+        auto *block = static_cast<ReadAheadAvio::Block *>(
+            io_uring_cqe_get_data(cqe));
+        block->result = cqe->res;
+        block->done = true;
+        io_uring_cqe_seen(&ring_, cqe);
+        in_flight_--;
+    }
+
+    int fd_;
+    io_uring ring_{};
+    bool ready_{};
+    bool broken_{};
+    std::deque<ReadAheadAvio::Block *> queued_; // 已经准备好还没交给内核
+    size_t in_flight_{};                        // 交给内核还没收割
+};
+#endif
+}
+
+ReadAheadAvio::ReadAheadAvio(Options options)
+    : options_(std::move(options)), window_(options_.minWindow) {
+    if (!options_.pread) {
+        options_.pread = ::pread;
+    }
+}
+
+ReadAheadAvio::~ReadAheadAvio() {
+    // 在飞的请求还会写块里的内存，等它们完成再释放
+    for (auto &[index, block] : blocks_) {
+        if (!block->done) {
+            backend_->wait(*block);
+        }
+    }
+    if (backend_) {
+        Stats s = stats();
+        spdlog::info("read-ahead {}: {} hits, {} stalls, wait {:.1f}ms "
+                     "(max {:.1f}ms), window {}KB", s.backend, s.hits,
+                     s.stalls, s.waitMs, s.maxWaitMs, s.windowBytes / 1024);
+    }
+    backend_.reset();
+    for (auto &[index, block] : blocks_) {
+        std::free(block->data);
+    }
+    for (uint8_t *data : spare_) {
+        std::free(data);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+std::unique_ptr<ReadAheadAvio> ReadAheadAvio::Open(const std::string &path) {
+    return Open(path, Options{});
+}
+
+std::unique_ptr<ReadAheadAvio> ReadAheadAvio::Open(const std::string &path,
+                                                   Options options) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    options.blockSize = (std::max(options.blockSize, kAlignment) +
+                         kAlignment - 1) / kAlignment * kAlignment;
+    options.maxWindow = std::max(options.maxWindow, options.blockSize);
+    options.minWindow = std::clamp(options.minWindow, options.blockSize,
+                                   options.maxWindow);
+
+    std::unique_ptr<ReadAheadAvio> source(new ReadAheadAvio(options));
+    source->fd_ = fd;
+    source->size_ = st.st_size;
+#ifdef HAVE_LIBURING
+    if (options.useUring && !options.pread) {
+        source->backend_ = UringBackend::Create(fd, source->depth());
+    }
+#endif
+    if (!source->backend_) {
+        source->backend_ = std::make_unique<PoolBackend>(
+            fd, options.threads, source->options_.pread);
+    }
+    if (!source->initAvio(kBufferSize)) {
+        return nullptr;
+    }
+    spdlog::info("read-ahead {} with {}, {} bytes", path,
+                 source->backend_->name(), source->size_);
+    return source;
+}
+
+ReadAheadAvio::Stats ReadAheadAvio::stats() const {
+    return {hits_, stalls_, wait_ns_ / 1e6, max_wait_ns_ / 1e6, window_,
+            bytes_per_second_, in_flight_, backend_->name()};
+}
+
+int ReadAheadAvio::read(uint8_t *buf, int size) {
+    if (pos_ >= size_) {
+        return AVERROR_EOF;
+    }
+    backend_->poll();
+    updateRate();
+    int64_t index = pos_ / options_.blockSize;
+    // 已经提前提交过还没读完，说明窗口不够盖住 IO 延迟；
+    // 刚 seek 过来才提交的块等待是免不了的
+    bool prefetched = blocks_.contains(index);
+    schedule(index);
+
+    auto it = blocks_.find(index);
+    if (it == blocks_.end()) {
+        // 提交队列被窗口外的旧请求占满了，这次同步读
+        stalls_.fetch_add(1, std::memory_order_relaxed);
+        ssize_t n = readFully(options_.pread, fd_, buf, size, pos_);
+        if (n <= 0) {
+            return n == 0 ? AVERROR_EOF : AVERROR(-n);
+        }
+        pos_ += n;
+        rate_bytes_ += n;
+        return n;
+    }
+    Block &block = *it->second;
+    if (block.done) {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        int64_t begin = nowNs();
+        backend_->wait(block);
+        int64_t waited = nowNs() - begin;
+        stalls_.fetch_add(1, std::memory_order_relaxed);
+        wait_ns_.fetch_add(waited, std::memory_order_relaxed);
+        if (waited > max_wait_ns_) {
+            max_wait_ns_ = waited;
+        }
+        // 先放大窗口，码率统计再慢慢收回来
+        if (prefetched) {
+            stalled_ = true;
+            window_ = std::min(window_ * 2, options_.maxWindow);
+        }
+    }
+    if (!finish(block)) {
+        ssize_t err = block.result;
+        release(std::move(it->second));
+        blocks_.erase(it);
+        if (err >= 0) {
+            return AVERROR_EOF;
+        }
+        spdlog::warn("read-ahead read at {} failed: {}", pos_, strerror(-err));
+        return AVERROR(-err);
+    }
+    size_t offset = pos_ - block.offset;
+    size_t n = std::min<size_t>(size, block.length - offset);
+    std::memcpy(buf, block.data + offset, n);
+    pos_ += n;
+    rate_bytes_ += n;
+    return n;
+}
+
+int64_t ReadAheadAvio::seek(int64_t offset, int whence) {
+    if (whence == AVSEEK_SIZE) {
+        return size_;
+    }
+    int64_t pos;
+    switch (whence) {
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = pos_ + offset;
+        break;
+    case SEEK_END:
+        pos = size_ + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0 || pos > size_) {
+        return AVERROR(EINVAL);
+    }
+    // 窗口跟着读位置走，下次 read 时回收旧块、提交新块
+    pos_ = pos;
+    return pos;
+}
+
+void ReadAheadAvio::schedule(int64_t index) {
+    int64_t block_size = options_.blockSize;
+    int64_t count = std::max<int64_t>(window_ / block_size, 1);
+    int64_t last = std::min(index + count, (size_ - 1) / block_size + 1);
+
+    // 窗口外已经读完的块回收，还在飞的等完成后下次再回收；
+    // 留一个当前块之前的，小幅度往回 seek 不用重读
+    int pending = 0;
+    for (auto it = blocks_.begin(); it != blocks_.end();) {
+        bool keep = it->first >= index - 1 && it->first < last;
+        if (!keep && it->second->done) {
+            release(std::move(it->second));
+            it = blocks_.erase(it);
+            continue;
+        }
+        pending += !it->second->done;
+        ++it;
+    }
+
+    for (int64_t i = index; i < last && pending < depth(); ++i) {
+        if (blocks_.contains(i)) {
+            continue;
+        }
+        auto block = std::make_unique<Block>();
+        block->offset = i * block_size;
+        block->length = std::min<int64_t>(block_size, size_ - block->offset);
+        if (!spare_.empty()) {
+            block->data = spare_.back();
+            spare_.pop_back();
+        } else {
+            block->data = static_cast<uint8_t *>(
+                std::aligned_alloc(kAlignment, block_size));
+        }
+        if (!block->data || !backend_->submit(*block)) {
+            release(std::move(block));
+            break;
+        }
+        blocks_.emplace(i, std::move(block));
+        pending++;
+    }
+    in_flight_ = pending;
+}
+
+bool ReadAheadAvio::finish(Block &block) {
+    ssize_t result = block.result;
+    if (result < 0) {
+        return false;
+    }
+    if (static_cast<size_t>(result) < block.length) {
+        ssize_t n = readFully(options_.pread, fd_, block.data + result,
+                              block.length - result, block.offset + result);
+        if (n < 0) {
+            block.result = n;
+            return false;
+        }
+        // 文件被截短了，按实际读到的算
+        block.length = result + n;
+        block.result = block.length;
+    }
+    return pos_ < block.offset + static_cast<int64_t>(block.length);
+}
+
+int ReadAheadAvio::depth() const {
+    // 窗口内的块加上窗口外还没完成的几个
+    return options_.maxWindow / options_.blockSize + 2;
+}
+
+void ReadAheadAvio::release(std::unique_ptr<Block> block) {
+    if (!block->data) {
+        return;
+    }
+    if (spare_.size() < 8) {
+        spare_.push_back(block->data);
+    } else {
+        std::free(block->data);
+    }
+}
+
+void ReadAheadAvio::updateRate() {
+    int64_t now = nowNs();
+    if (rate_start_ns_ == 0) {
+        rate_start_ns_ = now;
+        return;
+    }
+    int64_t elapsed = now - rate_start_ns_;
+    if (elapsed < 500'000'000) {
+        return;
+    }
+    double rate = rate_bytes_ * 1e9 / elapsed;
+    double avg = bytes_per_second_ > 0
+                     ? bytes_per_second_ * 0.7 + rate * 0.3
+                     : rate;
+    bytes_per_second_ = avg;
+    size_t target = std::clamp(static_cast<size_t>(avg * options_.leadSeconds),
+                               options_.minWindow, options_.maxWindow);
+    size_t window = window_;
+    if (window < target) {
+        window = target;
+    } else if (!stalled_) {
+        window = std::max(target, window * 3 / 4);
+    }
+    window_ = window;
+    stalled_ = false;
+    rate_bytes_ = 0;
+    rate_start_ns_ = now;
+}
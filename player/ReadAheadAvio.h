@@ -0,0 +1,88 @@
+#pragma once
+#include "AvioSource.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+// 异步预读的 AVIO，给网络文件系统和机械盘用：读位置前方保持若干个
+// 对齐的大块读请求在飞，demux 线程只在真正缺数据时才等。后端优先用
+// io_uring（编译时找到 liburing），否则用线程池 pread。
+// 预读窗口按实际消耗的码率调整，卡住过就放大
+class ReadAheadAvio : public AvioSource {
+public:
+    struct Options {
+        size_t blockSize = 1024 * 1024;
+        size_t minWindow = 4 * 1024 * 1024;
+        size_t maxWindow = 64 * 1024 * 1024;
+        double leadSeconds = 4.0; // 窗口至少覆盖这么久的码流
+        int threads = 4;          // 线程池后端的线程数
+        bool useUring = true;
+        // 测试用：替换 pread 模拟慢盘，设置后固定走线程池
+        std::function<ssize_t(int, void *, size_t, off_t)> pread;
+    };
+
+    struct Stats {
+        uint64_t hits;   // 需要的块已经读好
+        uint64_t stalls; // demux 线程等了 IO
+        double waitMs;   // 累计等待时间
+        double maxWaitMs;
+        size_t windowBytes;
+        double bytesPerSecond; // 估计的消耗码率
+        int inFlight;
+        const char *backend;
+    };
+
+    ~ReadAheadAvio() override;
+
+    static std::unique_ptr<ReadAheadAvio> Open(const std::string &path);
+    static std::unique_ptr<ReadAheadAvio> Open(const std::string &path,
+                                               Options options);
+
+    Stats stats() const;
+
+    static constexpr int kBufferSize = 256 * 1024;
+    static constexpr size_t kAlignment = 4096;
+
+    struct Block;
+    class Backend;
+
+protected:
+    int read(uint8_t *buf, int size) override;
+    int64_t seek(int64_t offset, int whence) override;
+
+private:
+    explicit ReadAheadAvio(Options options);
+
+    void schedule(int64_t index);
+    bool finish(Block &block);
+    void release(std::unique_ptr<Block> block);
+    int depth() const;
+    void updateRate();
+
+    Options options_;
+    int fd_{-1};
+    int64_t size_{};
+    int64_t pos_{};
+    std::unique_ptr<Backend> backend_;
+
+    // 只在 demux 线程访问
+    std::map<int64_t, std::unique_ptr<Block>> blocks_;
+    std::vector<uint8_t *> spare_;
+    int64_t rate_bytes_{};
+    int64_t rate_start_ns_{};
+    bool stalled_{};
+
+    std::atomic<size_t> window_;
+    std::atomic<double> bytes_per_second_{0};
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> stalls_{0};
+    std::atomic<int64_t> wait_ns_{0};
+    std::atomic<int64_t> max_wait_ns_{0};
+    std::atomic_int in_flight_{0};
+};
@@ -0,0 +1,273 @@
+#include "Scrubber.h"
+#include "KeyframeIndex.h"
+#include <spdlog/spdlog.h>
+#include <utility>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+}
+
+namespace {
+// 关键帧前面可能还有解码器延迟，最多多读这么多包
+constexpr int kMaxPacketsPerRequest = 64;
+
+size_t frameBytes(AVFrame const *frame) {
+    int size = av_image_get_buffer_size(
+        static_cast<AVPixelFormat>(frame->format), frame->width,
+        frame->height, 1);
+    return size > 0 ? static_cast<size_t>(size) : 0;
+}
+}
+
+Scrubber::Scrubber(FrameCallback on_frame, size_t cache_budget)
+    : on_frame_(std::move(on_frame)), cache_budget_(cache_budget) {}
+
+Scrubber::~Scrubber() {
+    Close();
+}
+
+int Scrubber::interrupted(void *opaque) {
+    auto *self = static_cast<Scrubber *>(opaque);
+    return self->stale(self->active_generation_.load());
+}
+
+bool Scrubber::stale(uint64_t generation) const {
+    return generation != generation_.load();
+}
+
+bool Scrubber::Open(const std::string &url, KeyframeIndex const *index) {
+    Close();
+    format_ctx_ = avformat_alloc_context();
+    format_ctx_->interrupt_callback = {interrupted, this};
+    if (avformat_open_input(&format_ctx_, url.c_str(), nullptr, nullptr) !=
+        0) {
+        spdlog::error("scrub: open {} failed", url);
+        return false;
+    }
+    if (avformat_find_stream_info(format_ctx_, nullptr) < 0) {
+        avformat_close_input(&format_ctx_);
+        return false;
+    }
+    stream_ = av_find_best_stream(format_ctx_, AVMEDIA_TYPE_VIDEO, -1, -1,
+                                  nullptr, 0);
+    if (stream_ < 0) {
+        avformat_close_input(&format_ctx_);
+        return false;
+    }
+    for (unsigned i = 0; i < format_ctx_->nb_streams; ++i) {
+        if (static_cast<int>(i) != stream_) {
+            format_ctx_->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    AVStream *stream = format_ctx_->streams[stream_];
+    const AVCodec *codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    codec_ctx_ = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(codec_ctx_, stream->codecpar);
+    // 只解关键帧；帧级多线程会攒帧，换成 slice 多线程降低单帧延迟
+    codec_ctx_->skip_frame = AVDISCARD_NONKEY;
+    codec_ctx_->thread_type = FF_THREAD_SLICE;
+    if (avcodec_open2(codec_ctx_, codec, nullptr) != 0) {
+        spdlog::error("scrub: open decoder failed");
+        avcodec_free_context(&codec_ctx_);
+        avformat_close_input(&format_ctx_);
+        return false;
+    }
+
+    url_ = url;
+    index_ = index;
+    worker_ = std::jthread([this](std::stop_token token) {
+        run(token);
+    });
+    return true;
+}
+
+void Scrubber::Close() {
+    if (worker_.joinable()) {
+        worker_.request_stop();
+        Cancel();
+        worker_ = {};
+        auto s = stats();
+        spdlog::info("scrub closed: hits {} misses {} cancelled {}", s.hits,
+                     s.misses, s.cancelled);
+    }
+    clearCache();
+    avcodec_free_context(&codec_ctx_);
+    if (format_ctx_) {
+        avformat_close_input(&format_ctx_);
+    }
+    index_ = nullptr;
+    url_.clear();
+}
+
+void Scrubber::Request(int64_t target_ms) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        pending_ms_ = target_ms;
+        generation_++;
+    }
+    cv_.notify_one();
+}
+
+void Scrubber::Cancel() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        pending_ms_ = -1;
+        generation_++;
+    }
+    cv_.notify_one();
+}
+
+Scrubber::Stats Scrubber::stats() const {
+    return {hits_.load(), misses_.load(), cancelled_.load()};
+}
+
+void Scrubber::run(std::stop_token token) {
+    while (!token.stop_requested()) {
+        int64_t target_ms;
+        uint64_t generation;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [&] {
+                return token.stop_requested() || pending_ms_ >= 0;
+            });
+            if (token.stop_requested()) {
+                break;
+            }
+            target_ms = std::exchange(pending_ms_, -1);
+            generation = generation_.load();
+        }
+        active_generation_ = generation;
+        serve(target_ms, generation);
+    }
+}
+
+void Scrubber::serve(int64_t target_ms, uint64_t generation) {
+    AVStream *stream = format_ctx_->streams[stream_];
+    int64_t target = av_rescale_q(target_ms, {1, 1000}, stream->time_base);
+
+    // 有索引时不用碰 demuxer 就知道落在哪个关键帧，缓存按索引的时间戳存
+    int64_t key = AV_NOPTS_VALUE;
+    if (index_) {
+        if (auto keyframe = index_->Find(target)) {
+            key = keyframe->pts;
+            if (AVFrame *cached = findCached(key)) {
+                hits_++;
+                deliver(av_frame_clone(cached), key, generation);
+                return;
+            }
+        }
+    }
+
+    if (av_seek_frame(format_ctx_, stream_, target, AVSEEK_FLAG_BACKWARD) <
+        0) {
+        if (!stale(generation)) {
+            spdlog::warn("scrub: seek to {}ms failed", target_ms);
+        }
+        return;
+    }
+    avcodec_flush_buffers(codec_ctx_);
+    AVFrame *frame = decodeKeyframe(key, generation);
+    if (!frame) {
+        if (stale(generation)) {
+            cancelled_++;
+        }
+        return;
+    }
+    deliver(av_frame_clone(frame), key, generation);
+    insertCache(key, frame);
+}
+
+AVFrame *Scrubber::decodeKeyframe(int64_t &key, uint64_t generation) {
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    bool got = false;
+    for (int i = 0; i < kMaxPacketsPerRequest && !got && !stale(generation);
+         ++i) {
+        int ret = av_read_frame(format_ctx_, packet);
+        if (ret == AVERROR_EOF) {
+            avcodec_send_packet(codec_ctx_, nullptr);
+        } else if (ret < 0) {
+            break;
+        } else if (packet->stream_index != stream_) {
+            av_packet_unref(packet);
+            continue;
+        } else {
+            if (key == AV_NOPTS_VALUE && (packet->flags & AV_PKT_FLAG_KEY)) {
+                key = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+                // 没有索引时，读到关键帧包就能查缓存，省掉解码
+                if (AVFrame *cached = findCached(key)) {
+                    hits_++;
+                    av_packet_free(&packet);
+                    av_frame_free(&frame);
+                    return av_frame_clone(cached);
+                }
+            }
+            avcodec_send_packet(codec_ctx_, packet);
+            av_packet_unref(packet);
+        }
+        got = avcodec_receive_frame(codec_ctx_, frame) == 0;
+        if (ret == AVERROR_EOF) {
+            break;
+        }
+    }
+    av_packet_free(&packet);
+    if (!got) {
+        av_frame_free(&frame);
+        return nullptr;
+    }
+    misses_++;
+    if (key == AV_NOPTS_VALUE) {
+        key = frame->best_effort_timestamp;
+    }
+    return frame;
+}
+
+bool Scrubber::deliver(AVFrame *frame, int64_t key, uint64_t generation) {
+    // 拖动已经移走了，不再显示过期的预览
+    if (!frame || stale(generation)) {
+        av_frame_free(&frame);
+        cancelled_++;
+        return false;
+    }
+    AVRational time_base = format_ctx_->streams[stream_]->time_base;
+    on_frame_(frame, av_rescale_q(key, time_base, {1, 1000}));
+    return true;
+}
+
+AVFrame *Scrubber::findCached(int64_t key) {
+    auto it = cache_.find(key);
+    if (it == cache_.end()) {
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->second;
+}
+
+void Scrubber::insertCache(int64_t key, AVFrame *frame) {
+    if (cache_.contains(key)) {
+        av_frame_free(&frame);
+        return;
+    }
+    lru_.emplace_front(key, frame);
+    cache_[key] = lru_.begin();
+    cache_bytes_ += frameBytes(frame);
+    while (cache_bytes_ > cache_budget_ && lru_.size() > 1) {
+        auto &[old_key, old_frame] = lru_.back();
+        cache_bytes_ -= frameBytes(old_frame);
+        cache_.erase(old_key);
+        av_frame_free(&old_frame);
+        lru_.pop_back();
+    }
+}
+
+void Scrubber::clearCache() {
+    for (auto &[key, frame] : lru_) {
+        av_frame_free(&frame);
+    }
+    lru_.clear();
+    cache_.clear();
+    cache_bytes_ = 0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+struct AVFrame;
+struct AVFormatContext;
+struct AVCodecContext;
+class KeyframeIndex;
+
+// 拖动进度条时的关键帧预览：独立的 demuxer 和解码器，只解关键帧，
+// 解出的关键帧按 pts 做 LRU 缓存，来回拖动时直接命中
+class Scrubber {
+public:
+    // 在工作线程回调，frame 由接收方释放
+    using FrameCallback = std::function<void(AVFrame *frame, int64_t pts_ms)>;
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t cancelled;
+    };
+
+    explicit Scrubber(FrameCallback on_frame,
+                      size_t cache_budget = 64 * 1024 * 1024);
+    ~Scrubber();
+
+    // index 可以为空，为空时先 seek 再按读到的关键帧 pts 查缓存
+    bool Open(const std::string &url, KeyframeIndex const *index);
+    void Close();
+
+    // 只处理最新的请求，正在进行的旧请求会被打断
+    void Request(int64_t target_ms);
+    void Cancel();
+
+    const std::string &url() const {
+        return url_;
+    }
+
+    Stats stats() const;
+
+private:
+    void run(std::stop_token token);
+    void serve(int64_t target_ms, uint64_t generation);
+    // key 为空时取读到的第一个关键帧包的时间戳
+    AVFrame *decodeKeyframe(int64_t &key, uint64_t generation);
+    bool deliver(AVFrame *frame, int64_t key, uint64_t generation);
+    AVFrame *findCached(int64_t key);
+    void insertCache(int64_t key, AVFrame *frame);
+    void clearCache();
+    bool stale(uint64_t generation) const;
+    static int interrupted(void *opaque);
+
+    FrameCallback on_frame_;
+    std::string url_;
+    KeyframeIndex const *index_{};
+    AVFormatContext *format_ctx_{};
+    AVCodecContext *codec_ctx_{};
+    int stream_{-1};
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    int64_t pending_ms_{-1};
+    std::atomic<uint64_t> generation_{0};
+    std::atomic<uint64_t> active_generation_{0};
+
+    // 只在工作线程访问
+    std::list<std::pair<int64_t, AVFrame *>> lru_;
+    std::unordered_map<int64_t, decltype(lru_)::iterator> cache_;
+    size_t cache_bytes_{};
+    size_t cache_budget_;
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> cancelled_{0};
+    std::jthread worker_;
+};
@@ -0,0 +1,203 @@
+#include "StatsOverlay.h"
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include <QPainter>
+#include <algorithm>
+#include <tuple>
+#include <spdlog/spdlog.h>
+
+namespace {
+constexpr int kOffset = 8;  // 离窗口左上角
+constexpr int kPadding = 6;
+constexpr int kSparkGap = 10;
+constexpr int kSparkWidth = 90;
+
+// 没有新样本时显示 -
+std::string formatMs(double ms) {
+    return ms < 0 ? std::string("    -") : fmt::format("{:5.2f}", ms);
+}
+
+Metrics::HistogramSnapshot histogramOf(Metrics::Snapshot const &snapshot,
+                                       const std::string &name) {
+    auto it = snapshot.histograms.find(name);
+    return it != snapshot.histograms.end() ? it->second
+                                           : Metrics::HistogramSnapshot{};
+}
+
+double gaugeOf(Metrics::Snapshot const &snapshot, const std::string &name) {
+    auto it = snapshot.gauges.find(name);
+    return it != snapshot.gauges.end() ? it->second : 0;
+}
+
+uint64_t counterOf(Metrics::Snapshot const &snapshot,
+                   const std::string &name) {
+    auto it = snapshot.counters.find(name);
+    return it != snapshot.counters.end() ? it->second : 0;
+}
+}
+
+void StatsOverlay::Sparkline::Push(double value) {
+    values_[next_] = value;
+    next_ = (next_ + 1) % kHistory;
+    size_ = std::min(size_ + 1, kHistory);
+}
+
+QPolygonF StatsOverlay::Sparkline::Points(QRectF const &box) const {
+    QPolygonF points;
+    if (size_ < 2) {
+        return points;
+    }
+    int first = (next_ - size_ + kHistory) % kHistory;
+    // 纵轴总是包含 0，耗时从底边开始，偏差正负都看得出来
+    double low = 0;
+    double high = 0;
+    for (int i = 0; i < size_; ++i) {
+        double v = values_[(first + i) % kHistory];
+        low = std::min(low, v);
+        high = std::max(high, v);
+    }
+    double range = std::max(high - low, 1e-3);
+    double step = box.width() / (kHistory - 1);
+    // 新的点靠右
+    double x = box.right() - step * (size_ - 1);
+    for (int i = 0; i < size_; ++i, x += step) {
+        double v = values_[(first + i) % kHistory];
+        points << QPointF(x, box.bottom() - (v - low) / range * box.height());
+    }
+    return points;
+}
+
+StatsOverlay::StatsOverlay()
+    : font_(QFontDatabase::systemFont(QFontDatabase::FixedFont)) {
+    line_height_ = QFontMetrics(font_).height();
+}
+
+Metrics::HistogramSnapshot StatsOverlay::intervalHistogram(
+    const std::string &name, Metrics::Snapshot const &now) const {
+    auto current = histogramOf(now, name);
+    return has_last_ ? current.Since(histogramOf(last_, name)) : current;
+}
+
+double StatsOverlay::counterRate(const std::string &name,
+                                 Metrics::Snapshot const &now,
+                                 double seconds) const {
+    if (!has_last_ || seconds <= 0) {
+        return 0;
+    }
+    return static_cast<double>(counterOf(now, name) -
+                               counterOf(last_, name)) /
+           seconds;
+}
+
+void StatsOverlay::addLine(const std::string &text, int spark) {
+    Line line;
+    line.text.setTextFormat(Qt::PlainText);
+    line.text.setPerformanceHint(QStaticText::AggressiveCaching);
+    line.text.setText(QString::fromStdString(text));
+    line.text.prepare(QTransform(), font_);
+    line.spark = spark;
+    text_width_ = std::max(text_width_,
+                           static_cast<int>(line.text.size().width()));
+    lines_.push_back(std::move(line));
+}
+
+void StatsOverlay::Update(const Sample &sample) {
+    auto const &now = sample.metrics;
+    auto const &stream = sample.stream;
+    double seconds = has_last_ ? (now.timeMs - last_.timeMs) / 1000.0 : 0;
+
+    lines_.clear();
+    text_width_ = 0;
+    addLine(fmt::format("Video: {} {}x{} {}", stream.videoCodec, stream.width,
+                        stream.height, stream.pixelFormat));
+    addLine(fmt::format("Audio: {} {}Hz {}ch", stream.audioCodec,
+                        stream.sampleRate, stream.channels));
+    addLine(fmt::format("FPS:   {:5.1f} / {} (decoded {:.1f})",
+                        counterRate("video.painted", now, seconds),
+                        stream.fps > 0 ? fmt::format("{:.3f}", stream.fps)
+                                       : std::string("?"),
+                        counterRate("video.frames", now, seconds)));
+
+    struct Stage {
+        const char *label;
+        const char *histogram;
+        int spark;
+    };
+    for (auto [label, histogram, spark] :
+         {Stage{"Read:   ", "demux.read_ms", -1},
+          Stage{"Decode: ", "video.decode_ms", kDecode},
+          Stage{"Convert:", "video.convert_ms", kConvert},
+          Stage{"Paint:  ", "video.paint_ms", kPaint}}) {
+        auto interval = intervalHistogram(histogram, now);
+        double mean = interval.count ? interval.meanMs : -1;
+        double p99 = interval.count ? interval.p99Ms : -1;
+        if (spark >= 0) {
+            sparks_[spark].Push(std::max(mean, 0.0));
+        }
+        addLine(fmt::format("{} {}ms  p99 {}ms", label, formatMs(mean),
+                            formatMs(p99)),
+                spark);
+    }
+
+    for (auto [label, name, capacity] :
+         {std::tuple{"Video queue:", "video", stream.videoQueueCapacity},
+          std::tuple{"Audio queue:", "audio", stream.audioQueueCapacity}}) {
+        std::string prefix = name;
+        addLine(fmt::format(
+            "{} {:4.0f}/{} {:5.0f}ms {:6.0f}KB", label,
+            gaugeOf(now, prefix + ".queue_packets"), capacity,
+            gaugeOf(now, prefix + ".queue_ms"),
+            gaugeOf(now, prefix + ".queue_bytes") / 1024));
+    }
+
+    addLine(fmt::format("Dropped: video {} audio {}  discarded {}",
+                        counterOf(now, "video.dropped"),
+                        counterOf(now, "audio.dropped"),
+                        counterOf(now, "video.discarded")));
+    addLine(fmt::format("Late: {} frames, max {:.0f}ms, {} underruns",
+                        sample.stalls.lateFrames, sample.stalls.maxLateMs,
+                        sample.stalls.underruns));
+    double drift = gaugeOf(now, "av.drift_ms");
+    sparks_[kDrift].Push(drift);
+    addLine(fmt::format("A/V:   {:+6.1f}ms  correction {:.2f}%", drift,
+                        gaugeOf(now, "av.correction_percent")),
+            kDrift);
+
+    // 折线接在最宽的一行后面
+    for (size_t i = 0; i < lines_.size(); ++i) {
+        int spark = lines_[i].spark;
+        if (spark < 0) {
+            continue;
+        }
+        QRectF box(kPadding + text_width_ + kSparkGap,
+                   kPadding + static_cast<int>(i) * line_height_ + 2,
+                   kSparkWidth, line_height_ - 4);
+        spark_points_[spark] = sparks_[spark].Points(box);
+    }
+    size_ = QSize(kPadding * 2 + text_width_ + kSparkGap + kSparkWidth,
+                  kPadding * 2 +
+                  static_cast<int>(lines_.size()) * line_height_);
+    last_ = now;
+    has_last_ = true;
+}
+
+void StatsOverlay::Paint(QPainter &painter) const {
+    if (lines_.empty()) {
+        return;
+    }
+    painter.save();
+    painter.translate(kOffset, kOffset);
+    painter.fillRect(QRect(QPoint(0, 0), size_), QColor(0, 0, 0, 170));
+    painter.setFont(font_);
+    painter.setPen(Qt::white);
+    for (size_t i = 0; i < lines_.size(); ++i) {
+        painter.drawStaticText(
+            kPadding, kPadding + static_cast<int>(i) * line_height_,
+            lines_[i].text);
+    }
+    painter.setPen(QColor(120, 220, 120));
+    for (auto const &points : spark_points_) {
+        painter.drawPolyline(points);
+    }
+    painter.restore();
+}
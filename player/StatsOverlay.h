@@ -0,0 +1,71 @@
+#pragma once
+#include <QFont>
+#include <QPolygonF>
+#include <QSize>
+#include <QStaticText>
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "PlayerController.h"
+
+class QPainter;
+
+// mpv 风格的统计浮层：解码器、分辨率、帧率、各阶段耗时、队列、丢帧和
+// 音画偏差，耗时和偏差后面带最近 15 秒的折线。文字排版和折线都在
+// Update 里算好缓存起来，Paint 只画缓存。Update 每 kRefresh 最多一次，
+// 浮层本身不会明显影响它显示的耗时
+class StatsOverlay {
+public:
+    struct Sample {
+        StreamInfo stream;
+        Metrics::Snapshot metrics;
+        StallStats stalls;
+    };
+
+    static constexpr std::chrono::milliseconds kRefresh{250};
+    static constexpr int kHistory = 60;
+
+    StatsOverlay();
+
+    void Update(const Sample &sample);
+    // 画在左上角
+    void Paint(QPainter &painter) const;
+
+private:
+    // 一条折线最近 kHistory 个点
+    class Sparkline {
+    public:
+        void Push(double value);
+        QPolygonF Points(QRectF const &box) const;
+
+    private:
+        std::array<double, kHistory> values_{};
+        int size_{};
+        int next_{};
+    };
+
+    struct Line {
+        QStaticText text;
+        int spark{-1};
+    };
+
+    enum Spark { kDecode, kConvert, kPaint, kDrift, kSparks };
+
+    // 两次快照之间新增样本的分布，均值和 p99 都按这一段算
+    Metrics::HistogramSnapshot intervalHistogram(
+        const std::string &name, Metrics::Snapshot const &now) const;
+    double counterRate(const std::string &name, Metrics::Snapshot const &now,
+                       double seconds) const;
+    void addLine(const std::string &text, int spark = -1);
+
+    QFont font_;
+    std::vector<Line> lines_;
+    std::array<Sparkline, kSparks> sparks_;
+    std::array<QPolygonF, kSparks> spark_points_;
+    Metrics::Snapshot last_;
+    bool has_last_{};
+    int text_width_{};
+    int line_height_{};
+    QSize size_;
+};
@@ -0,0 +1,360 @@
+#include "ThumbnailCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <spdlog/spdlog.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+
+namespace {
+constexpr char kMagic[8] = {'Q', 'P', 'T', 'H', 'U', 'M', 'B', '\0'};
+constexpr uint32_t kVersion = 1;
+// 像素从第二页开始，header 改动不影响像素对齐
+constexpr size_t kPixelOffset = 4096;
+constexpr int kMaxPacketsPerThumb = 64;
+
+int interrupted(void *opaque) {
+    return static_cast<std::stop_token *>(opaque)->stop_requested();
+}
+
+void lowerPriority() {
+#ifdef __linux__
+    // Linux 的 nice 值是按线程算的，只影响当前这个后台线程
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
+}
+}
+
+struct ThumbnailCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t pixelOffset;
+    // 媒体文件的大小和修改时间，任何一个变了缓存就作废
+    uint64_t mediaSize;
+    int64_t mediaMtime;
+    uint32_t intervalMs;
+    uint32_t thumbWidth;
+    uint32_t thumbHeight;
+    uint32_t columns;
+    uint32_t count;
+    // 从 0 开始连续生成，已经写好的张数
+    uint32_t generated;
+
+    size_t stride() const {
+        return static_cast<size_t>(thumbWidth) * columns * 4;
+    }
+
+    size_t fileSize() const {
+        size_t rows = (count + columns - 1) / columns;
+        return pixelOffset + stride() * thumbHeight * rows;
+    }
+
+    std::atomic_ref<uint32_t> done() {
+        return std::atomic_ref<uint32_t>(generated);
+    }
+};
+
+ThumbnailCache::ThumbnailCache() : ThumbnailCache(Options{}) {}
+
+ThumbnailCache::ThumbnailCache(Options options) : options_(options) {}
+
+ThumbnailCache::~ThumbnailCache() {
+    Close();
+}
+
+void ThumbnailCache::Open(const std::string &url) {
+    Close();
+    url_ = url;
+    job_ = std::jthread([this](std::stop_token token) {
+        run(token);
+    });
+}
+
+void ThumbnailCache::Close() {
+    job_ = {};
+    if (!url_.empty()) {
+        auto s = stats();
+        spdlog::info("thumbnails closed: {}/{} ({:.1f}/s) hits {} misses {}",
+                     s.generated, s.total, s.thumbsPerSecond, s.hits,
+                     s.misses);
+    }
+    unmap();
+    url_.clear();
+    generated_now_ = 0;
+    generate_us_ = 0;
+    hits_ = 0;
+    misses_ = 0;
+    from_disk_ = false;
+}
+
+void ThumbnailCache::unmap() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (map_) {
+        munmap(map_, map_size_);
+    }
+    map_ = nullptr;
+    map_size_ = 0;
+    header_ = nullptr;
+}
+
+bool ThumbnailCache::mapExisting(const std::string &path, uint64_t size,
+                                 int64_t mtime) {
+    int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+        return false;
+    }
+    Header header{};
+    bool valid = ::pread(fd, &header, sizeof(header), 0) ==
+                 static_cast<ssize_t>(sizeof(header)) &&
+                 std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+                 header.version == kVersion &&
+                 header.pixelOffset == kPixelOffset &&
+                 header.mediaSize == size && header.mediaMtime == mtime &&
+                 header.intervalMs ==
+                 static_cast<uint32_t>(options_.intervalMs) &&
+                 header.thumbWidth == static_cast<uint32_t>(options_.width) &&
+                 header.columns == static_cast<uint32_t>(options_.columns) &&
+                 header.generated <= header.count;
+    // 截断的文件也当作无效
+    struct stat st{};
+    valid = valid && ::fstat(fd, &st) == 0 &&
+            static_cast<size_t>(st.st_size) >= header.fileSize();
+    if (!valid) {
+        ::close(fd);
+        return false;
+    }
+    size_t map_size = header.fileSize();
+    void *map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                     0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    map_ = static_cast<uint8_t *>(map);
+    map_size_ = map_size;
+    header_ = reinterpret_cast<Header *>(map_);
+    return true;
+}
+
+bool ThumbnailCache::mapNew(const std::string &path, uint64_t size,
+                            int64_t mtime, int64_t duration_ms,
+                            int src_width, int src_height) {
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.pixelOffset = kPixelOffset;
+    header.mediaSize = size;
+    header.mediaMtime = mtime;
+    header.intervalMs = options_.intervalMs;
+    header.thumbWidth = options_.width;
+    // 保持宽高比，高度取偶数
+    header.thumbHeight = std::max(
+        2, options_.width * src_height / std::max(src_width, 1) & ~1);
+    header.columns = options_.columns;
+    header.count = static_cast<uint32_t>(
+        duration_ms / options_.intervalMs + 1);
+    size_t map_size = header.fileSize();
+
+    void *map = MAP_FAILED;
+    if (!path.empty()) {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0 && ::ftruncate(fd, static_cast<off_t>(map_size)) == 0) {
+            map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       fd, 0);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+    if (map == MAP_FAILED) {
+        // 网络流或者目录不可写，只放在内存里
+        spdlog::warn("thumbnails: no cache file for {}", url_);
+        map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED) {
+            return false;
+        }
+    }
+    // 先写完整的 header 再公开给 Lookup
+    std::memcpy(map, &header, sizeof(header));
+    std::lock_guard<std::mutex> lock(mtx_);
+    map_ = static_cast<uint8_t *>(map);
+    map_size_ = map_size;
+    header_ = reinterpret_cast<Header *>(map_);
+    return true;
+}
+
+void ThumbnailCache::run(std::stop_token token) {
+    lowerPriority();
+
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    std::string path;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (fs::is_regular_file(url_, ec)) {
+        path = url_ + ".thumbs";
+        size = fs::file_size(url_, ec);
+        mtime = fs::last_write_time(url_, ec).time_since_epoch().count();
+        if (mapExisting(path, size, mtime) &&
+            header_->done().load() == header_->count) {
+            from_disk_ = true;
+            spdlog::info("thumbnails: cache hit {}", path);
+            return;
+        }
+    }
+
+    AVFormatContext *format_ctx = avformat_alloc_context();
+    format_ctx->interrupt_callback = {interrupted, &token};
+    if (avformat_open_input(&format_ctx, url_.c_str(), nullptr, nullptr) !=
+        0) {
+        spdlog::error("thumbnails: open {} failed", url_);
+        return;
+    }
+    int stream = -1;
+    if (avformat_find_stream_info(format_ctx, nullptr) >= 0) {
+        stream = av_find_best_stream(format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1,
+                                     nullptr, 0);
+    }
+    if (stream >= 0 && format_ctx->duration > 0) {
+        AVCodecParameters *par = format_ctx->streams[stream]->codecpar;
+        if (header_ || mapNew(path, size, mtime,
+                              format_ctx->duration / 1000, par->width,
+                              par->height)) {
+            generate(token, format_ctx, stream);
+        }
+    }
+    avformat_close_input(&format_ctx);
+}
+
+void ThumbnailCache::generate(std::stop_token const &token,
+                              AVFormatContext *format_ctx, int stream) {
+    for (unsigned i = 0; i < format_ctx->nb_streams; ++i) {
+        if (static_cast<int>(i) != stream) {
+            format_ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+    AVStream *video = format_ctx->streams[stream];
+    const AVCodec *codec = avcodec_find_decoder(video->codecpar->codec_id);
+    AVCodecContext *codec_ctx = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(codec_ctx, video->codecpar);
+    codec_ctx->skip_frame = AVDISCARD_NONKEY;
+    // 解码器支持时直接按 1/2^n 分辨率解码，缩略图不需要全尺寸
+    int lowres = 0;
+    while (lowres < codec->max_lowres &&
+           (video->codecpar->width >> (lowres + 1)) >= options_.width) {
+        lowres++;
+    }
+    codec_ctx->lowres = lowres;
+    // 只占一个核
+    codec_ctx->thread_count = 1;
+    if (avcodec_open2(codec_ctx, codec, nullptr) != 0) {
+        avcodec_free_context(&codec_ctx);
+        return;
+    }
+
+    Header &header = *header_;
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    SwsContext *sws = nullptr;
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t i = header.done().load(); i < header.count &&
+                                             !token.stop_requested(); ++i) {
+        int64_t target = av_rescale_q(
+            static_cast<int64_t>(i) * header.intervalMs, {1, 1000},
+            video->time_base);
+        if (av_seek_frame(format_ctx, stream, target, AVSEEK_FLAG_BACKWARD) >=
+            0) {
+            avcodec_flush_buffers(codec_ctx);
+            bool got = false;
+            for (int n = 0; n < kMaxPacketsPerThumb && !got; ++n) {
+                int ret = av_read_frame(format_ctx, packet);
+                if (ret < 0) {
+                    avcodec_send_packet(codec_ctx, nullptr);
+                } else if (packet->stream_index == stream) {
+                    avcodec_send_packet(codec_ctx, packet);
+                }
+                av_packet_unref(packet);
+                got = avcodec_receive_frame(codec_ctx, frame) == 0;
+                if (ret < 0) {
+                    break;
+                }
+            }
+            if (got) {
+                sws = sws_getCachedContext(
+                    sws, frame->width, frame->height,
+                    static_cast<AVPixelFormat>(frame->format),
+                    header.thumbWidth, header.thumbHeight, AV_PIX_FMT_BGRA,
+                    SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+                int stride = static_cast<int>(header.stride());
+                uint8_t *dst = map_ + header.pixelOffset +
+                               header.stride() * header.thumbHeight *
+                               (i / header.columns) +
+                               static_cast<size_t>(header.thumbWidth) * 4 *
+                               (i % header.columns);
+                sws_scale(sws, frame->data, frame->linesize, 0,
+                          frame->height, &dst, &stride);
+                av_frame_unref(frame);
+            }
+        }
+        // 解不出来的位置留黑，不再重试
+        header.done().store(i + 1, std::memory_order_release);
+        generated_now_++;
+        generate_us_ = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin).count();
+    }
+    sws_freeContext(sws);
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&codec_ctx);
+    msync(map_, map_size_, MS_ASYNC);
+}
+
+std::optional<ThumbnailCache::Thumb> ThumbnailCache::Lookup(int64_t time_ms) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!header_ || time_ms < 0) {
+        misses_++;
+        return std::nullopt;
+    }
+    uint32_t i = static_cast<uint32_t>(time_ms / header_->intervalMs);
+    if (i >= header_->done().load(std::memory_order_acquire)) {
+        misses_++;
+        return std::nullopt;
+    }
+    hits_++;
+    const uint8_t *pixels = map_ + header_->pixelOffset +
+                            header_->stride() * header_->thumbHeight *
+                            (i / header_->columns) +
+                            static_cast<size_t>(header_->thumbWidth) * 4 *
+                            (i % header_->columns);
+    return Thumb{pixels, static_cast<int>(header_->thumbWidth),
+                 static_cast<int>(header_->thumbHeight),
+                 static_cast<int>(header_->stride())};
+}
+
+ThumbnailCache::Stats ThumbnailCache::stats() const {
+    uint32_t generated = 0;
+    uint32_t total = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (header_) {
+            generated = header_->done().load();
+            total = header_->count;
+        }
+    }
+    int64_t us = generate_us_;
+    double rate = us > 0 ? generated_now_ * 1e6 / us : 0.0;
+    return {generated, total, rate, hits_, misses_, from_disk_};
+}
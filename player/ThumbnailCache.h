@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+
+struct AVFormatContext;
+
+// 进度条悬停预览用的缩略图。后台低优先级线程另开一个 demuxer，
+// 每隔 interval 只解一个关键帧（AVDISCARD_NONKEY + lowres），缩放后
+// 拼进一张 sprite sheet。sheet 存在媒体文件旁边的 <media>.thumbs 里，
+// 文件头后面直接是 BGRA 像素，mmap 之后按偏移取图，不需要解析
+class ThumbnailCache {
+public:
+    struct Options {
+        int intervalMs = 10000;
+        int width = 160;
+        int columns = 10;
+    };
+
+    // 指向 mmap 里的像素，Close 之前有效
+    struct Thumb {
+        const uint8_t *pixels;
+        int width;
+        int height;
+        int stride;
+    };
+
+    struct Stats {
+        uint32_t generated;
+        uint32_t total;
+        double thumbsPerSecond;
+        uint64_t hits;
+        uint64_t misses;
+        bool fromDisk; // 缓存文件已经完整，没有解码
+    };
+
+    ThumbnailCache();
+    explicit ThumbnailCache(Options options);
+    ~ThumbnailCache();
+
+    ThumbnailCache(const ThumbnailCache &) = delete;
+    ThumbnailCache &operator=(const ThumbnailCache &) = delete;
+
+    // 立即返回，缓存文件的校验和生成都在后台线程
+    void Open(const std::string &url);
+    void Close();
+
+    // time_ms 所在区间的缩略图，还没生成时返回空
+    std::optional<Thumb> Lookup(int64_t time_ms);
+
+    const std::string &url() const {
+        return url_;
+    }
+
+    Stats stats() const;
+
+private:
+    struct Header;
+
+    void run(std::stop_token token);
+    bool mapExisting(const std::string &path, uint64_t size, int64_t mtime);
+    bool mapNew(const std::string &path, uint64_t size, int64_t mtime,
+                int64_t duration_ms, int src_width, int src_height);
+    void generate(std::stop_token const &token, AVFormatContext *format_ctx,
+                  int stream);
+    void unmap();
+
+    Options options_;
+    std::string url_;
+
+    mutable std::mutex mtx_;
+    uint8_t *map_{};
+    size_t map_size_{};
+    Header *header_{};
+
+    std::atomic<uint32_t> generated_now_{0};
+    std::atomic<int64_t> generate_us_{0};
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic_bool from_disk_{false};
+    std::jthread job_;
+};
@@ -0,0 +1,192 @@
+#include "Tracer.h"
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+std::atomic_bool Tracer::enabled_{false};
+
+namespace {
+struct Event {
+    const char *name;
+    int64_t tsUs;
+    int64_t durUs;
+    int64_t pts;
+    int64_t seq;
+    char phase;
+};
+
+// 一个线程的环形缓冲。只有所属线程写，导出前先关掉记录并等 writing
+// 清掉。线程退出后缓冲留到下次 Start 清空，再分给新线程，不释放，
+// 写线程手里的指针一直有效
+struct ThreadBuffer {
+    std::unique_ptr<Event[]> events{new Event[Tracer::kCapacity]};
+    std::atomic<uint64_t> head{0};
+    std::atomic_bool writing{false};
+    bool owned{true};
+    int tid{};
+    std::string name;
+};
+
+// 缓冲个数的上限，超过的线程不记
+constexpr size_t kMaxThreads = 64;
+
+std::mutex g_mtx;
+std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+int g_next_tid = 1;
+
+// 线程退出时把缓冲还回去
+struct ThreadSlot {
+    ThreadBuffer *buffer{};
+    const char *name{};
+
+    ~ThreadSlot() {
+        if (buffer) {
+            std::lock_guard<std::mutex> lock(g_mtx);
+            buffer->owned = false;
+        }
+    }
+};
+
+thread_local ThreadSlot t_slot;
+
+ThreadBuffer *attach() {
+    std::lock_guard<std::mutex> lock(g_mtx);
+    ThreadBuffer *buffer = nullptr;
+    for (auto &candidate : g_buffers) {
+        // 上一个线程的事件还没导出的不能复用
+        if (!candidate->owned && candidate->head == 0) {
+            buffer = candidate.get();
+            break;
+        }
+    }
+    if (!buffer) {
+        if (g_buffers.size() >= kMaxThreads) {
+            return nullptr;
+        }
+        buffer = g_buffers.emplace_back(
+            std::make_unique<ThreadBuffer>()).get();
+    }
+    buffer->owned = true;
+    buffer->tid = g_next_tid++;
+    buffer->name = t_slot.name ? t_slot.name : "";
+    t_slot.buffer = buffer;
+    return buffer;
+}
+
+// 调用前 enabled_ 已经是 false，等正在写的线程写完
+void drain() {
+    for (auto &buffer : g_buffers) {
+        while (buffer->writing.load()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void writeArgs(FILE *file, Event const &event) {
+    if (event.pts < 0 && event.seq < 0) {
+        return;
+    }
+    const char *sep = "";
+    fputs(",\"args\":{", file);
+    if (event.pts >= 0) {
+        fprintf(file, "\"pts\":%lld", static_cast<long long>(event.pts));
+        sep = ",";
+    }
+    if (event.seq >= 0) {
+        fprintf(file, "%s\"seq\":%lld", sep,
+                static_cast<long long>(event.seq));
+    }
+    fputc('}', file);
+}
+}
+
+void Tracer::SetThreadName(const char *name) {
+    t_slot.name = name;
+    if (t_slot.buffer) {
+        std::lock_guard<std::mutex> lock(g_mtx);
+        t_slot.buffer->name = name;
+    }
+}
+
+void Tracer::record(const char *name, char phase, int64_t ts_us,
+                    int64_t dur_us, int64_t pts, int64_t seq) {
+    ThreadBuffer *buffer = t_slot.buffer;
+    if (!buffer && !(buffer = attach())) {
+        return;
+    }
+    // 先标记再检查开关，和 Stop 里先关开关再等标记配对，
+    // 两边都是 seq_cst，不会在导出时还往里写
+    buffer->writing.store(true);
+    if (enabled_.load()) {
+        uint64_t head = buffer->head.load(std::memory_order_relaxed);
+        buffer->events[head % kCapacity] = {name, ts_us, dur_us, pts, seq,
+                                            phase};
+        buffer->head.store(head + 1, std::memory_order_release);
+    }
+    buffer->writing.store(false);
+}
+
+void Tracer::Start() {
+    std::lock_guard<std::mutex> lock(g_mtx);
+    enabled_ = false;
+    drain();
+    for (auto &buffer : g_buffers) {
+        buffer->head = 0;
+    }
+    enabled_ = true;
+    spdlog::info("tracing started");
+}
+
+bool Tracer::Stop(const std::string &path) {
+    std::lock_guard<std::mutex> lock(g_mtx);
+    enabled_ = false;
+    drain();
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+        spdlog::error("cannot write trace to {}", path);
+        return false;
+    }
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+    const char *sep = "";
+    size_t total = 0;
+    size_t lost = 0;
+    for (auto &buffer : g_buffers) {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        if (head == 0) {
+            continue;
+        }
+        fprintf(file,
+                "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,"
+                "\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                sep, buffer->tid, buffer->name.c_str());
+        sep = ",";
+        uint64_t begin = head > kCapacity ? head - kCapacity : 0;
+        lost += begin;
+        for (uint64_t i = begin; i < head; ++i) {
+            Event const &event = buffer->events[i % kCapacity];
+            fprintf(file,
+                    ",{\"ph\":\"%c\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%lld",
+                    event.phase, event.name, buffer->tid,
+                    static_cast<long long>(event.tsUs));
+            if (event.phase == 'X') {
+                fprintf(file, ",\"dur\":%lld",
+                        static_cast<long long>(event.durUs));
+            } else {
+                // 时刻事件只画在所在线程上
+                fputs(",\"s\":\"t\"", file);
+            }
+            writeArgs(file, event);
+            fputc('}', file);
+        }
+        total += head - begin;
+    }
+    fputs("]}\n", file);
+    fclose(file);
+    spdlog::info("wrote {} trace events to {}, {} overwritten", total, path,
+                 lost);
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// 管线活动的追踪，导出成 Chrome trace_event JSON，用 Perfetto 或者
+// chrome://tracing 打开。每个线程记在自己的环形缓冲里，写满了覆盖
+// 最旧的，只有写线程自己改，记录时不加锁。关着的时候 Span 只读一个
+// 原子标志。PLAYER_TRACE=<path> 时播放器从启动开始记，退出时写文件
+class Tracer {
+public:
+    // 记录一段耗时，名字要是字符串常量，导出时才去读。pts 是毫秒，
+    // seq 是所在线程处理的第几个包/帧，-1 不输出
+    class Span {
+    public:
+        explicit Span(const char *name, int64_t pts = -1, int64_t seq = -1)
+            : name_(name), pts_(pts), seq_(seq), active_(Enabled()) {
+            if (active_) {
+                begin_us_ = NowUs();
+            }
+        }
+
+        ~Span() {
+            if (active_) {
+                complete(name_, begin_us_, NowUs() - begin_us_, pts_, seq_);
+            }
+        }
+
+        // 开始时还不知道 pts 的，比如读包
+        void SetPts(int64_t pts, int64_t seq = -1) {
+            pts_ = pts;
+            seq_ = seq;
+        }
+
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+
+    private:
+        const char *name_;
+        int64_t pts_;
+        int64_t seq_;
+        int64_t begin_us_{};
+        bool active_;
+    };
+
+    static bool Enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // 一个时刻，比如丢帧
+    static void Instant(const char *name, int64_t pts = -1,
+                        int64_t seq = -1) {
+        if (Enabled()) {
+            record(name, 'i', NowUs(), 0, pts, seq);
+        }
+    }
+
+    // 导出时线程的名字，在线程开始时调用一次
+    static void SetThreadName(const char *name);
+
+    // 清掉之前记的，开始记录
+    static void Start();
+    // 停止记录，把所有线程缓冲里的事件写成 JSON
+    static bool Stop(const std::string &path);
+
+    static int64_t NowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 每个线程保留最近的这么多条
+    static constexpr int kCapacity = 1 << 15;
+
+private:
+    static void complete(const char *name, int64_t begin_us, int64_t dur_us,
+                         int64_t pts, int64_t seq) {
+        record(name, 'X', begin_us, dur_us, pts, seq);
+    }
+
+    static void record(const char *name, char phase, int64_t ts_us,
+                       int64_t dur_us, int64_t pts, int64_t seq);
+
+    static std::atomic_bool enabled_;
+};
@@ -1,11 +1,13 @@
 #include <QApplication>
 #include "MainWindow.h"
-#include <spdlog/spdlog.h>
+#include "Log.h"
 
 int main(int argc, char *argv[]) {
+    InitLogging();
     QApplication a(argc, argv);
     MainWindow w{};
     w.show();
-    spdlog::set_level(spdlog::level::warn);
-    return QApplication::exec();
+    int ret = QApplication::exec();
+    ShutdownLogging();
+    return ret;
 }
@@ -0,0 +1,121 @@
+#include "ImpairedAvio.h"
+#include <algorithm>
+#include <thread>
+#include <spdlog/spdlog.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+using namespace std::chrono;
+
+ImpairedAvio::ImpairedAvio(std::unique_ptr<AvioSource> inner,
+                           Impairment impairment)
+    : inner_(std::move(inner)), impairment_(impairment),
+      rng_(impairment.seed), start_(Clock::now()), next_(start_) {}
+
+ImpairedAvio::~ImpairedAvio() = default;
+
+std::unique_ptr<ImpairedAvio>
+ImpairedAvio::Wrap(std::unique_ptr<AvioSource> inner, Impairment impairment) {
+    if (!inner) {
+        return nullptr;
+    }
+    impairment.chunk = std::max(impairment.chunk, 512);
+    std::unique_ptr<ImpairedAvio> source(
+        new ImpairedAvio(std::move(inner), impairment));
+    // 缓冲和一块数据一样大，每次 read 都要过一遍损伤
+    if (!source->initAvio(impairment.chunk)) {
+        return nullptr;
+    }
+    if (impairment.live) {
+        source->avio()->seekable = 0;
+    }
+    return source;
+}
+
+ImpairedAvio::Stats ImpairedAvio::stats() const {
+    return {bytes_, stalls_, slept_us_ / 1000.0, disconnected_};
+}
+
+void ImpairedAvio::sleepUntil(Clock::time_point until) {
+    auto now = Clock::now();
+    if (until <= now) {
+        return;
+    }
+    std::this_thread::sleep_until(until);
+    slept_us_ += duration_cast<microseconds>(Clock::now() - now).count();
+}
+
+int ImpairedAvio::read(uint8_t *buf, int size) {
+    if (disconnected_) {
+        return AVERROR(ECONNRESET);
+    }
+    if (pending_latency_) {
+        pending_latency_ = false;
+        sleepUntil(Clock::now() + milliseconds(impairment_.latencyMs));
+        next_ = Clock::now();
+    }
+    int want = std::min(size, impairment_.chunk);
+    if (impairment_.disconnectAfter) {
+        uint64_t left = impairment_.disconnectAfter -
+                        std::min<uint64_t>(bytes_,
+                                           impairment_.disconnectAfter);
+        if (left == 0) {
+            spdlog::info("impaired avio: disconnect after {} bytes",
+                         bytes_.load());
+            disconnected_ = true;
+            return AVERROR(ECONNRESET);
+        }
+        want = static_cast<int>(std::min<uint64_t>(want, left));
+    }
+    if (impairment_.bandwidth > 0) {
+        auto cost = duration_cast<Clock::duration>(
+            duration<double>(want / impairment_.bandwidth));
+        if (impairment_.live) {
+            // 直播的数据到 start_ + 字节数 / 码率才产生
+            auto produced = duration_cast<Clock::duration>(duration<double>(
+                (bytes_ + want) / impairment_.bandwidth));
+            sleepUntil(start_ + produced);
+        } else {
+            // 令牌桶，读得慢了也不攒额度
+            next_ = std::max(next_, Clock::now()) + cost;
+            sleepUntil(next_);
+        }
+    }
+    if (impairment_.jitterMs > 0) {
+        std::uniform_int_distribution<int> jitter(0, impairment_.jitterMs);
+        sleepUntil(Clock::now() + milliseconds(jitter(rng_)));
+    }
+    if (impairment_.stallChance > 0) {
+        std::uniform_real_distribution<double> dice(0, 1);
+        if (dice(rng_) < impairment_.stallChance) {
+            stalls_++;
+            sleepUntil(Clock::now() + milliseconds(impairment_.stallMs));
+        }
+    }
+    int n = avio_read(inner_->avio(), buf, want);
+    if (n > 0) {
+        bytes_ += n;
+    }
+    return n;
+}
+
+int64_t ImpairedAvio::seek(int64_t offset, int whence) {
+    if (impairment_.live) {
+        return AVERROR(ENOSYS);
+    }
+    if (disconnected_) {
+        return AVERROR(ECONNRESET);
+    }
+    if (whence == AVSEEK_SIZE) {
+        return avio_size(inner_->avio());
+    }
+    int64_t before = avio_tell(inner_->avio());
+    int64_t pos = avio_seek(inner_->avio(), offset, whence);
+    if (pos >= 0 && pos != before) {
+        // 跳到别处相当于重新发一次请求
+        pending_latency_ = true;
+    }
+    return pos;
+}
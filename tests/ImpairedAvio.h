@@ -0,0 +1,70 @@
+#pragma once
+#include "AvioSource.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+
+// 测试用的网络损伤模拟：包在一个本地 AvioSource 外面，按固定种子注入
+// 带宽上限、往返延迟、抖动、卡顿和断线，同样的参数每次跑出同样的
+// 时间线。通过 AvioSource::SetFactory 装进播放器，走的是正式的读路径
+class ImpairedAvio : public AvioSource {
+public:
+    struct Impairment {
+        uint32_t seed = 1;
+        // 字节/秒，0 不限速
+        double bandwidth = 0;
+        // 打开和每次 seek 后第一次读要等的往返时间
+        int latencyMs = 0;
+        // 每块数据额外等 0~jitterMs
+        int jitterMs = 0;
+        int chunk = 16 * 1024;
+        // 每块数据卡住 stallMs 的概率
+        double stallChance = 0;
+        int stallMs = 0;
+        // 读够这么多字节后断线，之后一直返回 ECONNRESET，0 不断
+        uint64_t disconnectAfter = 0;
+        // 模拟直播：不能 seek、没有大小，数据按 bandwidth 匀速产生，
+        // 读得慢了可以一口气追上，但不会比产生的快
+        bool live = false;
+    };
+
+    struct Stats {
+        uint64_t bytes;
+        uint64_t stalls;
+        double sleptMs;
+        bool disconnected;
+    };
+
+    ~ImpairedAvio() override;
+
+    static std::unique_ptr<ImpairedAvio>
+    Wrap(std::unique_ptr<AvioSource> inner, Impairment impairment);
+
+    Stats stats() const;
+
+protected:
+    int read(uint8_t *buf, int size) override;
+    int64_t seek(int64_t offset, int whence) override;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    ImpairedAvio(std::unique_ptr<AvioSource> inner, Impairment impairment);
+
+    void sleepUntil(Clock::time_point until);
+
+    std::unique_ptr<AvioSource> inner_;
+    Impairment impairment_;
+    std::mt19937 rng_;
+    Clock::time_point start_;
+    // 限速时下一块数据最早能拿到的时刻
+    Clock::time_point next_;
+    bool pending_latency_{true};
+
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> stalls_{0};
+    std::atomic<int64_t> slept_us_{0};
+    std::atomic_bool disconnected_{false};
+};
@@ -0,0 +1,128 @@
+// 音频 sink：NullAudioSink 按实时速率消费，查询再频繁时钟也不变慢，
+// 超出容量的部分丢掉，暂停时不消费；WavFileSink 写出的头和长度对得上
+// 用法: tests_audiosink，全部通过返回 0
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "check.h"
+#include "AudioSink.h"
+
+using std::cout;
+using std::endl;
+using Clock = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+// 44.1kHz 16bit 双声道
+constexpr int kRate = 44100;
+constexpr int kBytesPerSecond = kRate * 2 * 2;
+constexpr int kToleranceMs = 15;
+
+int64_t bytesFor(int64_t ms) {
+    return ms * kBytesPerSecond / 1000;
+}
+
+bool near(int64_t value, int64_t expected) {
+    return std::llabs(value - expected) <= kToleranceMs;
+}
+
+void nullSinkClock() {
+    NullAudioSink sink;
+    sink.SetFormat(kRate, 16, 2);
+    std::vector<char> data(bytesFor(400));
+    sink.writeData(data.data(), data.size());
+    check(near(sink.bufferedMs(), 400), "buffered after write");
+
+    // 一直查询，每次间隔远小于一个字节的时长
+    auto begin = Clock::now();
+    uint64_t polls = 0;
+    while (Clock::now() - begin < 200ms) {
+        sink.bufferedMs();
+        polls++;
+    }
+    int64_t buffered = sink.bufferedMs();
+    int64_t played = sink.playedMs();
+    cout << polls << " polls: buffered " << buffered << "ms, played "
+         << played << "ms" << endl;
+    check(near(buffered, 200), "frequent polling does not slow the clock");
+    check(near(played, 200), "played time follows the wall clock");
+
+    sink.pause();
+    std::this_thread::sleep_for(100ms);
+    check(near(sink.bufferedMs(), buffered), "nothing consumed while paused");
+    sink.resume();
+
+    // 放完以后空转的时间不算播放
+    std::this_thread::sleep_for(300ms);
+    check(sink.bufferedMs() == 0, "drained");
+    check(near(sink.playedMs(), 400), "idle time is not played");
+}
+
+void nullSinkCapacity() {
+    NullAudioSink sink(500);
+    sink.SetFormat(kRate, 16, 2);
+    std::vector<char> data(bytesFor(800));
+    sink.writeData(data.data(), data.size());
+    check(near(sink.bufferedMs(), 500), "buffer holds its capacity");
+    check(std::llabs(sink.droppedBytes() - bytesFor(300)) <=
+          bytesFor(kToleranceMs), "overflow is dropped");
+}
+
+uint32_t readLe(const uint8_t *p, int bytes) {
+    uint32_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= static_cast<uint32_t>(p[i]) << (8 * i);
+    }
+    return value;
+}
+
+void wavSink() {
+    std::string path = "/tmp/tests_audiosink.wav";
+    std::vector<char> data(1000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(i);
+    }
+    {
+        WavFileSink sink(path);
+        sink.SetFormat(kRate, 16, 2);
+        sink.writeData(data.data(), data.size());
+        // 同样的格式接着写同一个文件
+        sink.SetFormat(kRate, 16, 2);
+        sink.writeData(data.data(), data.size());
+    }
+    FILE *file = fopen(path.c_str(), "rb");
+    std::vector<uint8_t> wav(4096);
+    size_t size = file ? fread(wav.data(), 1, wav.size(), file) : 0;
+    if (file) {
+        fclose(file);
+    }
+    std::remove(path.c_str());
+    check(size == 44 + 2 * data.size(), "file length");
+    if (size < 44) {
+        return;
+    }
+    const uint8_t *h = wav.data();
+    check(!std::memcmp(h, "RIFF", 4) && !std::memcmp(h + 8, "WAVEfmt ", 8) &&
+          !std::memcmp(h + 36, "data", 4), "chunk ids");
+    check(readLe(h + 4, 4) == size - 8, "RIFF length");
+    check(readLe(h + 16, 4) == 16 && readLe(h + 20, 2) == 1 &&
+          readLe(h + 22, 2) == 2 && readLe(h + 24, 4) == kRate &&
+          readLe(h + 28, 4) == kBytesPerSecond && readLe(h + 32, 2) == 4 &&
+          readLe(h + 34, 2) == 16, "fmt chunk");
+    check(readLe(h + 40, 4) == 2 * data.size(), "data length");
+    check(!std::memcmp(h + 44, data.data(), data.size()) &&
+          !std::memcmp(h + 44 + data.size(), data.data(), data.size()),
+          "samples written in order");
+}
+
+int main() {
+    nullSinkClock();
+    nullSinkCapacity();
+    wavSink();
+    return checkResult();
+}
@@ -0,0 +1,130 @@
+// 本地文件 demux 对比：默认 file 协议 vs MmapAvio
+// 统计整文件 av_read_frame 的吞吐、随机 seek 耗时，以及 /proc/self/io
+// 里的 syscr（read 类系统调用次数）
+// 用法: tests_aviobench [file] [rounds]，默认 /home/awe/Videos/oceans.mp4
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include "MmapAvio.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+using std::cout;
+using std::endl;
+using std::string;
+using Clock = std::chrono::steady_clock;
+
+uint64_t readSyscalls() {
+    std::ifstream io("/proc/self/io");
+    string key;
+    uint64_t value;
+    while (io >> key >> value) {
+        if (key == "syscr:") {
+            return value;
+        }
+    }
+    return 0;
+}
+
+struct Result {
+    double demux_ms = 0;
+    double seek_ms = 0;
+    uint64_t syscalls = 0;
+    uint64_t bytes = 0;
+    int packets = 0;
+};
+
+using Opener = std::function<int(AVFormatContext *&, string const &)>;
+using Closer = std::function<void(AVFormatContext *&)>;
+
+bool run(string const &filename, Opener const &open, Closer const &close,
+         Result &result) {
+    uint64_t syscalls = readSyscalls();
+    AVFormatContext *ctx = nullptr;
+    if (open(ctx, filename) != 0) {
+        return false;
+    }
+    if (avformat_find_stream_info(ctx, nullptr) < 0) {
+        close(ctx);
+        return false;
+    }
+
+    auto begin = Clock::now();
+    AVPacket *packet = av_packet_alloc();
+    while (av_read_frame(ctx, packet) >= 0) {
+        result.packets++;
+        result.bytes += packet->size;
+        av_packet_unref(packet);
+    }
+    auto end = Clock::now();
+    result.demux_ms += std::chrono::duration<double, std::milli>(
+        end - begin).count();
+
+    // 随机 seek 后读一个包
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int64_t> dist(
+        0, std::max<int64_t>(ctx->duration * 95 / 100, 1));
+    begin = Clock::now();
+    for (int i = 0; i < 100; ++i) {
+        if (avformat_seek_file(ctx, -1, INT64_MIN, dist(rng), INT64_MAX,
+                               0) >= 0 && av_read_frame(ctx, packet) >= 0) {
+            av_packet_unref(packet);
+        }
+    }
+    result.seek_ms += std::chrono::duration<double, std::milli>(
+        Clock::now() - begin).count();
+    av_packet_free(&packet);
+    close(ctx);
+    result.syscalls += readSyscalls() - syscalls;
+    return true;
+}
+
+void report(string const &name, Result const &result, int rounds) {
+    double mb = result.bytes / 1024.0 / 1024.0;
+    cout << name << ": demux " << result.demux_ms / rounds << " ms ("
+        << mb / (result.demux_ms / 1000) << " MB/s, " << result.packets / rounds
+        << " packets), 100 seeks " << result.seek_ms / rounds
+        << " ms, read syscalls " << result.syscalls / rounds << endl;
+}
+
+int main(int argc, char *argv[]) {
+    string filename = argc > 1 ? argv[1] : "/home/awe/Videos/oceans.mp4";
+    int rounds = argc > 2 ? std::stoi(argv[2]) : 5;
+
+    Opener file_open = [](AVFormatContext *&ctx, string const &url) {
+        return avformat_open_input(&ctx, url.c_str(), nullptr, nullptr);
+    };
+    Closer file_close = [](AVFormatContext *&ctx) {
+        avformat_close_input(&ctx);
+    };
+    Opener mmap_open = [](AVFormatContext *&ctx, string const &url) {
+        return AvioSource::OpenInput(ctx, url, MmapAvio::Open(url));
+    };
+    Closer mmap_close = [](AVFormatContext *&ctx) {
+        AvioSource::CloseInput(ctx);
+    };
+
+    // 先各跑一遍预热 page cache，后面比较的是协议本身的开销
+    Result warmup;
+    if (!run(filename, file_open, file_close, warmup) ||
+        !run(filename, mmap_open, mmap_close, warmup)) {
+        cout << "open " << filename << " failed" << endl;
+        return -1;
+    }
+
+    Result file;
+    Result mapped;
+    for (int i = 0; i < rounds; ++i) {
+        run(filename, file_open, file_close, file);
+        run(filename, mmap_open, mmap_close, mapped);
+    }
+    report("file protocol", file, rounds);
+    report("mmap avio    ", mapped, rounds);
+    return 0;
+}
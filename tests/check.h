@@ -0,0 +1,17 @@
+#pragma once
+// 自检测试共用：每项打印 ok/FAIL，main 最后返回 checkResult()
+#include <iostream>
+#include <string>
+
+inline int g_failures = 0;
+
+inline void check(bool ok, const std::string &what) {
+    std::cout << (ok ? "ok   " : "FAIL ") << what << std::endl;
+    if (!ok) {
+        ++g_failures;
+    }
+}
+
+inline int checkResult() {
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,247 @@
+// CachingAvio 和 HttpCache：本进程里起一个支持 Range 的 http 服务器，
+// 统计请求数和发出的字节，检查往回 seek、重新打开、部分缓存续传都不再
+// 重复下载，以及超出预算时按最近使用淘汰。缓存目录写不进去时打开失败，
+// 不能卡住
+// 用法: tests_httpcache，全部通过返回 0
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <netinet/in.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "check.h"
+#include "CachingAvio.h"
+#include "HttpCache.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+using std::cout;
+using std::endl;
+using std::string;
+using namespace std::chrono_literals;
+
+constexpr size_t kFileSize = 16 * 1024 * 1024;
+constexpr int kChunk = 64 * 1024;
+constexpr int64_t kMB = 1024 * 1024;
+
+std::vector<uint8_t> g_data;
+std::atomic<int> g_requests{0};
+std::atomic<uint64_t> g_sent{0};
+
+// 一个连接上可以有多个请求，/norange 不支持 Range 也不给 Accept-Ranges
+void serve(int fd) {
+    string pending;
+    char buf[4096];
+    while (true) {
+        size_t end;
+        while ((end = pending.find("\r\n\r\n")) == string::npos) {
+            ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) {
+                ::close(fd);
+                return;
+            }
+            pending.append(buf, n);
+        }
+        string request = pending.substr(0, end);
+        pending.erase(0, end + 4);
+        g_requests++;
+
+        bool ranges = request.find(" /norange") == string::npos;
+        int64_t begin = 0;
+        auto range = request.find("Range: bytes=");
+        if (ranges && range != string::npos) {
+            begin = std::stoll(request.substr(range + 13));
+        }
+        int64_t last = kFileSize - 1;
+        auto dash = request.find('-', range);
+        if (ranges && range != string::npos && dash != string::npos &&
+            std::isdigit(static_cast<unsigned char>(request[dash + 1]))) {
+            last = std::min<int64_t>(last,
+                                     std::stoll(request.substr(dash + 1)));
+        }
+        string header;
+        if (begin >= static_cast<int64_t>(kFileSize)) {
+            header = "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                     "Content-Length: 0\r\n\r\n";
+            last = begin - 1;
+        } else if (range != string::npos && ranges) {
+            header = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " +
+                     std::to_string(begin) + "-" + std::to_string(last) +
+                     "/" + std::to_string(kFileSize) + "\r\n";
+        } else {
+            header = "HTTP/1.1 200 OK\r\n";
+        }
+        if (header.find("416") == string::npos) {
+            if (ranges) {
+                header += "Accept-Ranges: bytes\r\n";
+            }
+            header += "Content-Length: " + std::to_string(last - begin + 1) +
+                      "\r\n\r\n";
+        }
+        if (::send(fd, header.data(), header.size(), MSG_NOSIGNAL) < 0) {
+            break;
+        }
+        for (int64_t pos = begin; pos <= last;) {
+            ssize_t n = ::send(fd, g_data.data() + pos,
+                               std::min<int64_t>(kChunk, last - pos + 1),
+                               MSG_NOSIGNAL);
+            if (n <= 0) {
+                ::close(fd);
+                return;
+            }
+            pos += n;
+            g_sent += n;
+        }
+    }
+    ::close(fd);
+}
+
+int startServer() {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), len) != 0 ||
+        ::listen(fd, 16) != 0 ||
+        ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+        return -1;
+    }
+    std::thread([fd] {
+        while (true) {
+            int client = ::accept(fd, nullptr, nullptr);
+            if (client < 0) {
+                return;
+            }
+            std::thread(serve, client).detach();
+        }
+    }).detach();
+    return ntohs(addr.sin_port);
+}
+
+// 从 offset 读 len 字节并和原始数据比较
+bool readAt(CachingAvio &source, int64_t offset, int64_t len) {
+    if (avio_seek(source.avio(), offset, SEEK_SET) != offset) {
+        return false;
+    }
+    std::vector<uint8_t> buf(kChunk);
+    for (int64_t pos = offset; pos < offset + len;) {
+        int want = std::min<int64_t>(kChunk, offset + len - pos);
+        int n = avio_read(source.avio(), buf.data(), want);
+        if (n != want || std::memcmp(buf.data(), g_data.data() + pos, n)) {
+            return false;
+        }
+        pos += n;
+    }
+    return true;
+}
+
+int main() {
+    g_data.resize(kFileSize);
+    std::mt19937 rng(11);
+    for (auto &b : g_data) {
+        b = static_cast<uint8_t>(rng());
+    }
+    int port = startServer();
+    if (port < 0) {
+        cout << "listen failed" << endl;
+        return 1;
+    }
+    string base = "http://127.0.0.1:" + std::to_string(port);
+    string dir = "/tmp/tests_httpcache";
+    std::filesystem::remove_all(dir);
+    // 预算放得下一个文件，放不下两个
+    HttpCache cache({dir, kFileSize + kFileSize / 2});
+    string url = base + "/a.mp4";
+
+    {
+        auto source = CachingAvio::Open(url, cache);
+        check(source != nullptr, "open range-capable url");
+        if (!source) {
+            return 1;
+        }
+        check(readAt(*source, 0, 4 * kMB), "sequential read");
+        int requests = g_requests;
+        uint64_t sent = g_sent;
+        check(readAt(*source, 1 * kMB, 2 * kMB), "seek back");
+        check(g_requests == requests && g_sent == sent,
+              "seek back served from cache");
+        check(readAt(*source, 12 * kMB, kMB), "seek forward past a hole");
+        cout << "first open: " << g_requests << " requests, "
+             << g_sent / 1024 << " KB sent" << endl;
+    }
+
+    {
+        // 部分缓存：只为拿大小连一次，缺的 4-12MB 才下载
+        int requests = g_requests;
+        auto source = CachingAvio::Open(url, cache);
+        check(source && readAt(*source, 0, 4 * kMB) &&
+              readAt(*source, 12 * kMB, kMB), "reopen partial cache");
+        check(g_requests == requests + 1, "cached ranges need no request");
+        check(readAt(*source, 0, kFileSize), "fill the holes");
+        auto stats = source->stats();
+        cout << "hole fill: downloaded " << stats.missBytes / 1024
+             << " KB, from cache " << stats.hitBytes / 1024 << " KB" << endl;
+        // 缺的是 4-12MB 和 13-16MB
+        check(stats.missBytes == 11 * kMB, "only the holes were downloaded");
+    }
+
+    {
+        int requests = g_requests;
+        uint64_t sent = g_sent;
+        auto source = CachingAvio::Open(url, cache);
+        check(source && readAt(*source, 0, kFileSize) &&
+              readAt(*source, 5 * kMB, kMB), "reopen complete cache");
+        check(g_requests == requests && g_sent == sent,
+              "complete cache never touches the server");
+    }
+
+    {
+        auto source = CachingAvio::Open(base + "/norange.mp4", cache);
+        check(source == nullptr, "no range support is not cached");
+    }
+
+    {
+        auto source = CachingAvio::Open(base + "/b.mp4", cache);
+        check(source && readAt(*source, 0, kFileSize), "second url");
+    }
+    auto stats = cache.stats();
+    cout << "cache: hit " << stats.hitBytes / 1024 << " KB, miss "
+         << stats.missBytes / 1024 << " KB, evicted " << stats.evictedFiles
+         << ", disk " << stats.diskBytes / 1024 << " KB" << endl;
+    check(stats.evictedFiles == 1, "least recently used url evicted");
+    check(stats.diskBytes <= kFileSize + kFileSize / 2, "within budget");
+
+    {
+        // 目录的位置是个普通文件，root 也建不了里面的缓存文件
+        string blocked = "/tmp/tests_httpcache_blocked";
+        std::filesystem::remove_all(blocked);
+        fclose(fopen(blocked.c_str(), "w"));
+        auto done = std::async(std::launch::async, [&] {
+            HttpCache unwritable({blocked, kFileSize});
+            return unwritable.Open(url) == nullptr &&
+                   CachingAvio::Open(url, unwritable) == nullptr;
+        });
+        bool returned = done.wait_for(5s) == std::future_status::ready;
+        check(returned && done.get(), "unwritable cache dir fails, no deadlock");
+        std::filesystem::remove_all(blocked);
+        if (!returned) {
+            // future 析构会等卡住的线程
+            std::_Exit(checkResult());
+        }
+    }
+
+    std::filesystem::remove_all(dir);
+    return checkResult();
+}
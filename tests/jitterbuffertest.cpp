@@ -0,0 +1,119 @@
+// 自适应抖动缓冲：模拟不稳定的 Wi-Fi，25fps 推流，平时 20ms 加 0~20ms
+// 抖动，中间 25 秒有 8% 的包多晚 100~350ms（TCP 按序到达，后面的包跟着
+// 晚）。对比只限上限的固定延迟和自适应延迟的卡顿次数、延迟大小，以及
+// 网络恢复后延迟能降回来
+// 用法: tests_jitterbuffer，全部通过返回 0
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "LiveLatency.h"
+
+using std::cout;
+using std::endl;
+
+constexpr int64_t kFrameMs = 40;
+constexpr int64_t kDropLateMs = 200;
+constexpr int64_t kLateMs = 50;
+constexpr int64_t kDurationMs = 60000;
+constexpr int64_t kBadBeginMs = 10000;
+constexpr int64_t kBadEndMs = 35000;
+
+struct Result {
+    int badStalls;      // 网络差的阶段迟到显示或丢掉的帧
+    int badFrames;
+    double maxPlayoutMs;
+    double endPlayoutMs;
+    LiveLatency::Stats stats;
+};
+
+Result run(bool adaptive) {
+    LiveLatency::Options options;
+    options.targetMs = 3000;
+    options.adaptive = adaptive;
+    LiveLatency live(options);
+
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int64_t> jitter(0, 20);
+    std::uniform_real_distribution<double> chance(0, 1);
+    std::uniform_int_distribution<int64_t> spike(100, 350);
+    const int64_t t0 = 1700000000000000;
+    const int frames = static_cast<int>(kDurationMs / kFrameMs);
+    std::vector<int64_t> arrival(frames);
+    int64_t last = 0;
+    for (int i = 0; i < frames; ++i) {
+        int64_t capture_ms = i * kFrameMs;
+        int64_t delay = 20 + jitter(rng);
+        if (capture_ms >= kBadBeginMs && capture_ms < kBadEndMs &&
+            chance(rng) < 0.08) {
+            delay += spike(rng);
+        }
+        last = std::max(last, t0 + (capture_ms + delay) * 1000);
+        arrival[i] = last;
+    }
+
+    Result result{};
+    int delivered = 0;
+    int displayed = 0;
+    double position = 0;
+    bool started = false;
+    for (int64_t now = t0; now < t0 + kDurationMs * 1000; now += 1000) {
+        while (delivered < frames && arrival[delivered] <= now) {
+            int64_t pts = delivered * kFrameMs;
+            live.OnPacket(pts, pts, t0 + pts * 1000, now);
+            if (!started) {
+                started = true;
+                position = static_cast<double>(pts);
+            }
+            delivered++;
+        }
+        if (!started) {
+            continue;
+        }
+        position += 1.0;
+        // 下一帧还没到、时钟已经过了它的显示时刻，就是卡住了
+        while (displayed < delivered && displayed * kFrameMs <= position) {
+            int64_t pts = displayed * kFrameMs;
+            auto late = static_cast<int64_t>(position - pts);
+            bool bad = pts >= kBadBeginMs && pts < kBadEndMs;
+            result.badFrames += bad;
+            if (late > kDropLateMs) {
+                live.OnDropped();
+                result.badStalls += bad;
+            } else {
+                result.badStalls += bad && late > kLateMs;
+                position += live.OnFrame(pts, now, late);
+                double playout = live.stats().playoutMs;
+                result.maxPlayoutMs = std::max(result.maxPlayoutMs, playout);
+                result.endPlayoutMs = playout;
+            }
+            displayed++;
+        }
+    }
+    result.stats = live.stats();
+    auto &j = result.stats.jitter;
+    cout << (adaptive ? "adaptive" : "fixed   ") << ": stalls "
+         << result.badStalls << "/" << result.badFrames
+         << " frames on bad network, playout max " << result.maxPlayoutMs
+         << " ms end " << result.endPlayoutMs << " ms, jitter " << j.jitterMs
+         << " ms, late packets " << j.late << "/" << j.packets
+         << ", underruns " << result.stats.underruns << endl;
+    return result;
+}
+
+int main() {
+    Result fixed = run(false);
+    Result adaptive = run(true);
+    check(adaptive.badStalls * 3 < fixed.badStalls,
+          "adaptive delay stutters far less than a fixed one");
+    check(adaptive.badStalls < adaptive.badFrames / 20,
+          "stalls stay under 5% of frames on a bad network");
+    check(adaptive.maxPlayoutMs < 1000, "delay grows only as far as needed");
+    check(adaptive.endPlayoutMs < 100, "delay shrinks once the network calms");
+    check(adaptive.stats.jitter.jitterMs > 0 &&
+          adaptive.stats.jitter.late > 0, "jitter and late packets reported");
+    return checkResult();
+}
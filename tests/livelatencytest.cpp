@@ -0,0 +1,145 @@
+// LiveLatency 的追赶行为：模拟一个 25fps 的推流端，网络延迟 100ms 加
+// 0~60ms 抖动，播放端按时钟显示、落后太多的帧丢掉。检查起播前等待、
+// 中途暂停之后延迟能回到目标以内，以及没有推流端时间时估计值的偏差
+// 用法: tests_livelatency，全部通过返回 0
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include "check.h"
+#include "LiveLatency.h"
+
+using std::cout;
+using std::endl;
+
+constexpr int64_t kFrameMs = 40;
+constexpr int64_t kNetworkMs = 100;
+constexpr int64_t kJitterMs = 60;
+constexpr int64_t kDropLateMs = 200;
+// 直播流的 pts 一般不从 0 开始
+constexpr int64_t kPtsBase = 90000000;
+
+struct Scenario {
+    const char *name;
+    int64_t targetMs;
+    bool senderClock;
+    int64_t readyMs;      // 打开后多久才点播放
+    int64_t pauseAtMs;    // 中途暂停的时间点，-1 不暂停
+    int64_t pauseMs;
+    int64_t durationMs;
+};
+
+struct Result {
+    double latencyMs;  // 最后 2 秒实际的采集到显示
+    double reportedMs; // LiveLatency 报告的
+    double maxSpeed;
+    LiveLatency::Stats stats;
+};
+
+Result run(Scenario const &s) {
+    LiveLatency::Options options;
+    options.targetMs = s.targetMs;
+    LiveLatency live(options);
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int64_t> jitter(0, kJitterMs);
+
+    const int64_t t0 = 1700000000000000; // unix 微秒
+    const int frames = static_cast<int>(s.durationMs / kFrameMs);
+    std::vector<int64_t> arrival(frames);
+    int64_t last = 0;
+    for (int i = 0; i < frames; ++i) {
+        int64_t capture = t0 + i * kFrameMs * 1000;
+        last = std::max(last, capture + (kNetworkMs + jitter(rng)) * 1000);
+        arrival[i] = last;
+    }
+
+    Result result{0, 0, 1.0, {}};
+    int delivered = 0;
+    int displayed = 0;
+    double position = 0; // 播放时钟，单位 ms，和 pts 同一个基准
+    bool started = false;
+    double sum = 0;
+    int count = 0;
+    for (int64_t now = t0; now < t0 + s.durationMs * 1000; now += 1000) {
+        while (delivered < frames && arrival[delivered] <= now) {
+            int64_t capture = t0 + delivered * kFrameMs * 1000;
+            int64_t pts = kPtsBase + delivered * kFrameMs;
+            live.OnPacket(pts, pts, s.senderClock ? capture : -1, now);
+            if (!started) {
+                // 和播放器一样，时钟按第一个包的 pts 对齐
+                started = true;
+                position = kPtsBase + delivered * kFrameMs;
+            }
+            delivered++;
+        }
+        int64_t elapsed_ms = (now - t0) / 1000;
+        bool paused = !started || elapsed_ms < s.readyMs ||
+                      (s.pauseAtMs >= 0 && elapsed_ms >= s.pauseAtMs &&
+                       elapsed_ms < s.pauseAtMs + s.pauseMs);
+        if (paused) {
+            continue;
+        }
+        position += 1.0;
+        while (displayed < delivered &&
+               kPtsBase + displayed * kFrameMs <= position) {
+            int64_t pts = kPtsBase + displayed * kFrameMs;
+            if (position - pts > kDropLateMs) {
+                live.OnDropped();
+            } else {
+                position += live.OnFrame(pts, now,
+                                         static_cast<int64_t>(position - pts));
+                result.maxSpeed = std::max(result.maxSpeed,
+                                           live.stats().speed);
+                if (now >= t0 + (s.durationMs - 2000) * 1000) {
+                    int64_t capture = t0 + displayed * kFrameMs * 1000;
+                    sum += (now - capture) / 1000.0;
+                    result.reportedMs += live.stats().latencyMs;
+                    count++;
+                }
+            }
+            displayed++;
+        }
+    }
+    result.latencyMs = count ? sum / count : 0;
+    result.reportedMs = count ? result.reportedMs / count : 0;
+    result.stats = live.stats();
+    cout << s.name << ": latency " << result.latencyMs << " ms (reported "
+         << result.reportedMs << (result.stats.measured ? "" : " estimated")
+         << "), target " << s.targetMs << " ms, " << result.stats.jumps
+         << " jumps, " << result.stats.droppedFrames << " dropped, max speed "
+         << result.maxSpeed << endl;
+    return result;
+}
+
+int main() {
+    // 在 Ready 停了 4 秒，超出太多，直接跳
+    Result ready = run({"ready 4s", 1000, true, 4000, -1, 0, 20000});
+    check(ready.stats.jumps == 1 && ready.stats.droppedFrames > 0,
+          "long wait before play jumps once and drops the backlog");
+    check(ready.latencyMs <= 1000 + 100, "back within target after jump");
+    check(std::abs(ready.latencyMs - ready.reportedMs) < 1,
+          "sender clock gives measured latency");
+
+    // 中途暂停 0.8 秒，超出不多，加速追回来不丢帧
+    Result pause = run({"pause 0.8s", 300, true, 0, 5000, 800, 40000});
+    check(pause.stats.jumps == 0 && pause.stats.droppedFrames == 0,
+          "small excess is not skipped");
+    check(pause.maxSpeed > 1.0, "small excess is caught up by speeding up");
+    check(pause.latencyMs <= 300 + 100, "back within target after speed-up");
+
+    // 没有推流端时间，估计值不含网络延迟本身
+    Result estimated = run({"no sender clock", 1000, false, 4000, -1, 0,
+                            20000});
+    check(!estimated.stats.measured, "falls back to estimate");
+    check(std::abs(estimated.latencyMs - estimated.reportedMs - kNetworkMs) <
+          20, "estimate is off by the network floor only");
+    check(estimated.latencyMs <= 1000 + kNetworkMs + 100,
+          "estimate still bounds latency");
+
+    // 延迟本来就在目标以内时什么都不做
+    Result idle = run({"steady", 1000, true, 0, -1, 0, 10000});
+    check(idle.maxSpeed == 1.0 && idle.stats.jumps == 0 &&
+          idle.stats.droppedFrames == 0, "no catch-up below target");
+    return checkResult();
+}
@@ -0,0 +1,129 @@
+// 热路径日志：PLAYER_LOG_TRACE 编译掉时参数不求值；PLAYER_LOG_EVERY
+// 在多个线程里同时刷也只按间隔放行，压掉的条数不丢；级别过滤掉时不
+// 格式化；异步 logger 下日志调用不等输出
+// 用法: tests_log，全部通过返回 0
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <spdlog/async.h>
+#include <spdlog/sinks/base_sink.h>
+#include "check.h"
+#include "Log.h"
+
+using std::cout;
+using std::endl;
+using Clock = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+int g_evaluated = 0;
+
+int evaluated() {
+    return ++g_evaluated;
+}
+
+// 记下收到的消息，可以让每条都写得很慢
+class CountingSink : public spdlog::sinks::base_sink<std::mutex> {
+public:
+    explicit CountingSink(std::chrono::microseconds delay = {})
+        : delay_(delay) {}
+
+    std::vector<std::string> messages;
+
+protected:
+    void sink_it_(const spdlog::details::log_msg &msg) override {
+        std::this_thread::sleep_for(delay_);
+        messages.emplace_back(msg.payload.data(), msg.payload.size());
+    }
+
+    void flush_() override {}
+
+private:
+    std::chrono::microseconds delay_;
+};
+
+void traceCompiledOut() {
+    PLAYER_LOG_TRACE("frame {}", evaluated());
+#ifdef PLAYER_LOG_HOT_PATH
+    check(g_evaluated == 1, "trace arguments evaluated when compiled in");
+#else
+    check(g_evaluated == 0, "trace arguments not evaluated");
+#endif
+}
+
+void rateLimit() {
+    auto sink = std::make_shared<CountingSink>();
+    auto logger = std::make_shared<spdlog::logger>("test", sink);
+    spdlog::set_default_logger(logger);
+    spdlog::set_level(spdlog::level::info);
+
+    // 4 个线程各刷 0.5 秒，间隔 100ms，大约放行 5 条
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> calls{0};
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&calls] {
+            auto end = Clock::now() + 500ms;
+            while (Clock::now() < end) {
+                PLAYER_LOG_EVERY(spdlog::level::warn, 100, "queue full");
+                calls++;
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    uint64_t passed = 0;
+    uint64_t suppressed = 0;
+    for (auto const &msg : sink->messages) {
+        passed++;
+        auto pos = msg.find('(');
+        if (pos != std::string::npos) {
+            suppressed += std::stoull(msg.substr(pos + 1));
+        }
+    }
+    cout << calls << " calls, " << passed << " logged, " << suppressed
+         << " suppressed" << endl;
+    check(passed >= 5 && passed <= 7, "one message per interval");
+    // 最后一个间隔里压掉的要等下一次放行才报出来
+    check(passed + suppressed <= calls && suppressed > calls / 2,
+          "suppressed messages are counted");
+
+    sink->messages.clear();
+    g_evaluated = 0;
+    spdlog::set_level(spdlog::level::err);
+    PLAYER_LOG_EVERY(spdlog::level::warn, 100, "filtered {}", evaluated());
+    check(sink->messages.empty() && g_evaluated == 0,
+          "filtered level is not formatted");
+}
+
+void asyncNonBlocking() {
+    // 每条要写 1ms 的 sink，同步时 1000 条要 1 秒
+    InitLogging();
+    check(std::dynamic_pointer_cast<spdlog::async_logger>(
+              spdlog::default_logger()) != nullptr,
+          "default logger is async");
+    auto sink = std::make_shared<CountingSink>(1ms);
+    auto logger = std::make_shared<spdlog::async_logger>(
+        "slow", sink, spdlog::thread_pool(),
+        spdlog::async_overflow_policy::overrun_oldest);
+    spdlog::set_default_logger(logger);
+    spdlog::set_level(spdlog::level::info);
+    auto begin = Clock::now();
+    for (int i = 0; i < 1000; ++i) {
+        spdlog::info("message {}", i);
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+                    Clock::now() - begin).count();
+    cout << "1000 async messages: " << ms << "ms" << endl;
+    check(ms < 100, "async logging does not wait for the sink");
+    ShutdownLogging();
+}
+
+int main() {
+    traceCompiledOut();
+    rateLimit();
+    asyncNonBlocking();
+    return checkResult();
+}
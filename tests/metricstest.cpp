@@ -0,0 +1,176 @@
+// Metrics 的计数和直方图：多个线程同时记，总数不能丢；直方图的分位数
+// 和精确值比相对误差不超过一个子桶（1/16），两次快照之间的分位数也是；
+// 快照能写成 JSON 并定期追加到文件，以及一次 Record 的开销
+// 用法: tests_metrics，全部通过返回 0
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "check.h"
+#include "Metrics.h"
+
+using std::cout;
+using std::endl;
+using Clock = std::chrono::steady_clock;
+
+constexpr int kThreads = 4;
+constexpr int kPerThread = 200000;
+
+double exactQuantile(std::vector<double> sorted, double q) {
+    size_t rank = std::max<size_t>(
+        1, static_cast<size_t>(std::ceil(q * sorted.size())));
+    return sorted[rank - 1];
+}
+
+void concurrent() {
+    auto &counter = Metrics::Get().counter("test.count");
+    auto &gauge = Metrics::Get().gauge("test.depth");
+    auto &histogram = Metrics::Get().histogram("test.concurrent_ms");
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kPerThread; ++i) {
+                counter.Add();
+                gauge.Add(1);
+                gauge.Add(-1);
+                histogram.Record((t + 1) * 0.5);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    auto snapshot = histogram.snapshot();
+    check(counter.value() == uint64_t{kThreads} * kPerThread,
+          "concurrent counter adds are not lost");
+    check(gauge.value() == 0, "concurrent gauge adds cancel out");
+    check(snapshot.count == uint64_t{kThreads} * kPerThread,
+          "concurrent histogram records are not lost");
+    check(snapshot.minMs == 0.5 && snapshot.maxMs == kThreads * 0.5,
+          "min and max are exact");
+    // 同一个名字拿到的是同一个
+    check(&Metrics::Get().counter("test.count") == &counter,
+          "names resolve to the same metric");
+}
+
+void quantiles() {
+    // 对数正态分布，覆盖几十微秒到几百毫秒
+    std::mt19937 rng(7);
+    std::lognormal_distribution<double> dist(1.0, 1.5);
+    auto &histogram = Metrics::Get().histogram("test.lognormal_ms");
+    std::vector<double> values;
+    for (int i = 0; i < 100000; ++i) {
+        double ms = dist(rng);
+        values.push_back(ms);
+        histogram.Record(ms);
+    }
+    std::sort(values.begin(), values.end());
+    auto snapshot = histogram.snapshot();
+    double worst = 0;
+    for (auto [q, got] : {std::pair{0.5, snapshot.p50Ms},
+                          std::pair{0.9, snapshot.p90Ms},
+                          std::pair{0.99, snapshot.p99Ms}}) {
+        double want = exactQuantile(values, q);
+        double error = std::abs(got - want) / want;
+        cout << "p" << q * 100 << ": " << got << "ms, exact " << want
+             << "ms, error " << error * 100 << "%" << endl;
+        worst = std::max(worst, error);
+    }
+    check(worst <= 1.0 / 16, "quantile error within one sub-bucket");
+    double sum = 0;
+    for (double v : values) {
+        sum += v;
+    }
+    double mean = sum / values.size();
+    check(std::abs(snapshot.meanMs - mean) / mean < 0.01, "mean is close");
+
+    auto &empty = Metrics::Get().histogram("test.empty_ms");
+    check(empty.snapshot().count == 0 && empty.snapshot().p99Ms == 0,
+          "empty histogram reports zeros");
+}
+
+void interval() {
+    // 先记一批快的，再记一批慢的，后一段的分位数只看慢的那批
+    auto &histogram = Metrics::Get().histogram("test.interval_ms");
+    for (int i = 0; i < 10000; ++i) {
+        histogram.Record(0.5 + i % 100 * 0.001);
+    }
+    auto before = histogram.snapshot();
+    std::vector<double> values;
+    for (int i = 0; i < 1000; ++i) {
+        double ms = 10 + i % 100 * 0.2;
+        values.push_back(ms);
+        histogram.Record(ms);
+    }
+    std::sort(values.begin(), values.end());
+    auto delta = histogram.snapshot().Since(before);
+    double want = exactQuantile(values, 0.99);
+    cout << "interval p99: " << delta.p99Ms << "ms, exact " << want
+         << "ms, cumulative " << histogram.snapshot().p99Ms << "ms" << endl;
+    check(delta.count == values.size(), "interval counts new samples only");
+    check(std::abs(delta.p99Ms - want) / want <= 1.0 / 16 &&
+          std::abs(delta.p50Ms - exactQuantile(values, 0.5)) /
+          exactQuantile(values, 0.5) <= 1.0 / 16,
+          "interval quantiles within one sub-bucket");
+    check(std::abs(delta.meanMs - 19.9) < 0.05, "interval mean");
+    check(delta.minMs >= 9 && delta.maxMs <= 30, "interval min and max");
+    check(histogram.snapshot().Since(histogram.snapshot()).count == 0,
+          "no new samples, empty interval");
+}
+
+void json() {
+    auto text = Metrics::Get().snapshot().ToJson();
+    check(text.front() == '{' && text.back() == '}' &&
+          text.find("\"test.count\":") != std::string::npos &&
+          text.find("\"test.lognormal_ms\":{\"count\":100000") !=
+          std::string::npos,
+          "snapshot serializes to json");
+
+    std::string path = "/tmp/tests_metrics.jsonl";
+    std::remove(path.c_str());
+    Metrics::Get().StartDump(path, std::chrono::milliseconds(100));
+    std::this_thread::sleep_for(std::chrono::milliseconds(450));
+    Metrics::Get().StopDump();
+    std::ifstream in(path);
+    int lines = 0;
+    for (std::string line; std::getline(in, line);) {
+        lines += line.front() == '{' && line.back() == '}';
+    }
+    cout << "dumped " << lines << " lines" << endl;
+    check(lines >= 3 && lines <= 5, "periodic dump appends one line per tick");
+    std::remove(path.c_str());
+
+    Metrics::Get().Reset();
+    check(Metrics::Get().counter("test.count").value() == 0 &&
+          Metrics::Get().histogram("test.lognormal_ms").snapshot().count ==
+          0,
+          "reset clears values");
+}
+
+void overhead() {
+    auto &histogram = Metrics::Get().histogram("test.overhead_ms");
+    constexpr int kRecords = 1000000;
+    auto begin = Clock::now();
+    for (int i = 0; i < kRecords; ++i) {
+        histogram.Record(i % 1000 * 0.01);
+    }
+    double ns = std::chrono::duration<double, std::nano>(
+                    Clock::now() - begin).count() / kRecords;
+    cout << "Record: " << ns << "ns" << endl;
+    check(ns < 1000, "recording is cheap");
+}
+
+int main() {
+    concurrent();
+    quantiles();
+    interval();
+    json();
+    overhead();
+    return checkResult();
+}
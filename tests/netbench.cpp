@@ -0,0 +1,184 @@
+// 网络损伤下的播放表现：同一个文件在几种网络条件下各播一段，数据源
+// 套一层 ImpairedAvio，走 PlayerController 正式的读线程和解码线程。
+// 统计起播耗时、卡顿次数、卡顿总时长和最晚的一帧，直播场景另外给出
+// 端到端延迟。种子固定，同样的参数可以重放
+// 直播场景要求不 seek 也能 demux 的容器（ts/flv），其他格式跳过
+// 用法: tests_netbench [file] [seconds]，默认 /home/awe/Videos/oceans.mp4
+// 每个场景 10 秒；没有显示器时加 QT_QPA_PLATFORM=offscreen
+#include <QApplication>
+#include <QTimer>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include "ImpairedAvio.h"
+#include "MmapAvio.h"
+#include "PlayerController.h"
+#include "PlayerWidget.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+using std::cout;
+using std::endl;
+using std::string;
+
+struct Scenario {
+    string name;
+    ImpairedAvio::Impairment impairment;
+};
+
+// 码率，字节/秒，限速按它的倍数给
+double byteRate(string const &filename) {
+    AVFormatContext *ctx = nullptr;
+    if (avformat_open_input(&ctx, filename.c_str(), nullptr, nullptr) != 0) {
+        return 0;
+    }
+    double rate = 0;
+    if (avformat_find_stream_info(ctx, nullptr) >= 0) {
+        if (ctx->bit_rate > 0) {
+            rate = ctx->bit_rate / 8.0;
+        } else if (ctx->duration > 0 && ctx->pb) {
+            rate = avio_size(ctx->pb) * double(AV_TIME_BASE) / ctx->duration;
+        }
+    }
+    avformat_close_input(&ctx);
+    return rate;
+}
+
+bool liveCapable(string const &filename) {
+    auto dot = filename.rfind('.');
+    string ext = dot == string::npos ? "" : filename.substr(dot + 1);
+    return ext == "ts" || ext == "m2ts" || ext == "flv";
+}
+
+std::vector<Scenario> scenarios(double rate, int seconds, bool live) {
+    std::vector<Scenario> list;
+    auto add = [&](string name, std::function<void(
+                       ImpairedAvio::Impairment &)> const &setup) {
+        Scenario scenario{std::move(name), {}};
+        setup(scenario.impairment);
+        list.push_back(scenario);
+    };
+    add("clean", [](auto &) {});
+    add("broadband", [&](auto &i) {
+        i.bandwidth = rate * 4;
+        i.latencyMs = 40;
+        i.jitterMs = 5;
+    });
+    add("mobile", [&](auto &i) {
+        i.bandwidth = rate * 1.5;
+        i.latencyMs = 150;
+        i.jitterMs = 60;
+        i.stallChance = 0.002;
+        i.stallMs = 500;
+    });
+    add("stalls", [&](auto &i) {
+        i.bandwidth = rate * 3;
+        i.stallChance = 0.01;
+        i.stallMs = 1500;
+    });
+    add("underprovisioned", [&](auto &i) {
+        i.bandwidth = rate * 0.8;
+        i.latencyMs = 80;
+    });
+    add("disconnect", [&](auto &i) {
+        i.bandwidth = rate * 2;
+        i.disconnectAfter = static_cast<uint64_t>(rate * seconds / 2);
+    });
+    if (live) {
+        add("live", [&](auto &i) {
+            i.live = true;
+            i.bandwidth = rate;
+            i.jitterMs = 80;
+        });
+        add("live-stalls", [&](auto &i) {
+            i.live = true;
+            i.bandwidth = rate;
+            i.jitterMs = 30;
+            i.stallChance = 0.005;
+            i.stallMs = 1200;
+        });
+    }
+    return list;
+}
+
+int main(int argc, char *argv[]) {
+    string filename = argc > 1 ? argv[1] : "/home/awe/Videos/oceans.mp4";
+    int seconds = argc > 2 ? std::atoi(argv[2]) : 10;
+    setenv("PLAYER_AUDIO_SINK", "null", 0);
+    QApplication app(argc, argv);
+    spdlog::set_level(spdlog::level::warn);
+
+    double rate = byteRate(filename);
+    if (rate <= 0) {
+        cout << "cannot probe " << filename << endl;
+        return 1;
+    }
+    bool live = liveCapable(filename);
+    cout << filename << ": " << rate * 8 / 1000 << " kbps, " << seconds
+         << "s per scenario" << (live ? "" : ", live scenarios skipped")
+         << endl;
+    printf("%-17s %8s %8s %9s %9s %6s %7s %9s %s\n", "scenario", "startup",
+           "underrun", "rebuffer", "max late", "late", "stalls", "net wait",
+           "live latency");
+
+    PlayerWidget widget;
+    widget.resize(320, 180);
+    widget.show();
+    for (auto const &scenario : scenarios(rate, seconds, live)) {
+        ImpairedAvio *source = nullptr;
+        AvioSource::SetFactory([&](string const &url)
+            -> std::unique_ptr<AvioSource> {
+                if (url != filename) {
+                    return nullptr;
+                }
+                auto impaired = ImpairedAvio::Wrap(MmapAvio::Open(url),
+                                                   scenario.impairment);
+                // 第一个打开的是播放用的 demuxer，后台建索引的不算
+                if (!source) {
+                    source = impaired.get();
+                }
+                return impaired;
+            });
+        auto controller = std::make_unique<PlayerController>(&widget);
+        try {
+            controller->Open(filename);
+        } catch (std::exception const &e) {
+            printf("%-17s open failed: %s\n", scenario.name.c_str(),
+                   e.what());
+            continue;
+        }
+        controller->Play();
+        QTimer::singleShot(seconds * 1000, &app, &QCoreApplication::quit);
+        QApplication::exec();
+
+        auto startup = controller->StartupStats();
+        auto stalls = controller->Stalls();
+        auto net = source ? source->stats() : ImpairedAvio::Stats{};
+        char latency[128] = "-";
+        if (controller->IsLive()) {
+            auto stats = controller->LiveStats();
+            snprintf(latency, sizeof(latency),
+                     "%.0fms (playout %.0fms, %llu jumps, %llu dropped)",
+                     stats.latencyMs, stats.playoutMs,
+                     static_cast<unsigned long long>(stats.jumps),
+                     static_cast<unsigned long long>(stats.droppedFrames));
+        }
+        printf("%-17s %6.0fms %8llu %7.0fms %7.0fms %6llu %7llu %7.0fms "
+               "%s%s\n",
+               scenario.name.c_str(), startup.totalMs,
+               static_cast<unsigned long long>(stalls.underruns),
+               stalls.rebufferMs, stalls.maxLateMs,
+               static_cast<unsigned long long>(stalls.lateFrames),
+               static_cast<unsigned long long>(net.stalls), net.sleptMs,
+               latency, net.disconnected ? " [disconnected]" : "");
+        controller.reset();
+    }
+    AvioSource::SetFactory(nullptr);
+    return 0;
+}
@@ -0,0 +1,59 @@
+// PcmProcessor 各个 SIMD 实现的速度：48kHz 双声道，每次 1024 帧，
+// 和 AudioSink 前面的处理一样的块大小
+// 用法: tests_pcmbench [rounds]，默认 20000 块
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "PcmProcessor.h"
+
+using std::cout;
+using std::endl;
+using Clock = std::chrono::steady_clock;
+
+constexpr int kRate = 48000;
+constexpr int kChannels = 2;
+constexpr int kFrames = 1024;
+
+// 返回每个采样的纳秒数
+double bench(const std::string &kernel, const std::vector<int16_t> &input,
+             int rounds) {
+    PcmProcessor::UseKernel(kernel);
+    PcmProcessor processor;
+    processor.SetVolume(0.8f);
+    std::vector<int16_t> block(input.size());
+    // 先跑一块，把渐变走完
+    block = input;
+    processor.Process(block.data(), kFrames, kChannels, kRate);
+
+    Clock::duration total{};
+    for (int i = 0; i < rounds; ++i) {
+        block = input;
+        auto begin = Clock::now();
+        processor.Process(block.data(), kFrames, kChannels, kRate);
+        total += Clock::now() - begin;
+    }
+    double ns = std::chrono::duration<double, std::nano>(total).count();
+    return ns / (static_cast<double>(rounds) * input.size());
+}
+
+int main(int argc, char **argv) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 20000;
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> dist(-32768, 32767);
+    std::vector<int16_t> input(kFrames * kChannels);
+    for (auto &s : input) {
+        s = static_cast<int16_t>(dist(rng));
+    }
+
+    double scalar = bench("scalar", input, rounds);
+    for (auto const &kernel : PcmProcessor::Kernels()) {
+        double ns = kernel == "scalar" ? scalar : bench(kernel, input, rounds);
+        cout << kernel << ": " << ns << " ns/sample, " << scalar / ns
+             << "x scalar" << endl;
+    }
+    return 0;
+}
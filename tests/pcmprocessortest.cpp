@@ -0,0 +1,130 @@
+// PcmProcessor：每个 SIMD 实现和标量版本逐个采样比较，增益、渐变、
+// 峰值、RMS 都要完全一样，包括尾巴、单声道、满幅和很小的信号
+// 用法: tests_pcmprocessor，全部通过返回 0
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "PcmProcessor.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+constexpr int kRate = 48000;
+
+struct Step {
+    float volume;
+    bool mute;
+    int frames;
+};
+
+struct Output {
+    std::vector<int16_t> samples;
+    std::vector<PcmLevels> levels;
+};
+
+// 同一个输入按 steps 一段段处理，音量在段之间改变就会触发渐变
+Output run(const string &kernel, std::vector<int16_t> input, int channels,
+           const std::vector<Step> &steps) {
+    PcmProcessor::UseKernel(kernel);
+    PcmProcessor processor;
+    Output out;
+    size_t pos = 0;
+    for (auto const &step : steps) {
+        processor.SetVolume(step.volume);
+        processor.SetMute(step.mute);
+        processor.Process(input.data() + pos, step.frames, channels, kRate);
+        out.levels.push_back(processor.Levels());
+        pos += static_cast<size_t>(step.frames) * channels;
+    }
+    input.resize(pos);
+    out.samples = std::move(input);
+    return out;
+}
+
+bool sameLevels(const std::vector<PcmLevels> &a,
+                const std::vector<PcmLevels> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].channels != b[i].channels || a[i].peak != b[i].peak ||
+            a[i].rms != b[i].rms) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<int16_t> randomSamples(size_t count, int amplitude,
+                                   uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> dist(-amplitude, amplitude - 1);
+    std::vector<int16_t> samples(count);
+    for (auto &s : samples) {
+        s = static_cast<int16_t>(dist(rng));
+    }
+    return samples;
+}
+
+void compare(const string &kernel, const string &name,
+             const std::vector<int16_t> &input, int channels,
+             const std::vector<Step> &steps) {
+    Output expected = run("scalar", input, channels, steps);
+    Output actual = run(kernel, input, channels, steps);
+    check(actual.samples == expected.samples,
+          kernel + " " + name + ": samples");
+    check(sameLevels(actual.levels, expected.levels),
+          kernel + " " + name + ": peak and rms");
+}
+
+int main() {
+    auto kernels = PcmProcessor::Kernels();
+    cout << "default kernel " << PcmProcessor::KernelName() << ", available:";
+    for (auto const &kernel : kernels) {
+        cout << " " << kernel;
+    }
+    cout << endl;
+    check(kernels.back() == "scalar", "scalar is always available");
+    check(!PcmProcessor::UseKernel("none"), "unknown kernel rejected");
+
+    // 奇数帧数留下尾巴；中间改音量、静音再取消，都会走渐变
+    std::vector<Step> gains = {{1.0f, false, 1021}, {0.37f, false, 997},
+                               {1.9f, false, 4099}, {1.9f, true, 1500},
+                               {1.0f, false, 2047}, {1.0f, false, 5}};
+    size_t frames = 0;
+    for (auto const &step : gains) {
+        frames += step.frames;
+    }
+    for (int channels : {1, 2}) {
+        auto input = randomSamples(frames * channels, 32768, 7 + channels);
+        // 放进一些满幅采样，放大后都会饱和
+        for (size_t i = 0; i < input.size(); i += 97) {
+            input[i] = i % 2 ? 32767 : -32768;
+        }
+        auto quiet = randomSamples(frames * channels, 2, 3);
+        string ch = std::to_string(channels) + "ch";
+        for (auto const &kernel : kernels) {
+            compare(kernel, ch + " gain and ramp", input, channels, gains);
+            compare(kernel, ch + " full scale",
+                    std::vector<int16_t>(frames * channels, -32768), channels,
+                    gains);
+            compare(kernel, ch + " quiet", quiet, channels, gains);
+        }
+    }
+
+    // 只有 ±1 的信号 RMS 也不能算成 0
+    for (auto const &kernel : kernels) {
+        std::vector<int16_t> ones(2048);
+        for (size_t i = 0; i < ones.size(); ++i) {
+            ones[i] = i % 3 ? 1 : -1;
+        }
+        Output out = run(kernel, ones, 2, {{1.0f, false, 1024}});
+        check(out.levels[0].rms[0] > 0 && out.levels[0].rms[1] > 0,
+              kernel + " quiet signal has rms");
+    }
+    return checkResult();
+}
@@ -0,0 +1,178 @@
+// 播放列表无缝切换：ffmpeg 生成两个 2 秒的短文件，视频带 B 帧（解码器
+// 有延迟，结尾要 drain 才能拿全），音频是跨两个文件相位连续的正弦波。
+// 用 null sink 播完整个列表，检查切到了第二个文件、视频没有丢帧、
+// 输出的 PCM 采样数对得上且切换处没有跳变，写入也没有停顿
+// 用法: tests_playlist [ffmpeg]，全部通过返回 0。没有显示器时加
+// QT_QPA_PLATFORM=offscreen
+#include <QApplication>
+#include <QTimer>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include "check.h"
+#include "PlayerController.h"
+#include "PlayerWidget.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using Clock = std::chrono::steady_clock;
+
+constexpr int kSeconds = 2;
+constexpr int kFps = 25;
+constexpr int kRate = 48000;
+constexpr double kAmplitude = 0.5;
+constexpr double kToneHz = 440;
+
+// sink 写进来的 PCM 和写入间隔。sink 归播放器管，结果单独放一份
+struct Capture {
+    std::mutex mtx;
+    std::vector<int16_t> samples;
+    int nch{};
+    uint64_t writes{};
+    Clock::time_point lastWrite{};
+    Clock::duration maxGap{};
+};
+
+// 消费速度照旧按 NullAudioSink
+class CaptureSink : public NullAudioSink {
+public:
+    explicit CaptureSink(std::shared_ptr<Capture> capture)
+        : capture_(std::move(capture)) {}
+
+    void SetFormat(int rate, int sample_size, int nch) override {
+        {
+            std::lock_guard<std::mutex> lock(capture_->mtx);
+            capture_->nch = nch;
+        }
+        NullAudioSink::SetFormat(rate, sample_size, nch);
+    }
+
+    void writeData(const char *data, int64_t len) override {
+        {
+            std::lock_guard<std::mutex> lock(capture_->mtx);
+            auto *samples = reinterpret_cast<const int16_t *>(data);
+            capture_->samples.insert(capture_->samples.end(), samples,
+                                     samples + len / sizeof(int16_t));
+            auto now = Clock::now();
+            if (capture_->writes++ > 0) {
+                capture_->maxGap = std::max(capture_->maxGap,
+                                            now - capture_->lastWrite);
+            }
+            capture_->lastWrite = now;
+        }
+        NullAudioSink::writeData(data, len);
+    }
+
+private:
+    std::shared_ptr<Capture> capture_;
+};
+
+// 第 index 个文件，正弦波从 index * kSeconds 秒的相位接着开始
+bool makeClip(const string &ffmpeg, const string &path, int index) {
+    string tone = std::to_string(kAmplitude) + "*sin(2*PI*" +
+                  std::to_string(kToneHz) + "*(t+" +
+                  std::to_string(index * kSeconds) + "))";
+    string cmd = ffmpeg + " -v error -y"
+                 " -f lavfi -i testsrc=size=320x240:rate=" +
+                 std::to_string(kFps) + ":duration=" +
+                 std::to_string(kSeconds) +
+                 " -f lavfi -i 'aevalsrc=" + tone + "|" + tone + ":s=" +
+                 std::to_string(kRate) + ":d=" + std::to_string(kSeconds) +
+                 "' -c:v mpeg4 -bf 2 -g 25 -c:a pcm_s16le " + path;
+    return std::system(cmd.c_str()) == 0;
+}
+
+// 相邻采样的最大差值，正弦波本身最多差 2π f A / rate
+int maxStep(const std::vector<int16_t> &samples, int nch) {
+    int step = 0;
+    for (size_t i = nch; i < samples.size(); ++i) {
+        step = std::max(step, std::abs(samples[i] - samples[i - nch]));
+    }
+    return step;
+}
+
+int main(int argc, char *argv[]) {
+    string ffmpeg = argc > 1 ? argv[1] : "ffmpeg";
+    string first = "/tmp/tests_playlist_a.mkv";
+    string second = "/tmp/tests_playlist_b.mkv";
+    if (!makeClip(ffmpeg, first, 0) || !makeClip(ffmpeg, second, 1)) {
+        cout << "cannot generate clips with " << ffmpeg << endl;
+        return 1;
+    }
+    QApplication app(argc, argv);
+    spdlog::set_level(spdlog::level::warn);
+
+    PlayerWidget widget;
+    widget.resize(320, 240);
+    widget.show();
+    auto controller = std::make_unique<PlayerController>(&widget);
+    auto capture = std::make_shared<Capture>();
+    int sinks = 0;
+    controller->SetAudioSinkFactory([capture, &sinks] {
+        sinks++;
+        return std::make_unique<CaptureSink>(capture);
+    });
+    std::vector<string> changes;
+    QObject::connect(controller.get(), &PlayerController::MediaChanged,
+                     [&](const QString &url) {
+                         changes.push_back(url.toStdString());
+                     });
+
+    auto &frames = Metrics::Get().counter("video.frames");
+    auto &dropped = Metrics::Get().counter("video.dropped");
+    uint64_t frames_before = frames.value();
+    uint64_t dropped_before = dropped.value();
+    try {
+        controller->Open(first);
+    } catch (std::exception const &e) {
+        cout << "open failed: " << e.what() << endl;
+        return 1;
+    }
+    controller->Enqueue(second);
+    controller->Play();
+    // 两个文件播完再留足余量，列表播完以后不再有输出
+    QTimer::singleShot(2 * kSeconds * 1000 + 3000, &app,
+                       &QCoreApplication::quit);
+    QApplication::exec();
+    string current = controller->url();
+    // 先停掉线程，再读记下的东西
+    controller.reset();
+
+    check(changes.size() == 1 && changes[0] == second,
+          "switched to the second item");
+    check(current == second, "controller follows the switch");
+    uint64_t presented = frames.value() - frames_before;
+    cout << "video: " << presented << " frames presented, "
+         << dropped.value() - dropped_before << " dropped" << endl;
+    check(dropped.value() == dropped_before, "no video frame dropped");
+
+    // 两个文件格式一样，不用重建输出
+    check(sinks == 1, "one audio sink for the whole playlist");
+    int nch = std::max(capture->nch, 1);
+    size_t expected = 2 * kSeconds * kRate;
+    size_t got = capture->samples.size() / nch;
+    int step = maxStep(capture->samples, nch);
+    int limit = static_cast<int>(2 * 3.1416 * kToneHz * kAmplitude * 32767 /
+                                 kRate * 1.5);
+    double gap_ms = std::chrono::duration<double, std::milli>(
+        capture->maxGap).count();
+    cout << "audio: " << got << "/" << expected << " frames, max step "
+         << step << " (limit " << limit << "), longest write gap " << gap_ms
+         << "ms" << endl;
+    // 同步补偿最多改 0.5% 的采样数
+    check(got >= expected * 99 / 100 && got <= expected * 101 / 100,
+          "no audio lost or repeated");
+    check(step <= limit, "no discontinuity in the output");
+    check(gap_ms < 150, "no stall at the switch");
+    std::remove(first.c_str());
+    std::remove(second.c_str());
+    return checkResult();
+}
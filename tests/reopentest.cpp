@@ -0,0 +1,85 @@
+// 倒放中打开另一个文件：上一个文件的逐帧/倒放状态要清掉，新文件暂停
+// 再播放时从它自己的位置继续，不会 seek 到上一个文件倒放停下的位置
+// 用法: tests_reopen [ffmpeg]，全部通过返回 0。没有显示器时加
+// QT_QPA_PLATFORM=offscreen
+#include <QApplication>
+#include <QEventLoop>
+#include <QTimer>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <spdlog/spdlog.h>
+#include "check.h"
+#include "PlayerController.h"
+#include "PlayerWidget.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+bool makeClip(const string &ffmpeg, const string &path, int seconds) {
+    string duration = std::to_string(seconds);
+    string cmd = ffmpeg + " -v error -y"
+                 " -f lavfi -i testsrc=size=320x240:rate=25:duration=" +
+                 duration + " -f lavfi -i sine=f=440:d=" + duration +
+                 " -c:v mpeg4 -g 25 -c:a pcm_s16le " + path;
+    return std::system(cmd.c_str()) == 0;
+}
+
+// 跑事件循环，排队的信号照常处理
+void wait(int ms) {
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+int main(int argc, char *argv[]) {
+    string ffmpeg = argc > 1 ? argv[1] : "ffmpeg";
+    string first = "/tmp/tests_reopen_a.mkv";
+    string second = "/tmp/tests_reopen_b.mkv";
+    if (!makeClip(ffmpeg, first, 6) || !makeClip(ffmpeg, second, 6)) {
+        cout << "cannot generate clips with " << ffmpeg << endl;
+        return 1;
+    }
+    setenv("PLAYER_AUDIO_SINK", "null", 0);
+    QApplication app(argc, argv);
+    spdlog::set_level(spdlog::level::warn);
+
+    PlayerWidget widget;
+    widget.resize(320, 240);
+    widget.show();
+    auto controller = std::make_unique<PlayerController>(&widget);
+    try {
+        controller->Open(first);
+    } catch (std::exception const &e) {
+        cout << "open failed: " << e.what() << endl;
+        return 1;
+    }
+    // 播到 3 秒左右暂停，从那里倒放
+    controller->Play();
+    wait(3000);
+    controller->SetReverse(true);
+    wait(300);
+    check(controller->state() == PlayerState::Paused, "reversing while paused");
+
+    controller->Open(second);
+    check(controller->url() == second, "second file opened");
+    controller->Play();
+    wait(500);
+    controller->Play();
+    wait(100);
+    controller->Play();
+    wait(300);
+    auto [pos, total] = controller->CurrentPosition();
+    cout << "after pause/resume: " << pos << "ms of " << total << "ms"
+         << endl;
+    check(controller->state() == PlayerState::Playing, "playing again");
+    check(pos < 1500, "resumes in the new file, not at the old position");
+
+    controller.reset();
+    std::remove(first.c_str());
+    std::remove(second.c_str());
+    return checkResult();
+}
@@ -0,0 +1,165 @@
+// seek 延迟对比：音频流 AVSEEK_FLAG_FRAME（原来的做法） vs 视频关键帧索引
+// 用法: tests_seekbench [file]，默认 /home/awe/Videos/oceans.mp4
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "KeyframeIndex.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+using std::cout;
+using std::endl;
+using std::string;
+using Clock = std::chrono::steady_clock;
+
+struct SeekResult {
+    double latency_ms;
+    int packets;
+    int64_t landed_ms;
+};
+
+struct Player {
+    AVFormatContext *formatCtx = nullptr;
+    AVCodecContext *videoCtx = nullptr;
+    int videoStream = -1;
+    int audioStream = -1;
+
+    ~Player() {
+        avcodec_free_context(&videoCtx);
+        if (formatCtx) {
+            avformat_close_input(&formatCtx);
+        }
+    }
+
+    bool open(string const &filename) {
+        if (avformat_open_input(&formatCtx, filename.c_str(), nullptr,
+                                nullptr) != 0) {
+            return false;
+        }
+        if (avformat_find_stream_info(formatCtx, nullptr) < 0) {
+            return false;
+        }
+        videoStream = av_find_best_stream(formatCtx, AVMEDIA_TYPE_VIDEO, -1,
+                                          -1, nullptr, 0);
+        audioStream = av_find_best_stream(formatCtx, AVMEDIA_TYPE_AUDIO, -1,
+                                          -1, nullptr, 0);
+        if (videoStream < 0) {
+            return false;
+        }
+        AVStream *stream = formatCtx->streams[videoStream];
+        const AVCodec *codec = avcodec_find_decoder(
+            stream->codecpar->codec_id);
+        videoCtx = avcodec_alloc_context3(codec);
+        avcodec_parameters_to_context(videoCtx, stream->codecpar);
+        return avcodec_open2(videoCtx, codec, nullptr) == 0;
+    }
+
+    // seek 之后读包并解码，直到拿到第一帧视频
+    SeekResult measure(std::function<bool()> const &seek) {
+        auto begin = Clock::now();
+        SeekResult result{-1, 0, -1};
+        if (!seek()) {
+            return result;
+        }
+        avcodec_flush_buffers(videoCtx);
+        AVPacket *packet = av_packet_alloc();
+        AVFrame *frame = av_frame_alloc();
+        AVRational tb = formatCtx->streams[videoStream]->time_base;
+        while (av_read_frame(formatCtx, packet) >= 0) {
+            result.packets++;
+            if (packet->stream_index == videoStream &&
+                avcodec_send_packet(videoCtx, packet) == 0 &&
+                avcodec_receive_frame(videoCtx, frame) == 0) {
+                result.landed_ms = av_rescale_q(frame->best_effort_timestamp,
+                                                tb, {1, 1000});
+                av_packet_unref(packet);
+                break;
+            }
+            av_packet_unref(packet);
+        }
+        result.latency_ms = std::chrono::duration<double, std::milli>(
+            Clock::now() - begin).count();
+        av_frame_free(&frame);
+        av_packet_free(&packet);
+        return result;
+    }
+};
+
+void report(string const &name, std::vector<SeekResult> results,
+            std::vector<int64_t> const &targets) {
+    std::vector<double> latency;
+    double packets = 0;
+    double error = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        latency.push_back(results[i].latency_ms);
+        packets += results[i].packets;
+        error += std::abs(results[i].landed_ms - targets[i]);
+    }
+    std::sort(latency.begin(), latency.end());
+    double sum = 0;
+    for (double l : latency) {
+        sum += l;
+    }
+    size_t n = latency.size();
+    cout << name << ": mean " << sum / n << " ms, p50 " << latency[n / 2]
+        << " ms, p95 " << latency[n * 95 / 100] << " ms, max "
+        << latency.back() << " ms, packets/seek " << packets / n
+        << ", |landed - target| " << error / n << " ms" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    string filename = argc > 1 ? argv[1] : "/home/awe/Videos/oceans.mp4";
+    Player player;
+    if (!player.open(filename)) {
+        cout << "open " << filename << " failed" << endl;
+        return -1;
+    }
+    AVStream *video = player.formatCtx->streams[player.videoStream];
+    int64_t duration_ms = player.formatCtx->duration / 1000;
+
+    KeyframeIndex index;
+    auto begin = Clock::now();
+    bool from_stream = index.BuildFromStream(video);
+    if (!from_stream) {
+        index.BuildByScan(filename, player.videoStream);
+    }
+    cout << "index: " << index.size() << " keyframes from "
+        << (from_stream ? "stream index" : "packet scan") << " in "
+        << std::chrono::duration<double, std::milli>(Clock::now() - begin).
+        count() << " ms" << endl;
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int64_t> dist(0, duration_ms * 95 / 100);
+    std::vector<int64_t> targets(100);
+    for (auto &t : targets) {
+        t = dist(rng);
+    }
+
+    std::vector<SeekResult> legacy;
+    std::vector<SeekResult> indexed;
+    for (int64_t target : targets) {
+        legacy.push_back(player.measure([&] {
+            int stream = player.audioStream >= 0
+                             ? player.audioStream
+                             : player.videoStream;
+            AVRational tb = player.formatCtx->streams[stream]->time_base;
+            return av_seek_frame(player.formatCtx, stream,
+                                 av_rescale_q(target, {1, 1000}, tb),
+                                 AVSEEK_FLAG_FRAME) >= 0;
+        }));
+        indexed.push_back(player.measure([&] {
+            return seekToKeyframe(player.formatCtx, player.videoStream, index,
+                                  target);
+        }));
+    }
+    report("audio AVSEEK_FLAG_FRAME", legacy, targets);
+    report("keyframe index        ", indexed, targets);
+    return 0;
+}
@@ -0,0 +1,292 @@
+// 停止和超时的响应时间：本进程里起一个会卡住的 http 服务器，
+// /silent 收下请求后什么都不回，/stall.wav 回一段 wav 之后不再发数据，
+// 之后的 Range 请求也不回。分别在打开、读包、seek 卡住时调用 Stop 或者
+// 等截止时间，测 FFmpeg 调用多久返回。直接走 avformat 的 http 协议和
+// 走 CachingAvio 的各测一遍
+// 用法: tests_teardown，全部通过返回 0
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "check.h"
+#include "AvioSource.h"
+#include "IoInterrupt.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+using std::cout;
+using std::endl;
+using std::string;
+using Clock = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+// 网络协议大约 100ms 检查一次中断回调，留出余量
+constexpr auto kBound = 500ms;
+constexpr auto kDeadline = 800ms;
+constexpr int kServedBytes = 256 * 1024;
+constexpr int64_t kContentLength = 64 * 1024 * 1024;
+
+std::mutex g_fds_mtx;
+std::vector<int> g_fds; // 卡住的连接不关，退出时一起关
+
+string wavHeader() {
+    struct {
+        char riff[4] = {'R', 'I', 'F', 'F'};
+        uint32_t size = 0x7fffff00;
+        char wave[4] = {'W', 'A', 'V', 'E'};
+        char fmt[4] = {'f', 'm', 't', ' '};
+        uint32_t fmt_size = 16;
+        uint16_t format = 1;
+        uint16_t channels = 2;
+        uint32_t rate = 48000;
+        uint32_t byte_rate = 48000 * 4;
+        uint16_t align = 4;
+        uint16_t bits = 16;
+        char data[4] = {'d', 'a', 't', 'a'};
+        uint32_t data_size = 0x7fffff00 - 36;
+    } header;
+    static_assert(sizeof(header) == 44);
+    return string(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+void serve(int fd) {
+    {
+        std::lock_guard<std::mutex> lock(g_fds_mtx);
+        g_fds.push_back(fd);
+    }
+    string request;
+    char buf[4096];
+    while (request.find("\r\n\r\n") == string::npos) {
+        ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            return;
+        }
+        request.append(buf, n);
+    }
+    // 只回从头开始读的 /stall.wav，其他请求一直挂着
+    if (request.find(" /stall.wav") == string::npos ||
+        (request.find("Range: bytes=") != string::npos &&
+         request.find("Range: bytes=0-") == string::npos)) {
+        return;
+    }
+    string response = "HTTP/1.1 200 OK\r\nAccept-Ranges: bytes\r\n"
+                      "Content-Type: audio/wav\r\nContent-Length: " +
+                      std::to_string(kContentLength) + "\r\n\r\n" +
+                      wavHeader() + string(kServedBytes, '\0');
+    ::send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+}
+
+int startServer() {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), len) != 0 ||
+        ::listen(fd, 16) != 0 ||
+        ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+        return -1;
+    }
+    std::thread([fd] {
+        while (true) {
+            int client = ::accept(fd, nullptr, nullptr);
+            if (client < 0) {
+                return;
+            }
+            std::thread(serve, client).detach();
+        }
+    }).detach();
+    return ntohs(addr.sin_port);
+}
+
+double ms(Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// after 之后在另一个线程调用 Stop，join 之后 stopped_at 是调用的时刻
+struct Stopper {
+    Stopper(IoInterrupt &io, Clock::duration after)
+        : thread([this, &io, after] {
+            std::this_thread::sleep_for(after);
+            stopped_at = Clock::now();
+            io.Stop();
+        }) {}
+
+    ~Stopper() {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    Clock::time_point stopped_at;
+    std::thread thread;
+};
+
+AVFormatContext *open(const string &url, IoInterrupt &io) {
+    AVFormatContext *ctx = avformat_alloc_context();
+    io.Install(ctx);
+    if (AvioSource::OpenInput(ctx, url) != 0) {
+        return nullptr;
+    }
+    return ctx;
+}
+
+// 读到服务器给的数据用完，下一次 av_read_frame 会卡住
+void drain(AVFormatContext *ctx, IoInterrupt &io) {
+    AVPacket *packet = av_packet_alloc();
+    int64_t bytes = 0;
+    while (bytes < kServedBytes - 16 * 1024 &&
+           av_read_frame(ctx, packet) >= 0) {
+        bytes += packet->size;
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    io.Reset();
+}
+
+void run(const string &base, const string &label) {
+    {
+        // 连上了但服务器不回，停在 avformat_open_input 里
+        IoInterrupt io;
+        AVFormatContext *ctx;
+        Clock::time_point end, stopped_at;
+        {
+            Stopper stopper(io, 300ms);
+            ctx = open(base + "/silent", io);
+            end = Clock::now();
+            stopper.thread.join();
+            stopped_at = stopper.stopped_at;
+        }
+        // 提前返回说明根本没有卡住，算失败
+        double latency = end > stopped_at ? ms(end - stopped_at) : 1e9;
+        cout << label << " stop during open: " << latency << "ms" << endl;
+        check(!ctx && latency < ms(kBound), label + " open stops in time");
+        AvioSource::CloseInput(ctx);
+    }
+    {
+        IoInterrupt io;
+        auto begin = Clock::now();
+        AVFormatContext *ctx;
+        {
+            IoInterrupt::Deadline deadline(io, kDeadline);
+            ctx = open(base + "/silent", io);
+        }
+        double took = ms(Clock::now() - begin);
+        cout << label << " open deadline: " << took << "ms" << endl;
+        check(!ctx && io.TimedOut() && took < ms(kDeadline + kBound),
+              label + " open deadline");
+        AvioSource::CloseInput(ctx);
+    }
+    {
+        // 数据发完之后连接还在，停在 av_read_frame 里
+        IoInterrupt io;
+        AVFormatContext *ctx = open(base + "/stall.wav", io);
+        check(ctx != nullptr, label + " open stalling stream");
+        if (!ctx) {
+            return;
+        }
+        drain(ctx, io);
+        AVPacket *packet = av_packet_alloc();
+        Clock::time_point end, stopped_at;
+        {
+            Stopper stopper(io, 300ms);
+            while (av_read_frame(ctx, packet) >= 0) {
+                av_packet_unref(packet);
+            }
+            end = Clock::now();
+            stopper.thread.join();
+            stopped_at = stopper.stopped_at;
+        }
+        double latency = end > stopped_at ? ms(end - stopped_at) : 1e9;
+        cout << label << " stop during read: " << latency << "ms" << endl;
+        check(latency < ms(kBound), label + " read stops in time");
+
+        // 关闭也不能卡住
+        auto begin = Clock::now();
+        av_packet_free(&packet);
+        AvioSource::CloseInput(ctx);
+        double took = ms(Clock::now() - begin);
+        cout << label << " close: " << took << "ms" << endl;
+        check(took < ms(kBound), label + " close in time");
+    }
+    {
+        IoInterrupt io;
+        AVFormatContext *ctx = open(base + "/stall.wav", io);
+        if (!ctx) {
+            check(false, label + " reopen stalling stream");
+            return;
+        }
+        drain(ctx, io);
+        AVPacket *packet = av_packet_alloc();
+        auto begin = Clock::now();
+        int ret;
+        {
+            IoInterrupt::Deadline deadline(io, kDeadline);
+            while ((ret = av_read_frame(ctx, packet)) >= 0) {
+                av_packet_unref(packet);
+            }
+        }
+        double took = ms(Clock::now() - begin);
+        cout << label << " read deadline: " << took << "ms" << endl;
+        check(io.TimedOut() && took < ms(kDeadline + kBound),
+              label + " read deadline");
+
+        // seek 到没下载过的位置要重新发 Range 请求，服务器不回
+        io.Reset();
+        begin = Clock::now();
+        {
+            IoInterrupt::Deadline deadline(io, kDeadline);
+            ret = av_seek_frame(ctx, -1, 60 * AV_TIME_BASE, 0);
+            if (ret >= 0) {
+                // wav 的 seek 只改位置，读的时候才发请求
+                ret = av_read_frame(ctx, packet);
+            }
+        }
+        took = ms(Clock::now() - begin);
+        cout << label << " seek deadline: " << took << "ms" << endl;
+        check(ret < 0 && took < ms(kDeadline + kBound),
+              label + " seek deadline");
+        av_packet_free(&packet);
+        io.Stop();
+        AvioSource::CloseInput(ctx);
+    }
+}
+
+int main() {
+    int port = startServer();
+    if (port < 0) {
+        cout << "listen failed" << endl;
+        return 1;
+    }
+    string base = "http://127.0.0.1:" + std::to_string(port);
+    string cache_dir = "/tmp/tests_teardown";
+    std::filesystem::remove_all(cache_dir);
+    setenv("PLAYER_CACHE_DIR", cache_dir.c_str(), 1);
+
+    setenv("PLAYER_IO", "file", 1);
+    run(base, "http");
+    unsetenv("PLAYER_IO");
+    run(base, "cached");
+
+    {
+        std::lock_guard<std::mutex> lock(g_fds_mtx);
+        for (int fd : g_fds) {
+            ::close(fd);
+        }
+    }
+    std::filesystem::remove_all(cache_dir);
+    return checkResult();
+}
@@ -0,0 +1,128 @@
+// Tracer：几个线程同时记，导出的 JSON 里事件一条不少、线程名都在；
+// 环形缓冲写满后留下最新的；停止之后不再记录；关着的时候一个 Span
+// 的开销
+// 用法: tests_trace，全部通过返回 0
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "check.h"
+#include "Tracer.h"
+
+using std::cout;
+using std::endl;
+using Clock = std::chrono::steady_clock;
+
+constexpr int kThreads = 3;
+constexpr int kPerThread = 10000;
+const char *kPath = "/tmp/tests_trace.json";
+
+std::string readTrace() {
+    std::ifstream in(kPath);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+size_t count(const std::string &text, const std::string &what) {
+    size_t n = 0;
+    for (size_t pos = text.find(what); pos != std::string::npos;
+         pos = text.find(what, pos + what.size())) {
+        ++n;
+    }
+    return n;
+}
+
+void disabledOverhead() {
+    constexpr int kSpans = 10000000;
+    auto begin = Clock::now();
+    for (int i = 0; i < kSpans; ++i) {
+        Tracer::Span span("disabled", i, i);
+    }
+    double ns = std::chrono::duration<double, std::nano>(
+                    Clock::now() - begin).count() / kSpans;
+    cout << "disabled span: " << ns << "ns" << endl;
+    check(ns < 50, "disabled span is nearly free");
+}
+
+void threads() {
+    const char *names[kThreads] = {"read", "video", "audio"};
+    Tracer::Start();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < kThreads; ++t) {
+        workers.emplace_back([t, &names] {
+            Tracer::SetThreadName(names[t]);
+            for (int i = 0; i < kPerThread; ++i) {
+                Tracer::Span outer("outer", i * 40, i);
+                Tracer::Span inner("inner");
+            }
+            Tracer::Instant("done");
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    // 线程退出之后事件还在
+    check(Tracer::Stop(kPath), "trace written");
+    std::string text = readTrace();
+    check(text.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[",
+                     0) == 0 &&
+          text.find("]}") != std::string::npos,
+          "trace is a json object");
+    check(count(text, "\"name\":\"outer\"") == kThreads * kPerThread &&
+          count(text, "\"name\":\"inner\"") == kThreads * kPerThread,
+          "no span lost across threads");
+    check(count(text, "\"ph\":\"i\"") == kThreads, "instants recorded");
+    bool named = true;
+    for (const char *name : names) {
+        named &= text.find(std::string("\"args\":{\"name\":\"") + name +
+                           "\"}") != std::string::npos;
+    }
+    check(named, "thread names exported");
+    check(text.find("\"args\":{\"pts\":399960,\"seq\":9999}") !=
+          std::string::npos, "pts and seq exported");
+
+    // 停止之后记的不算，下次 Start 清掉上次的
+    {
+        Tracer::Span span("after stop");
+    }
+    Tracer::Start();
+    Tracer::Instant("second");
+    Tracer::Stop(kPath);
+    text = readTrace();
+    check(count(text, "\"name\":\"outer\"") == 0 &&
+          text.find("after stop") == std::string::npos &&
+          count(text, "\"name\":\"second\"") == 1,
+          "restart clears previous events");
+}
+
+void wrap() {
+    constexpr int kEvents = Tracer::kCapacity + 1000;
+    Tracer::Start();
+    std::thread([] {
+        Tracer::SetThreadName("wrap");
+        for (int i = 0; i < kEvents; ++i) {
+            Tracer::Instant("tick", -1, i);
+        }
+    }).join();
+    Tracer::Stop(kPath);
+    std::string text = readTrace();
+    check(count(text, "\"name\":\"tick\"") == Tracer::kCapacity,
+          "full buffer keeps capacity events");
+    check(text.find("\"seq\":" + std::to_string(kEvents - 1) + "}") !=
+          std::string::npos &&
+          text.find("\"seq\":999}") == std::string::npos,
+          "oldest events are overwritten");
+}
+
+int main() {
+    disabledOverhead();
+    threads();
+    wrap();
+    std::remove(kPath);
+    return checkResult();
+}